@@ -0,0 +1,1795 @@
+/*
+ * nanoBASIC UNO - CLI ahead-of-time compiler
+ * --------------------------------------------
+ * Translates a tokenized program into one C++ source
+ * file (plain C style) that runs it natively on the
+ * host, with the same output, error messages and
+ * statement count as --run.
+ *
+ * Usage:
+ *   nanoBASIC_UNO --aot file.bas|image.bin out.cpp
+ *
+ * The input is a .bas file, or a program image (--image,
+ * or the eeprom.bin written by SAVE). Build the result
+ * with the core and the CLI BIOS, then run it with the
+ * options of --run:
+ *
+ *   g++ -O2 -Isrc -Icli out.cpp cli/run_cli.cpp \
+ *       cli/bios_uno_cli.cpp src/nano_basic_uno.cpp -o prog
+ *   ./prog [-c us] [-s seed] [-i input]
+ *
+ * The translator follows the interpreter byte by byte:
+ * every statement becomes a block of C with a goto
+ * label, GOTO / GOSUB with a literal label jump directly,
+ * FOR / GOSUB / DO keep their return point in a small
+ * stack, and DATA items become one function. Variables
+ * and @array live in the generated code, the console,
+ * waits and error messages go through the core
+ * (basicNativeXxx() in nano_basic_uno.h).
+ *
+ * Statements that need the interpreter itself (LIST,
+ * NEW, PROG, SAVE, LOAD, RESUME, DIM, EVERY, AFTER,
+ * PROFILE, SAMPLE, STAT) are rejected with their line.
+ *
+ * The generated file is only valid with the version and
+ * configuration (nano_basic_uno_conf.h) of this executable.
+ *
+ * GitHub: https://github.com/shachi-lab
+ * Copyright (c) 2025-2026 shachi-lab
+ * License: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <iterator>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "nano_basic_uno.h"
+#include "nano_basic_uno_conf.h"
+#include "nano_basic_defs.h"
+#include "bios_uno.h"
+#include "bios_uno_cli.h"
+
+int aotMain(int argc, char *argv[]);
+
+#define AOT_END     -2     // position: end of the program (nb_end)
+#define AOT_NONE    -1     // position: no fall-through
+
+typedef struct {
+  std::string code;        // C statements of the position
+  int next;                // fall-through position
+} aot_pos_t;
+
+// Large enough for any PROGRAM_AREA_SIZE / RAM_ARENA_SIZE
+static uint8_t aotImage[EEP_HEADER_SIZE + 0x4000];
+static const uint8_t *aotProg;                    // program area
+static int aotLen;
+static std::vector<int16_t> aotLine;              // line number of each byte
+static std::vector<std::pair<nb_int_t, int> > aotLabels;   // label, line top
+static std::vector<int> aotData;                  // DATA item offsets
+
+static std::map<int, aot_pos_t> aotPos;           // translated positions
+static std::set<int> aotQueued;
+static std::vector<int> aotWork;
+static std::map<int, int> aotRefs;                // goto count of each position
+static std::vector<int> aotReturns;               // return points, index = id
+static bool aotDynGoto;                           // GOTO / GOSUB with an expression
+static bool aotRunUsed;
+static bool aotReturnJump;                        // nb_return is used
+static std::string aotUnsupported;                // first rejected statement
+
+// State of the statement being translated
+static std::string *aotOut;
+static int aotPtr;
+static int16_t aotLineNo;
+static bool aotStop;                              // the rest is unreachable
+static bool aotCompiled;                          // inside ST_EXPR (no depth count)
+static bool aotDataMode;                          // translating nbData()
+static int aotDepth;                              // calcValue() count of the statement
+static int aotTemp, aotTempMax, aotDataTempMax;
+
+//*************************************************
+static std::string aotFormat(const char *fmt, ...)
+{
+  char buf[256];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  return buf;
+}
+
+//*************************************************
+static uint8_t aotByte(int p)
+{
+  return (p >= 0 && p < aotLen) ? aotProg[p] : (uint8_t)ST_EOL;
+}
+
+//*************************************************
+static void aotEmit(const std::string &s)
+{
+  *aotOut += "  " + s + "\n";
+}
+
+//*************************************************
+//    Bytecode scans (as in the core)
+//*************************************************
+static bool aotIsDelimiter(uint8_t ch)
+{
+  return ch == ':' || ch == ST_EOL || ch == ST_ELSE || ch == ST_ELSEIF ||
+         ch == ST_ENDIF || ch == ST_COMMENT;
+}
+
+//*************************************************
+static bool aotIsVal(uint8_t ch)
+{
+  return (ch & VAL_ST_MASK) == ST_VAL || (ch >= '0' && ch <= '9');
+}
+
+//*************************************************
+// get_dec_val(): end of the literal at p, -1 if none
+static int aotDecVal(int p, nb_int_t *val)
+{
+  uint8_t ch = aotByte(p);
+  if (ch >= '0' && ch <= '9') {
+    *val = ch - '0';
+    return p + 1;
+  }
+  if ((ch & VAL_ST_MASK) != ST_VAL) return -1;
+  int size = (ch & VAL_SIZE_MASK) + 1;
+  uint32_t u = 0;
+  for (int i = 0; i < size; i++) {
+    u |= (uint32_t)aotByte(p + 1 + i) << (8 * i);
+  }
+  if (size < 4 && (u & (1UL << (8 * size - 1)))) {
+    u |= ~0UL << (8 * size);              // sign extension
+  }
+  *val = (nb_int_t)(int32_t)u;
+  return p + 1 + size;
+}
+
+//*************************************************
+static int aotNextPtr(int p)
+{
+  uint8_t ch = aotByte(p++);
+  if ((ch & VAL_ST_MASK) == ST_VAL) {
+    p += (ch & VAL_SIZE_MASK) + 1;
+  }
+  else
+  if (ch == ST_EXPR || ch == ST_FAST) {
+    p += EXPR_HEADER_SIZE - 1 + aotByte(p);
+  }
+  return p;
+}
+
+//*************************************************
+static int aotSkipToDelimiter(int p)
+{
+  while (!aotIsDelimiter(aotByte(p))) p = aotNextPtr(p);
+  return p;
+}
+
+//*************************************************
+// findSTMain(): the position after the first token of the list, -1 if none
+static int aotFindST(const uint8_t *st_list, int ptr)
+{
+  uint8_t ch, count_if = 0;
+
+  while (true) {
+    while (true) {
+      ch = aotByte(ptr++);
+      if (ch == ST_EOL) break;
+      switch (ch) {
+      case ST_COMMENT :
+        while (aotByte(ptr) != ST_EOL) ptr++;
+        break;
+      case ST_EXPR :
+      case ST_FAST :
+        ptr += EXPR_HEADER_SIZE - 1 + aotByte(ptr);
+        break;
+      case ST_STRING :
+        do {
+          ch = aotByte(ptr++);
+          if (ch == '\\') ptr++;
+        } while (ch != ST_STRING && ch != ST_EOL);
+        break;
+      case ST_IF :
+        count_if++;
+        break;
+      case ST_ENDIF :
+        if (count_if) {
+          count_if--;
+          break;
+        }
+        /* fall through */
+      default :
+        if ((ch & VAL_ST_MASK) == ST_VAL) {
+          ptr += (ch & VAL_SIZE_MASK) + 1;
+        }
+        else
+        if (count_if == 0) {
+          for (const uint8_t *lp = st_list; *lp; lp++) {
+            if (*lp == ch) return ptr;
+          }
+        }
+      }
+    }
+    if (aotByte(ptr++) == ST_EOL) break;
+  }
+  return -1;
+}
+
+//*************************************************
+static int aotFindNextLoop(int ptr, uint8_t ch)
+{
+  static const uint8_t st_list_next_loop[] = { ST_NEXT, ST_FOR, 0, ST_LOOP, ST_WHILE, ST_DO, 0 };
+
+  const uint8_t *st_list = st_list_next_loop;
+  if (ch == ST_LOOP) st_list += 3;
+
+  uint8_t count = 1;
+  while (count) {
+    ptr = aotFindST(st_list, ptr);
+    if (ptr < 0) return -1;
+    ch = aotByte(ptr - 1);
+    if (*st_list == ch) {
+      if (ch == ST_LOOP && aotByte(ptr) == ST_WHILE) ptr++;
+      count--;
+    }
+    else {
+      count++;
+    }
+  }
+  return ptr;
+}
+
+//*************************************************
+// Line numbers, labels (the first one wins) and DATA items, like the
+// indexes the core builds when the program is stored
+static void aotScanProgram(void)
+{
+  int top = 0;
+  int16_t lnum = 1;
+
+  aotLine.assign(aotLen + 1, 0);
+  while (aotByte(top) != ST_EOL) {
+    int len = aotByte(top);
+    for (int i = top; i <= top + len && i < aotLen; i++) aotLine[i] = lnum;
+    nb_int_t val;
+    if (aotDecVal(top + 1, &val) >= 0) {
+      bool known = false;
+      for (const auto &l : aotLabels) known |= (l.first == val);
+      if (!known) aotLabels.push_back(std::make_pair(val, top));
+    }
+    top += len + 1;
+    lnum++;
+  }
+  if (top < aotLen) aotLine[top] = lnum;
+
+  // dataIndexBuild() / dataIndexAdd()
+  top = 0;
+  while (aotByte(top) != ST_EOL) {
+    int ptr = top + 1;
+    uint8_t ch;
+    while ((ch = aotByte(ptr++)) != ST_EOL) {
+      switch (ch) {
+      case ST_COMMENT :
+        ptr = top + aotByte(top);
+        break;
+      case ST_EXPR :
+      case ST_FAST :
+        ptr += EXPR_HEADER_SIZE - 1 + aotByte(ptr);
+        break;
+      case ST_STRING :
+        do {
+          ch = aotByte(ptr++);
+          if (ch == '\\') ptr++;
+        } while (ch != ST_STRING && ch != ST_EOL);
+        break;
+      case ST_DATA :
+        while (true) {
+          uint8_t depth = 0;
+          aotData.push_back(ptr);
+          while (aotByte(ptr) != ST_EOL &&
+                 (depth || (aotByte(ptr) != ',' && !aotIsDelimiter(aotByte(ptr))))) {
+            if (aotByte(ptr) == '(' || aotByte(ptr) == '[') depth++;
+            else
+            if (aotByte(ptr) == ')' || aotByte(ptr) == ']') depth--;
+            ptr = aotNextPtr(ptr);
+          }
+          if (aotByte(ptr) != ',') break;
+          ptr++;
+        }
+        break;
+      default :
+        if ((ch & VAL_ST_MASK) == ST_VAL) {
+          ptr += (ch & VAL_SIZE_MASK) + 1;
+        }
+      }
+    }
+    top = ptr;
+  }
+}
+
+//*************************************************
+//    Positions and jumps
+//*************************************************
+// A line top runs from after its label, as the interpreter does
+static int aotLineStart(int top)
+{
+  if (aotByte(top) == ST_EOL) return AOT_END;
+  uint8_t ch = aotByte(top + 1);
+  if (ch >= '0' && ch <= '9') return top + 2;
+  if ((ch & (VAL_ST_MASK | VAL_BASE_MASK)) == ST_VAL_DEC) return top + 2 + (ch & VAL_SIZE_MASK) + 1;
+  return top + 1;
+}
+
+//*************************************************
+static void aotQueue(int pos)
+{
+  if (pos >= 0 && aotQueued.insert(pos).second) aotWork.push_back(pos);
+}
+
+//*************************************************
+static std::string aotGoto(int pos)
+{
+  if (pos == AOT_END) return "goto nb_end;";
+  aotQueue(pos);
+  aotRefs[pos]++;
+  return aotFormat("goto P%d;", pos);
+}
+
+//*************************************************
+static int aotReturnId(int pos)
+{
+  for (size_t i = 0; i < aotReturns.size(); i++) {
+    if (aotReturns[i] == pos) return (int)i;
+  }
+  aotQueue(pos);
+  aotReturns.push_back(pos);
+  return (int)aotReturns.size() - 1;
+}
+
+//*************************************************
+static std::string aotGotoReturn(void)
+{
+  aotReturnJump = true;
+  return "goto nb_return;";
+}
+
+//*************************************************
+static int aotFindLabel(nb_int_t val)
+{
+  for (const auto &l : aotLabels) {
+    if (l.first == val) return l.second;
+  }
+  return -1;
+}
+
+//*************************************************
+static std::string aotLiteral(nb_int_t val)
+{
+  if ((int32_t)val == INT32_MIN) return "(-2147483647 - 1)";
+  return aotFormat("%ld", (long)val);
+}
+
+//*************************************************
+static bool aotIsLiteral(const std::string &s, nb_int_t *val)
+{
+  char *end;
+  if (s.empty()) return false;
+  long v = strtol(s.c_str(), &end, 10);
+  if (*end != '\0') return false;
+  *val = (nb_int_t)v;
+  return true;
+}
+
+//*************************************************
+//    Errors
+//*************************************************
+static std::string aotFailCode(const std::string &err)
+{
+  if (aotDataMode) return "return " + err + ";";
+  return aotFormat("FAIL(%s, %d);", err.c_str(), aotLineNo);
+}
+
+//*************************************************
+static void aotFail(const char *err)
+{
+  aotEmit(aotFailCode(err));
+}
+
+//*************************************************
+static void aotFailIf(const std::string &cond, const char *err)
+{
+  aotEmit("if (" + cond + ") " + aotFailCode(err));
+}
+
+//*************************************************
+static void aotSyntax(void)
+{
+  if (aotStop) return;
+  aotFail("ERROR_SYNTAX");
+  aotStop = true;
+}
+
+//*************************************************
+static void aotReject(const char *name)
+{
+  if (aotUnsupported.empty()) {
+    aotUnsupported = aotFormat("line %d: %s is not supported", aotLineNo, name);
+  }
+  aotStop = true;
+}
+
+//*************************************************
+static bool aotCheckST(uint8_t ch)
+{
+  if (aotStop) return true;
+  if (aotByte(aotPtr) != ch) aotSyntax();
+  aotPtr++;
+  return aotStop;
+}
+
+//*************************************************
+static bool aotCheckDelimiter(void)
+{
+  if (aotStop) return true;
+  if (!aotIsDelimiter(aotByte(aotPtr))) aotSyntax();
+  return aotStop;
+}
+
+//*************************************************
+static std::string aotNewTemp(void)
+{
+  aotTemp++;
+  if (aotDataMode) {
+    if (aotTemp > aotDataTempMax) aotDataTempMax = aotTemp;
+  }
+  else {
+    if (aotTemp > aotTempMax) aotTempMax = aotTemp;
+  }
+  return aotFormat("t%d", aotTemp);
+}
+
+//*************************************************
+// Evaluates an expression once, in order with the calls around it
+static std::string aotToTemp(const std::string &val)
+{
+  nb_int_t lit;
+  if (aotStop || aotIsLiteral(val, &lit)) return val;
+  std::string t = aotNewTemp();
+  aotEmit(t + " = " + val + ";");
+  return t;
+}
+
+//*************************************************
+// checkDivZero(): false if the divisor is a literal 0 (the error is certain)
+static bool aotDivisor(std::string &val)
+{
+  nb_int_t lit;
+  if (aotIsLiteral(val, &lit)) {
+    if (lit != 0) return true;
+    aotFail("ERROR_DIVZERO");
+    aotStop = true;
+    return false;
+  }
+  val = aotToTemp(val);
+  aotFailIf(val + " == 0", "ERROR_DIVZERO");
+  return true;
+}
+
+//*************************************************
+//    Expressions
+//*************************************************
+// Pure parts are returned as C expressions, calls and checks are emitted
+// as statements in the order of the interpreter
+static std::string aotExprMain(void);
+
+//*************************************************
+// @[index] : 'wide' keeps the whole index (compiled code) instead of int16_t
+static std::string aotArrayRef(bool wide)
+{
+  if (aotCheckST('[')) return "0";
+  std::string idx = aotExprMain();
+  if (aotStop) return "0";
+  std::string t = aotNewTemp();
+  aotEmit(t + " = " + (wide ? idx : "(int16_t)(" + idx + ")") + ";");
+  aotFailIf(t + " < 0 || " + t + " >= NB_ARRAY_SIZE", "ERROR_ARRAY");
+  if (aotCheckST(']')) return "0";
+  return "AR[" + t + "]";
+}
+
+//*************************************************
+static std::string aotFunc1(void)
+{
+  if (aotCheckST('(')) return "0";
+  std::string val = aotExprMain();
+  if (aotCheckST(')')) return "0";
+  return val;
+}
+
+//*************************************************
+static std::string aotCall(const std::string &call)
+{
+  std::string t = aotNewTemp();
+  aotEmit(t + " = " + call + ";");
+  return t;
+}
+
+//*************************************************
+static std::string aotCalcValue(void)
+{
+  nb_int_t lit;
+  std::string val, val_2, t;
+  uint8_t ch;
+
+  if (!aotCompiled) {
+    aotDepth++;
+    if (aotDataMode) {
+      aotEmit(aotFormat("if (depth > %d) return ERROR_TOODEEP;", EXPR_DEPTH_MAX - aotDepth));
+    }
+    else
+    if (aotDepth > EXPR_DEPTH_MAX) {
+      aotFail("ERROR_TOODEEP");
+      aotStop = true;
+      return "0";
+    }
+  }
+
+  int p = aotDecVal(aotPtr, &lit);
+  if (p >= 0) {
+    aotPtr = p;
+    return aotLiteral(lit);
+  }
+  ch = aotByte(aotPtr++);
+  if (isupper(ch)) {
+    return aotFormat("VAR('%c')", ch);
+  }
+  if (ch == ST_ARRAY) {
+    return aotArrayRef(aotCompiled);
+  }
+
+  switch (ch) {
+  case '(' :
+    val = aotExprMain();
+    if (aotCheckST(')')) return "0";
+    return val;
+  case '-' :
+    val = aotCalcValue();
+    return "NEG(" + val + ")";
+  case '!' :
+    val = aotCalcValue();
+    return "(" + val + " == 0)";
+  case '~' :
+    val = aotCalcValue();
+    return "(~" + val + ")";
+  case FUNC_RND :
+    val = aotFunc1();
+    if (aotStop) return "0";
+    return aotCall("bios_rand(" + val + ")");
+  case FUNC_ABS :
+    val = aotFunc1();
+    if (aotStop) return "0";
+    return "nbAbs(" + val + ")";
+  case FUNC_INP :
+  case FUNC_INPORT :
+  case FUNC_ADC :
+    val = aotFunc1();
+    if (aotStop) return "0";
+    t = aotCall((ch == FUNC_INP    ? "bios_readGpio(" :
+                 ch == FUNC_INPORT ? "bios_readPort(" : "bios_readAdc(") + val + ")");
+    aotFailIf(t + " < 0", "ERROR_PARA");
+    return t;
+  case FUNC_SUM :
+  case FUNC_MIN :
+  case FUNC_MAX :
+    if (aotCheckST('(')) return "0";
+    val = aotExprMain();
+    if (aotCheckST(',')) return "0";
+    val_2 = aotExprMain();
+    if (aotCheckST(')')) return "0";
+    val = aotToTemp(val);
+    val_2 = aotToTemp(val_2);
+    aotFailIf("!nbRange(" + val + ", " + val_2 + ")", "ERROR_ARRAY");
+    return aotCall(aotFormat("nbArrayFunc(0x%02x, ", ch) + val + ", " + val_2 + ")");
+  case FUNC_INKEY :
+    val = aotFunc1();
+    if (aotStop) return "0";
+    t = aotCall("(nb_int_t)basicNativeCall(FUNC_INKEY, " + val + ", &err)");
+    aotFailIf("err", "err");
+    return t;
+  case FUNC_ELAPSED :
+    val = aotFunc1();
+    if (aotStop) return "0";
+    return aotCall("(nb_int_t)((nb_uint_t)bios_getMicroTick() - (nb_uint_t)(" + val + "))");
+  case SVAR_TICK :
+    return aotCall("bios_getSystemTick()");
+  case SVAR_UTICK :
+    return aotCall("bios_getMicroTick()");
+  case SVAR_FREE :
+    return "NB_FREE";
+  case ST_SAMPLE :
+    aotReject("SAMPLE()");
+    return "0";
+  case ST_STAT :
+    aotReject("STAT()");
+    return "0";
+  default :
+    aotSyntax();
+  }
+  return "0";
+}
+
+//*************************************************
+static std::string aotBinary(const char *op, const std::string &a, const std::string &b)
+{
+  if (isalpha((uint8_t)op[0])) return std::string(op) + "(" + a + ", " + b + ")";
+  return "(" + a + " " + op + " " + b + ")";
+}
+
+//*************************************************
+static std::string aotExpr4th(void)
+{
+  std::string acc, val;
+  uint8_t ch;
+
+  acc = aotCalcValue();
+  if (aotStop) return "0";
+  while (true) {
+    ch = aotByte(aotPtr++);
+    switch (ch) {
+    case '*' :
+      val = aotCalcValue();
+      acc = aotBinary("MUL", acc, val);
+      break;
+    case '/' :
+    case '%' :
+      val = aotCalcValue();
+      if (aotStop) break;
+      acc = aotToTemp(acc);
+      if (!aotDivisor(val)) break;
+      acc = aotBinary(ch == '/' ? "DIV" : "MOD", acc, val);
+      break;
+    default :
+      aotPtr--;
+      return acc;
+    }
+    if (aotStop) return "0";
+  }
+}
+
+//*************************************************
+static std::string aotExpr3nd(void)
+{
+  std::string acc, val;
+  uint8_t ch;
+
+  acc = aotExpr4th();
+  if (aotStop) return "0";
+  while (true) {
+    ch = aotByte(aotPtr++);
+    switch (ch) {
+    case '+' :
+      val = aotExpr4th();
+      acc = aotBinary("ADD", acc, val);
+      break;
+    case '-' :
+      val = aotExpr4th();
+      acc = aotBinary("SUB", acc, val);
+      break;
+    default :
+      aotPtr--;
+      return acc;
+    }
+    if (aotStop) return "0";
+  }
+}
+
+//*************************************************
+static std::string aotExpr2nd(void)
+{
+  std::string acc, tmp;
+  uint8_t ch, ch2;
+
+  acc = aotExpr3nd();
+  if (aotStop) return "0";
+  while (true) {
+    ch = aotByte(aotPtr++);
+    switch (ch) {
+    case '>' :
+      ch2 = aotByte(aotPtr++);
+      if (ch2 == '=') {
+        tmp = aotExpr3nd();
+        acc = aotBinary(">=", acc, tmp);
+      }
+      else
+      if (ch2 == ch) {
+        tmp = aotExpr3nd();
+        acc = aotBinary("SHR", acc, tmp);
+      }
+      else {
+        aotPtr--;
+        tmp = aotExpr3nd();
+        acc = aotBinary(">", acc, tmp);
+      }
+      break;
+    case '<' :
+      ch2 = aotByte(aotPtr++);
+      if (ch2 == '=') {
+        tmp = aotExpr3nd();
+        acc = aotBinary("<=", acc, tmp);
+      }
+      else
+      if (ch2 == '>') {
+        tmp = aotExpr3nd();
+        acc = aotBinary("!=", acc, tmp);
+      }
+      else
+      if (ch2 == ch) {
+        tmp = aotExpr3nd();
+        acc = aotBinary("SHL", acc, tmp);
+      }
+      else {
+        aotPtr--;
+        tmp = aotExpr3nd();
+        acc = aotBinary("<", acc, tmp);
+      }
+      break;
+    case '=' :
+      if (aotByte(aotPtr) == ch) aotPtr++;
+      tmp = aotExpr3nd();
+      acc = aotBinary("==", acc, tmp);
+      break;
+    case '!' :
+      if (aotByte(aotPtr) == '=') {
+        aotPtr++;
+        tmp = aotExpr3nd();
+        acc = aotBinary("!=", acc, tmp);
+        break;
+      }
+      /* fall through */
+    default :
+      aotPtr--;
+      return acc;
+    }
+    if (aotStop) return "0";
+  }
+}
+
+//*************************************************
+static std::string aotExprMain(void)
+{
+  std::string acc, tmp;
+  uint8_t ch;
+  bool compiled = aotCompiled;
+  int end = -1;
+
+  if (aotByte(aotPtr) == ST_EXPR) {
+    // the infix code is kept after the postfix code
+    end = aotPtr + EXPR_HEADER_SIZE + aotByte(aotPtr + 1) + aotByte(aotPtr + 2);
+    aotPtr += EXPR_HEADER_SIZE + aotByte(aotPtr + 1);
+    aotCompiled = EXPR_COMPILE_ENABLE;
+  }
+  acc = aotExpr2nd();
+  while (!aotStop) {
+    ch = aotByte(aotPtr++);
+    if (ch == '&' || ch == '|') {
+      bool logical = (aotByte(aotPtr) == ch);
+      if (logical) aotPtr++;
+      tmp = aotExpr2nd();
+      acc = aotBinary(ch == '&' ? (logical ? "&&" : "&") : (logical ? "||" : "|"), acc, tmp);
+    }
+    else
+    if (ch == '^') {
+      tmp = aotExpr2nd();
+      acc = aotBinary("^", acc, tmp);
+    }
+    else {
+      aotPtr--;
+      break;
+    }
+  }
+  aotCompiled = compiled;
+  if (aotStop) return "0";
+  if (end >= 0) aotPtr = end;
+  return acc;
+}
+
+//*************************************************
+// expr() of a statement, evaluated at this point
+static std::string aotExpr(void)
+{
+  return aotToTemp(aotExprMain());
+}
+
+//*************************************************
+// getParameterPointer()
+static std::string aotParameter(void)
+{
+  uint8_t ch = aotByte(aotPtr++);
+  if (ch == ST_ARRAY) return aotArrayRef(false);
+  if (isupper(ch)) return aotFormat("VAR('%c')", ch);
+  aotSyntax();
+  return "V[0]";
+}
+
+//*************************************************
+//    Statements
+//*************************************************
+// A jump to a label value, known or looked up at run time
+static void aotJumpLabel(const std::string &val)
+{
+  nb_int_t lit;
+  if (aotIsLiteral(val, &lit)) {
+    int top = aotFindLabel(lit);
+    if (top < 0) {
+      aotFail("ERROR_LABEL");
+    }
+    else {
+      aotEmit(aotGoto(aotLineStart(top)));
+    }
+    return;
+  }
+  if (!aotDynGoto) {
+    aotDynGoto = true;
+    for (const auto &l : aotLabels) aotQueue(aotLineStart(l.second));
+  }
+  aotEmit("lbl = " + val + ";");
+  aotEmit(aotFormat("line = %d;", aotLineNo));
+  aotEmit("goto nb_goto;");
+}
+
+//*************************************************
+static void aotPush(const char *type, int ret)
+{
+  aotEmit(aotFormat("stk[sp].type = %s;", type));
+  aotEmit(aotFormat("stk[sp++].ret = %d;", aotReturnId(ret)));
+}
+
+//*************************************************
+static void aotLet(const std::string &var)
+{
+  uint8_t op = aotByte(aotPtr);
+  std::string val;
+
+  if (op == aotByte(aotPtr + 1)) {
+    aotPtr += 2;
+    if (op == '+' || op == '-') {
+      aotEmit(var + " = " + (op == '+' ? "ADD(" : "SUB(") + var + ", 1);");
+      aotCheckDelimiter();
+      return;
+    }
+    if (op != '<' && op != '>') {
+      aotSyntax();
+      return;
+    }
+  }
+  else
+  if (op == '+' || op == '-' || op == '*' || op == '/' || op == '%' || op == '|' || op == '&' || op == '^') {
+    aotPtr++;
+  }
+  if (aotCheckST('=')) return;
+  val = aotExprMain();
+  if (aotStop) return;
+
+  switch (op) {
+  case '+' : val = aotBinary("ADD", var, val); break;
+  case '-' : val = aotBinary("SUB", var, val); break;
+  case '*' : val = aotBinary("MUL", var, val); break;
+  case '/' :
+  case '%' :
+    if (!aotDivisor(val)) return;
+    val = aotBinary(op == '/' ? "DIV" : "MOD", var, val);
+    break;
+  case '|' : val = "(nb_int_t)" + aotBinary("|", var, val); break;
+  case '&' : val = "(nb_int_t)" + aotBinary("&", var, val); break;
+  case '^' : val = "(nb_int_t)" + aotBinary("^", var, val); break;
+  case '<' : val = aotBinary("SHL", var, val); break;
+  case '>' : val = aotBinary("SHR", var, val); break;
+  default  : break;
+  }
+  aotEmit(var + " = " + val + ";");
+  aotCheckDelimiter();
+}
+
+//*************************************************
+static void aotPrintString(void)
+{
+  std::string text;
+  uint8_t val, count;
+  int s = aotPtr;
+
+  // print_escaped()
+  while (aotByte(s)) {
+    if (aotByte(s) == ST_STRING) {
+      s++;
+      break;
+    }
+    if (aotByte(s) == '\\') {
+      s++;
+      switch (aotByte(s)) {
+      case 'a':  text += '\a'; break;
+      case 'b':  text += '\b'; break;
+      case 'f':  text += '\f'; break;
+      case 'n':  text += '\n'; break;
+      case 'r':  text += '\r'; break;
+      case 't':  text += '\t'; break;
+      case 'v':  text += '\v'; break;
+      case '\\': text += '\\'; break;
+      case '\'': text += '\''; break;
+      case '\"': text += '\"'; break;
+      case '\?': text += '\?'; break;
+      case 'x':
+        s++;
+        val = 0;
+        count = 0;
+        while (count < 2 && isxdigit(aotByte(s))) {
+          uint8_t ch = aotByte(s);
+          val = (val << 4) + (isdigit(ch) ? ch - '0' : (toupper(ch) - 'A' + 10));
+          s++;
+          count++;
+        }
+        text += (char)val;
+        s--;
+        break;
+      default:
+        if (aotByte(s) < '0' || aotByte(s) > '7') {
+          if (aotByte(s)) text += (char)aotByte(s);
+          break;
+        }
+        val = 0;
+        count = 0;
+        while (count < 3) {
+          if (aotByte(s) < '0' || aotByte(s) > '7') break;
+          val = (val << 3) + (aotByte(s) - '0');
+          s++;
+          count++;
+        }
+        text += (char)val;
+        s--;
+        break;
+      }
+    }
+    else {
+      text += (char)aotByte(s);
+    }
+    s++;
+  }
+  aotPtr = s;
+
+  std::string lit;
+  for (char c : text) {
+    if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\' && c != '?') lit += c;
+    else lit += aotFormat("\\%03o", (uint8_t)c);
+  }
+  if (!text.empty()) {
+    aotEmit(aotFormat("nbPuts(\"%s\", %d);", lit.c_str(), (int)text.size()));
+  }
+}
+
+//*************************************************
+static void aotPrint(void)
+{
+  std::string val, len;
+  bool exp_flag = false;
+  uint8_t ch, lastChar = 0;
+
+  while (!aotStop) {
+    if (aotIsDelimiter(aotByte(aotPtr))) {
+      if (lastChar != ';' && lastChar != ',') {
+        aotEmit("nbPuts(\"\\n\\r\", 2);");
+      }
+      return;
+    }
+    lastChar = ch = aotByte(aotPtr++);
+    switch (ch) {
+    case ST_STRING :
+      aotPrintString();
+      exp_flag = false;
+      break;
+    case ';' :
+      exp_flag = false;
+      break;
+    case ',' :
+      aotEmit("basicNativePutChar('\\t');");
+      exp_flag = false;
+      break;
+    case FUNC_CHR :
+      val = aotFunc1();
+      if (aotStop) return;
+      aotEmit("nbChr(" + val + ");");
+      exp_flag = false;
+      break;
+    case FUNC_HEX :
+    case FUNC_DEC :
+    case FUNC_RAW :
+      if (aotCheckST('(')) return;
+      val = aotExpr();
+      if (aotStop) return;
+      len = (ch == FUNC_RAW) ? "(int16_t)sizeof(nb_int_t)" : "0";
+      if (aotByte(aotPtr) == ',') {
+        aotPtr++;
+        len = aotExpr();
+        if (aotStop) return;
+      }
+      if (aotCheckST(')')) return;
+      if (ch == FUNC_RAW) {
+        aotFailIf("!nbRaw(" + val + ", (int16_t)(" + len + "))", "ERROR_PARA");
+      }
+      else {
+        aotEmit("basicNativePrint(" + val + (ch == FUNC_HEX ? ", FORM_HEX" : ", FORM_DEC") +
+                ", (int16_t)(" + len + "));");
+      }
+      exp_flag = false;
+      break;
+    default :
+      if (exp_flag) {
+        aotSyntax();
+        return;
+      }
+      aotPtr--;
+      val = aotExprMain();
+      if (aotStop) return;
+      aotEmit("basicNativePrint(" + val + ", FORM_NONE, 0);");
+      exp_flag = true;
+      break;
+    }
+  }
+}
+
+//*************************************************
+// IF cond THEN ... [ELSEIF cond THEN ...] [ELSE ...] ENDIF
+static int aotIf(void)
+{
+  static const uint8_t st_list_if[] = { ST_ENDIF, ST_ELSE, ST_ELSEIF, 0 };
+  std::string val;
+  uint8_t ch;
+
+  do {
+    val = aotExpr();
+    if (aotCheckST(ST_THEN)) return AOT_NONE;
+    aotEmit("if (" + val + ") {");
+    if (aotIsVal(aotByte(aotPtr))) {
+      // THEN label: the GOTO only runs on this branch
+      int ptr = aotPtr, depth = aotDepth;
+      std::string label = aotExprMain();
+      if (!aotCheckDelimiter()) aotJumpLabel(label);
+      aotStop = false;
+      aotPtr = ptr;
+      aotDepth = depth;
+    }
+    else {
+      aotEmit("  " + aotGoto(aotPtr));
+    }
+    aotEmit("}");
+    int ptr = aotFindST(st_list_if, aotPtr);
+    if (ptr < 0) {
+      aotFail("ERROR_NOENDIF");
+      return AOT_NONE;
+    }
+    aotPtr = ptr;
+    ch = aotByte(aotPtr - 1);
+  } while (ch == ST_ELSEIF);
+
+  if (ch == ST_ELSE && aotIsVal(aotByte(aotPtr))) {
+    std::string label = aotExprMain();
+    if (aotCheckDelimiter()) return AOT_NONE;
+    aotJumpLabel(label);
+    return AOT_NONE;
+  }
+  return aotPtr;
+}
+
+//*************************************************
+// FILL / COPY / SHIFT index, count, value
+static void aotArrayStatement(uint8_t st)
+{
+  std::string a, b, c;
+
+  a = aotExpr();
+  if (aotCheckST(',')) return;
+  b = aotExpr();
+  if (aotCheckST(',')) return;
+  c = aotExpr();
+  if (aotCheckDelimiter()) return;
+  switch (st) {
+  case ST_FILL :
+    aotFailIf("!nbRange(" + a + ", " + b + ")", "ERROR_ARRAY");
+    aotEmit("nbFill(" + a + ", " + b + ", " + c + ");");
+    break;
+  case ST_COPY :
+    aotFailIf("!nbRange(" + a + ", " + c + ") || !nbRange(" + b + ", " + c + ")", "ERROR_ARRAY");
+    aotEmit("memmove(&AR[" + b + "], &AR[" + a + "], " + c + " * sizeof(nb_int_t));");
+    break;
+  default :
+    aotFailIf("!nbRange(" + a + ", " + b + ")", "ERROR_ARRAY");
+    aotEmit("nbShift(" + a + ", " + b + ", " + c + ");");
+    break;
+  }
+}
+
+//*************************************************
+// RESTORE label : the first DATA item after the label
+static int aotDataIndex(int top)
+{
+  nb_int_t val;
+  int after = aotDecVal(top + 1, &val);
+  int idx = 0;
+
+  while (idx < (int)aotData.size() && aotData[idx] < after) idx++;
+  return idx;
+}
+
+//*************************************************
+static void aotCallCore(const char *code, const std::string &val)
+{
+  aotEmit(std::string("basicNativeCall(") + code + ", " + val + ", &err);");
+  aotFailIf("err", "err");
+}
+
+//*************************************************
+// One statement at aotPtr, returns the position that follows
+static int aotStatement(uint8_t ch)
+{
+  static const uint8_t st_list_endif[] = { ST_ENDIF, 0 };
+  std::string val, val_2, val_3, var;
+  nb_int_t lit;
+  int ptr;
+
+  switch (ch) {
+  case ST_PRINT :
+    aotPrint();
+    break;
+  case ST_INPUT :
+    var = aotParameter();
+    if (aotCheckDelimiter()) break;
+    aotEmit(var + " = (nb_int_t)basicNativeCall(ST_INPUT, " + var + ", &err);");
+    aotFailIf("err", "err");
+    break;
+  case ST_GOTO :
+    val = aotExprMain();
+    if (aotCheckDelimiter()) break;
+    aotJumpLabel(val);
+    return AOT_NONE;
+  case ST_GOSUB :
+    aotFailIf("sp >= NB_STACK_NUM", "ERROR_STACK");
+    val = aotExprMain();
+    if (aotCheckDelimiter()) break;
+    aotPush("ST_GOSUB", aotPtr);
+    aotJumpLabel(val);
+    return AOT_NONE;
+  case ST_RETURN :
+    if (aotCheckDelimiter()) break;
+    aotEmit("do {");
+    aotEmit("  if (sp == 0) " + aotFailCode("ERROR_UXRETURN"));
+    aotEmit("} while (stk[--sp].type != ST_GOSUB);");
+    aotEmit("ret = stk[sp].ret;");
+    aotEmit(aotGotoReturn());
+    return AOT_NONE;
+  case ST_FOR :
+    var = aotParameter();
+    if (aotCheckST('=')) break;
+    val = aotExpr();
+    if (aotCheckST(ST_TO)) break;
+    val_2 = aotExpr();
+    if (aotStop) break;
+    if (aotByte(aotPtr) == ST_STEP) {
+      aotPtr++;
+      val_3 = aotExpr();
+      if (aotStop) break;
+    }
+    else {
+      val_3 = "1";
+    }
+    aotFailIf("sp >= NB_STACK_NUM", "ERROR_STACK");
+    aotEmit("stk[sp].pvar = &" + var + ";");
+    aotEmit("stk[sp].limit = " + val_2 + ";");
+    aotEmit("stk[sp].step = " + val_3 + ";");
+    aotPush("ST_FOR", aotPtr);
+    aotEmit(var + " = " + val + ";");
+    break;
+  case ST_NEXT :
+    if (aotCheckDelimiter()) break;
+    aotFailIf("sp == 0 || stk[sp - 1].type != ST_FOR", "ERROR_UXNEXT");
+    aotEmit("if (nbNext(&stk[sp - 1])) {");
+    aotEmit("  ret = stk[sp - 1].ret;");
+    aotEmit("  " + aotGotoReturn());
+    aotEmit("}");
+    aotEmit("sp--;");
+    break;
+  case ST_DO :
+    if (aotCheckDelimiter()) break;
+    aotFailIf("sp >= NB_STACK_NUM", "ERROR_STACK");
+    aotPush("ST_DO", aotPtr - 1);
+    break;
+  case ST_LOOP :
+    aotFailIf("sp == 0 || stk[--sp].type != ST_DO", "ERROR_UXLOOP");
+    if (aotByte(aotPtr) == ST_WHILE) {
+      aotPtr++;
+      val = aotExpr();
+      if (aotCheckDelimiter()) break;
+      aotEmit("if (" + val + ") {");
+      aotEmit("  ret = stk[sp].ret;");
+      aotEmit("  " + aotGotoReturn());
+      aotEmit("}");
+      break;
+    }
+    if (aotCheckDelimiter()) break;
+    aotEmit("ret = stk[sp].ret;");
+    aotEmit(aotGotoReturn());
+    return AOT_NONE;
+  case ST_WHILE :
+    ptr = aotPtr;
+    val = aotExpr();
+    if (aotCheckDelimiter()) break;
+    aotEmit("if (" + val + ") {");
+    aotEmit("  if (sp >= NB_STACK_NUM) " + aotFailCode("ERROR_STACK"));
+    aotEmit(aotFormat("  stk[sp].type = ST_DO;"));
+    aotEmit(aotFormat("  stk[sp++].ret = %d;", aotReturnId(ptr - 1)));
+    aotEmit("}");
+    ptr = aotFindNextLoop(ptr, ST_LOOP);
+    if (ptr < 0) {
+      aotEmit("else " + aotFailCode("ERROR_NOLOOP"));
+    }
+    else {
+      aotEmit("else " + aotGoto(aotSkipToDelimiter(ptr)));
+    }
+    break;
+  case ST_EXIT :
+    if (aotCheckDelimiter()) break;
+    ptr = aotFindNextLoop(aotPtr, ST_LOOP);
+    if (ptr >= 0) {
+      aotEmit("if (sp && stk[sp - 1].type == ST_DO) {");
+      aotEmit("  sp--;");
+      aotEmit("  " + aotGoto(aotSkipToDelimiter(ptr)));
+      aotEmit("}");
+    }
+    ptr = aotFindNextLoop(aotPtr, ST_NEXT);
+    if (ptr >= 0) {
+      aotEmit("if (sp && stk[sp - 1].type == ST_FOR) {");
+      aotEmit("  sp--;");
+      aotEmit("  " + aotGoto(aotSkipToDelimiter(ptr)));
+      aotEmit("}");
+    }
+    aotFail("ERROR_UXEXIT");
+    return AOT_NONE;
+  case ST_CONTINUE :
+    if (aotCheckDelimiter()) break;
+    aotEmit("if (sp && stk[sp - 1].type == ST_DO) {");
+    aotEmit("  ret = stk[--sp].ret;");
+    aotEmit("  " + aotGotoReturn());
+    aotEmit("}");
+    ptr = aotFindNextLoop(aotPtr, ST_NEXT);
+    if (ptr >= 0) {
+      aotEmit("if (sp && stk[sp - 1].type == ST_FOR) " + aotGoto(ptr - 1));
+    }
+    aotFail("ERROR_UXCONTINUE");
+    return AOT_NONE;
+  case ST_IF :
+    return aotIf();
+  case ST_ELSE :
+  case ST_ELSEIF :
+    ptr = aotFindST(st_list_endif, aotPtr);
+    if (ptr < 0) {
+      aotFail("ERROR_NOENDIF");
+      return AOT_NONE;
+    }
+    return ptr;
+  case ST_ENDIF :
+    aotCheckDelimiter();
+    break;
+  case ST_RUN :
+    if (aotCheckDelimiter()) break;
+    aotRunUsed = true;
+    aotEmit("goto nb_run;");
+    return AOT_NONE;
+  case ST_STOP :
+    if (aotCheckDelimiter()) break;
+    aotFail("ERROR_BREAK");
+    return AOT_NONE;
+  case ST_END :
+    if (aotCheckDelimiter()) break;
+    aotEmit("goto nb_end;");
+    return AOT_NONE;
+  case ST_DELAY :
+    val = aotExpr();
+    if (aotCheckDelimiter()) break;
+    aotCallCore("ST_DELAY", val);
+    break;
+  case ST_PAUSE :
+    if (aotCheckDelimiter()) break;
+    aotCallCore("ST_PAUSE", "0");
+    break;
+  case ST_RESET :
+    if (aotCheckDelimiter()) break;
+    aotCallCore("ST_RESET", "0");
+    break;
+  case ST_RONDOMIZE :
+    val = aotExpr();
+    if (aotCheckDelimiter()) break;
+    aotEmit("bios_randomize(" + val + ");");
+    break;
+  case ST_DATA :
+    aotPtr = aotSkipToDelimiter(aotPtr);
+    break;
+  case ST_READ :
+    var = aotParameter();
+    if (aotCheckDelimiter()) break;
+    aotFailIf("dataIdx >= NB_DATA_NUM", "ERROR_UXREAD");
+    aotEmit(aotFormat("err = nbData(dataIdx++, &%s, %d);", var.c_str(), aotDepth));
+    aotFailIf("err", "err");
+    break;
+  case ST_RESTORE :
+    if (aotIsDelimiter(aotByte(aotPtr))) {
+      aotEmit("dataIdx = 0;");
+      break;
+    }
+    val = aotExprMain();
+    if (aotCheckDelimiter()) break;
+    if (aotIsLiteral(val, &lit)) {
+      ptr = aotFindLabel(lit);
+      if (ptr < 0) {
+        aotFail("ERROR_LABEL");
+        return AOT_NONE;
+      }
+      aotEmit(aotFormat("dataIdx = %d;", aotDataIndex(ptr)));
+      break;
+    }
+    aotEmit("switch (" + val + ") {");
+    for (const auto &l : aotLabels) {
+      aotEmit(aotFormat("case %s: dataIdx = %d; break;", aotLiteral(l.first).c_str(), aotDataIndex(l.second)));
+    }
+    aotEmit("default: " + aotFailCode("ERROR_LABEL"));
+    aotEmit("}");
+    break;
+  case ST_OUTP :
+  case ST_PWM :
+    val = aotExpr();
+    if (aotCheckST(',')) break;
+    val_2 = aotExpr();
+    if (aotCheckDelimiter()) break;
+    aotFailIf((ch == ST_OUTP ? "bios_writeGpio(" : "bios_setPwm(") + val + ", " + val_2 + ")", "ERROR_PARA");
+    break;
+  case ST_OUTPORT :
+  case ST_PORTDIR :
+    val = aotExpr();
+    if (aotCheckST(',')) break;
+    val_2 = aotExpr();
+    if (aotStop) break;
+    val_3 = "0xff";
+    if (aotByte(aotPtr) == ',') {
+      aotPtr++;
+      val_3 = aotExpr();
+    }
+    if (aotCheckDelimiter()) break;
+    aotFailIf((ch == ST_OUTPORT ? "bios_writePort(" : "bios_setPortDir(") + val + ", " + val_2 + ", " + val_3 + ")",
+              "ERROR_PARA");
+    break;
+  case ST_FILL :
+  case ST_COPY :
+  case ST_SHIFT :
+    aotArrayStatement(ch);
+    break;
+  case ST_RESUME :   aotReject("RESUME"); break;
+  case ST_NEW :      aotReject("NEW"); break;
+  case ST_LIST :     aotReject("LIST"); break;
+  case ST_PROG :     aotReject("PROG"); break;
+  case ST_SAVE :     aotReject("SAVE"); break;
+  case ST_LOAD :     aotReject("LOAD"); break;
+  case ST_PROFILE :  aotReject("PROFILE"); break;
+  case ST_EVERY :    aotReject("EVERY"); break;
+  case ST_AFTER :    aotReject("AFTER"); break;
+  case ST_SAMPLE :   aotReject("SAMPLE"); break;
+  case ST_DIM :      aotReject("DIM"); break;
+  case ST_STAT :     aotReject("STAT"); break;
+  default :
+    aotSyntax();
+    break;
+  }
+  return aotStop ? AOT_NONE : aotPtr;
+}
+
+//*************************************************
+// The statement or separator at pos, as one turn of interpreterMain()
+static void aotTranslate(int pos)
+{
+  aot_pos_t &ps = aotPos[pos];
+  uint8_t ch = aotByte(pos);
+
+  aotOut = &ps.code;
+  aotPtr = pos + 1;
+  aotLineNo = aotLine[pos];
+  aotStop = false;
+  aotCompiled = false;
+  aotDepth = 0;
+  aotTemp = 0;
+
+  if (ch == ' ' || ch == '\t' || ch == ':') {
+    ps.next = pos + 1;
+    return;
+  }
+  if (ch == ST_EOL) {
+    ps.next = aotLineStart(pos + 1);
+    return;
+  }
+  aotEmit(aotFormat("STMT(%d);", aotLineNo));
+  if (ch == ST_FAST) {
+    int op = pos + EXPR_HEADER_SIZE;
+    int stmt = op + aotByte(pos + 1);
+    ps.next = stmt + aotByte(pos + 2);
+#if CODE_OPTIMIZE_ENABLE
+    nb_int_t val;
+    std::string var = aotFormat("VAR('%c')", aotByte(op + 1));
+    switch (aotByte(op)) {
+    case FAST_ADD :
+      aotDecVal(op + 2, &val);
+      aotEmit(var + " = ADD(" + var + ", " + aotLiteral(val) + ");");
+      return;
+    case FAST_SET :
+      aotDecVal(op + 2, &val);
+      aotEmit(var + " = " + aotLiteral(val) + ";");
+      return;
+    case FAST_OUTP :
+      aotDecVal(op + 2, &val);
+      aotPtr = stmt + aotByte(op + 1);
+      var = aotExpr();
+      if (aotCheckDelimiter()) break;
+      aotFailIf("bios_writeGpio(" + aotLiteral(val) + ", " + var + ")", "ERROR_PARA");
+      return;
+    }
+    if (aotStop) {
+      ps.next = AOT_NONE;
+    }
+    return;
+#else
+    ch = aotByte(stmt);
+    aotPtr = stmt + 1;
+    aotEmit("// (the statement of ST_FAST)");
+#endif
+  }
+  if (ch == ST_ARRAY) {
+    std::string var = aotArrayRef(false);
+    if (!aotStop) aotLet(var);
+    ps.next = aotStop ? AOT_NONE : aotPtr;
+  }
+  else
+  if (isupper(ch)) {
+    aotLet(aotFormat("VAR('%c')", ch));
+    ps.next = aotStop ? AOT_NONE : aotPtr;
+  }
+  else
+  if (ch == ST_COMMENT) {
+    while (aotByte(aotPtr) != ST_EOL) aotPtr++;
+    ps.next = aotPtr;
+  }
+  else
+  if (ch >= STCODE_START && ch <= STCODE_END) {
+    ps.next = aotStatement(ch);
+  }
+  else {
+    aotSyntax();
+    ps.next = AOT_NONE;
+  }
+}
+
+//*************************************************
+// nbData(index, &var, depth): READ of one DATA item, returns the error code
+static std::string aotDataFunction(void)
+{
+  std::string code;
+
+  aotDataMode = true;
+  aotOut = &code;
+  for (size_t i = 0; i < aotData.size(); i++) {
+    int16_t line = aotLine[aotData[i]];
+    code += aotFormat("  case %d:   // line %d\n", (int)i, line);
+    aotPtr = aotData[i];
+    aotLineNo = line;
+    aotStop = false;
+    aotCompiled = false;
+    aotDepth = 0;
+    aotTemp = 0;
+    std::string val = aotExprMain();
+    if (aotStop) continue;
+    aotEmit("*val = " + val + ";");
+    uint8_t ch = aotByte(aotPtr);
+    aotEmit((aotIsDelimiter(ch) || ch == ',') ? "return 0;" : "return ERROR_PARA;");
+  }
+  aotDataMode = false;
+  return code;
+}
+
+//*************************************************
+static std::string aotTemps(int num)
+{
+  std::string s;
+  for (int i = 1; i <= num; i++) {
+    s += aotFormat("%s t%d = 0", (i % 8 == 1) ? (i == 1 ? "  nb_int_t" : ";\n  nb_int_t") : ",", i);
+  }
+  return s.empty() ? s : s + ";\n";
+}
+
+//*************************************************
+static int aotWrite(const char *path, const char *source)
+{
+  const EEP_Header_t *eep = (const EEP_Header_t *)aotImage;
+  const char *name = strrchr(source, '/');
+  int16_t arraySize, freeBytes;
+  std::string body, data, tail;
+
+  // translate every reachable position, the first one is the top of line 1
+  int start = aotLineStart(0);
+  aotQueue(start);
+  while (!aotWork.empty()) {
+    int pos = aotWork.back();
+    aotWork.pop_back();
+    aotTranslate(pos);
+    aotQueue(aotPos[pos].next);
+  }
+  data = aotDataFunction();
+  if (!aotUnsupported.empty()) {
+    fprintf(stderr, "%s: %s by --aot\n", source, aotUnsupported.c_str());
+    return 1;
+  }
+
+  // the fall-through to the next position needs no goto
+  std::string jump = "  " + aotGoto(start) + "\n";
+  for (auto it = aotPos.begin(); it != aotPos.end(); ++it) {
+    auto next = std::next(it);
+    int follow = (next == aotPos.end()) ? AOT_END : next->first;
+    if (it->second.next == AOT_NONE || it->second.next == follow) continue;
+    it->second.code += "  " + aotGoto(it->second.next) + "\n";
+  }
+  if (!aotPos.empty() && aotPos.begin()->first == start) {
+    aotRefs[start]--;
+    jump.clear();
+  }
+  if (aotDynGoto) {
+    tail += "nb_goto:\n  switch (lbl) {\n";
+    for (const auto &l : aotLabels) {
+      tail += "  case " + aotLiteral(l.first) + ": " + aotGoto(aotLineStart(l.second)) + "\n";
+    }
+    tail += "  }\n  FAIL(ERROR_LABEL, line);\n";
+  }
+  if (aotReturnJump) {
+    tail += "nb_return:\n  switch (ret) {\n";
+    for (size_t i = 0; i < aotReturns.size(); i++) {
+      tail += aotFormat("  case %d: ", (int)i) + aotGoto(aotReturns[i]) + "\n";
+    }
+    tail += "  }\n";
+  }
+  body = jump;
+  for (const auto &p : aotPos) {
+    if (aotRefs[p.first] > 0) body += aotFormat("P%d:\n", p.first);
+    body += p.second.code;
+  }
+
+  FILE *fp = fopen(path, "w");
+  if (!fp) {
+    fprintf(stderr, "%s: cannot write\n", path);
+    return 1;
+  }
+  basicProgramLimits(&arraySize, &freeBytes);
+  fprintf(fp, "/*\n"
+              " * nanoBASIC UNO - native program\n"
+              " * Generated by nanoBASIC_UNO --aot from %s, do not edit.\n"
+              " * Build with the core and the CLI BIOS (see cli/README.md).\n"
+              " */\n\n"
+              "#include <setjmp.h>\n"
+              "#include <string.h>\n"
+              "#include \"nano_basic_uno.h\"\n"
+              "#include \"nano_basic_uno_conf.h\"\n"
+              "#include \"nano_basic_defs.h\"\n"
+              "#include \"bios_uno.h\"\n\n",
+          name ? name + 1 : source);
+  fprintf(fp, "#define NB_VERSION     0x%02X%02X  // VERSION_MAJOR, VERSION_MINOR\n",
+          eep->verMajor, eep->verMinor);
+  fprintf(fp, "#define NB_FORMAT      0x%02X    // EEP_FORMAT_BUILD\n", eep->format);
+  fprintf(fp, "#if NB_VERSION != ((VERSION_MAJOR << 8) | VERSION_MINOR) || NB_FORMAT != EEP_FORMAT_BUILD\n"
+              "#error \"translated with another version or configuration of nanoBASIC UNO\"\n"
+              "#endif\n\n");
+  fprintf(fp, "#define NB_ARRAY_SIZE  %d    // @array elements\n", arraySize);
+  fprintf(fp, "#define NB_STACK_NUM   %d    // STACK_NUM\n", STACK_NUM);
+  fprintf(fp, "#define NB_FREE        %d    // FREE\n", freeBytes);
+  fprintf(fp, "#define NB_DATA_NUM    %d    // DATA items\n\n", (int)aotData.size());
+  fputs("// Arithmetic wraps around at the width of nb_int_t, like the interpreter\n"
+        "#define ADD(a, b)  ((nb_int_t)((uint32_t)(a) + (uint32_t)(b)))\n"
+        "#define SUB(a, b)  ((nb_int_t)((uint32_t)(a) - (uint32_t)(b)))\n"
+        "#define MUL(a, b)  ((nb_int_t)((uint32_t)(a) * (uint32_t)(b)))\n"
+        "#define NEG(a)     ((nb_int_t)(0u - (uint32_t)(a)))\n"
+        "#define DIV(a, b)  ((nb_int_t)((a) / (b)))\n"
+        "#define MOD(a, b)  ((nb_int_t)((a) % (b)))\n"
+        "#define SHL(a, b)  ((nb_int_t)((uint32_t)(a) << (b)))\n"
+        "#define SHR(a, b)  ((nb_int_t)((int32_t)(a) >> (b)))\n"
+        "#define VAR(c)     V[(c) - 'A']\n\n"
+        "// One statement: Break check and statement count\n"
+        "#define STMT(n)    do { if (*brk) { *brk = 0; FAIL(ERROR_BREAK, n); } ++*cnt; } while (0)\n"
+        "#define FAIL(e, n) do { err = (int8_t)(e); line = (n); goto nb_fail; } while (0)\n\n"
+        "typedef struct {\n"
+        "  uint8_t   type;      // ST_FOR / ST_GOSUB / ST_DO\n"
+        "  uint16_t  ret;       // return point (nb_return)\n"
+        "  nb_int_t  *pvar;\n"
+        "  nb_int_t  limit;\n"
+        "  nb_int_t  step;\n"
+        "} nb_native_stack_t;\n\n"
+        "BIOS_LOCAL jmp_buf reset_env;\n"
+        "int runNative(int argc, char *argv[], int8_t (*program)(void));\n\n"
+        "static nb_int_t V[26];\n"
+        "static nb_int_t AR[NB_ARRAY_SIZE];\n"
+        "static nb_native_stack_t stk[NB_STACK_NUM];\n"
+        "static uint8_t sp;\n"
+        "static uint16_t dataIdx;\n\n"
+        "//*************************************************\n"
+        "static inline nb_int_t nbAbs(nb_int_t a)\n"
+        "{\n"
+        "  return (a < 0) ? NEG(a) : a;\n"
+        "}\n\n"
+        "//*************************************************\n"
+        "static inline bool nbRange(nb_int_t index, nb_int_t count)\n"
+        "{\n"
+        "  return !(index < 0 || count <= 0 || index > NB_ARRAY_SIZE - count);\n"
+        "}\n\n"
+        "//*************************************************\n"
+        "static inline nb_int_t nbArrayFunc(uint8_t func, nb_int_t index, nb_int_t count)\n"
+        "{\n"
+        "  nb_int_t *p = &AR[index], val = *p;\n"
+        "  while (--count) {\n"
+        "    p++;\n"
+        "    switch (func) {\n"
+        "    case FUNC_SUM : val = ADD(val, *p); break;\n"
+        "    case FUNC_MIN : if (*p < val) val = *p; break;\n"
+        "    default       : if (*p > val) val = *p; break;\n"
+        "    }\n"
+        "  }\n"
+        "  return val;\n"
+        "}\n\n"
+        "//*************************************************\n"
+        "static inline void nbFill(nb_int_t index, nb_int_t count, nb_int_t value)\n"
+        "{\n"
+        "  nb_int_t *p = &AR[index];\n"
+        "  while (count--) *p++ = value;\n"
+        "}\n\n"
+        "//*************************************************\n"
+        "static inline void nbShift(nb_int_t index, nb_int_t count, nb_int_t value)\n"
+        "{\n"
+        "  nb_int_t *p = &AR[index];\n"
+        "  memmove(p, p + 1, (count - 1) * sizeof(nb_int_t));\n"
+        "  p[count - 1] = value;\n"
+        "}\n\n"
+        "//*************************************************\n"
+        "// NEXT: true while the loop goes on\n"
+        "static inline bool nbNext(nb_native_stack_t *s)\n"
+        "{\n"
+        "  if (s->limit == *s->pvar) return false;\n"
+        "  *s->pvar = ADD(*s->pvar, s->step);\n"
+        "  if (s->step > 0) return s->limit >= *s->pvar;\n"
+        "  return s->limit <= *s->pvar;\n"
+        "}\n\n"
+        "//*************************************************\n"
+        "static inline void nbPuts(const char *s, int len)\n"
+        "{\n"
+        "  while (len--) basicNativePutChar(*s++);\n"
+        "}\n\n"
+        "//*************************************************\n"
+        "static inline void nbChr(nb_int_t val)\n"
+        "{\n"
+        "  // the same bytes as PRINT CHR() of the interpreter\n"
+        "  if (val >= 0x100) basicNativePutChar((char)((char)val >> 8));\n"
+        "  basicNativePutChar((char)val);\n"
+        "}\n\n"
+        "//*************************************************\n"
+        "static inline bool nbRaw(nb_int_t val, int16_t len)\n"
+        "{\n"
+        "  uint32_t v = (uint32_t)(int32_t)val;\n"
+        "  if (len != 1 && len != 2 && len != 4) return false;\n"
+        "  while (len--) {\n"
+        "    basicNativePutChar((char)(uint8_t)v);\n"
+        "    v >>= 8;\n"
+        "  }\n"
+        "  return true;\n"
+        "}\n\n", fp);
+
+  fputs("//*************************************************\n"
+        "static inline int8_t nbData(uint16_t index, nb_int_t *val, uint8_t depth)\n"
+        "{\n", fp);
+  fputs(aotTemps(aotDataTempMax).c_str(), fp);
+  fputs("  int8_t err = 0;\n\n"
+        "  (void)val; (void)depth; (void)err;\n"
+        "  switch (index) {\n", fp);
+  fputs(data.c_str(), fp);
+  fputs("  }\n"
+        "  return ERROR_UXREAD;\n"
+        "}\n\n", fp);
+
+  fputs("//*************************************************\n"
+        "static int8_t nbProgram(void)\n"
+        "{\n"
+        "  volatile uint8_t *brk = &bios_breakFlag;\n"
+        "  uint32_t *cnt = basicNativeBegin();\n"
+        "  int8_t err = 0;\n"
+        "  int16_t line = 0;\n", fp);
+  if (aotReturnJump) fputs("  uint16_t ret;\n", fp);
+  if (aotDynGoto) fputs("  nb_int_t lbl;\n", fp);
+  fputs(aotTemps(aotTempMax).c_str(), fp);
+  fputs("\n", fp);
+  fputs(aotRunUsed ? "nb_run:\n" : "", fp);
+  fputs("  memset(V, 0, sizeof(V));\n"
+        "  memset(AR, 0, sizeof(AR));\n"
+        "  memset(stk, 0, sizeof(stk));\n"
+        "  sp = 0;\n"
+        "  dataIdx = 0;\n", fp);
+  fputs(body.c_str(), fp);
+  fputs("  goto nb_end;\n", fp);
+  fputs(tail.c_str(), fp);
+  fputs("nb_end:\n"
+        "  return basicNativeEnd(0, 0);\n"
+        "nb_fail:\n"
+        "  return basicNativeEnd(err, line);\n"
+        "}\n\n"
+        "//*************************************************\n"
+        "int main(int argc, char *argv[])\n"
+        "{\n"
+        "  // Save execution context for bios_systemReset()\n"
+        "  if (setjmp(reset_env) != 0) return 1;\n"
+        "  return runNative(argc - 1, argv + 1, nbProgram);\n"
+        "}\n", fp);
+  if (fclose(fp) != 0) {
+    fprintf(stderr, "%s: cannot write\n", path);
+    return 1;
+  }
+  printf("%s: %d statements\n", path, (int)aotPos.size());
+  return 0;
+}
+
+//*************************************************
+static bool aotLoad(const char *path)
+{
+  std::string text;
+  int8_t err;
+  int16_t len;
+
+  if (!bios_cliReadFile(path, text)) {
+    fprintf(stderr, "%s: cannot open\n", path);
+    return false;
+  }
+  bios_cliSetHeadless(NULL);
+  bios_init();
+  if (text.size() >= 2 && text[0] == EEP_MAGIC_1 && text[1] == EEP_MAGIC_2) {
+    bios_cliSetEeprom(path);             // an image: LOAD it
+    err = basicLoadSaved();
+    bios_cliSetEeprom(NULL);
+  }
+  else {
+    err = basicLoadProgram(text.c_str());
+  }
+  if (err) {
+    fprintf(stderr, "%s: error %d while loading\n", path, err);
+    return false;
+  }
+  len = basicProgramImage(aotImage, sizeof(aotImage), false);
+  if (len < 0) {
+    fprintf(stderr, "%s: empty program\n", path);
+    return false;
+  }
+  aotProg = aotImage + EEP_HEADER_SIZE;
+  aotLen = len - (int)EEP_HEADER_SIZE;
+  return true;
+}
+
+//*************************************************
+int aotMain(int argc, char *argv[])
+{
+  if (argc != 2) {
+    fprintf(stderr, "usage: --aot file.bas|image.bin out.cpp\n");
+    return 2;
+  }
+  if (!aotLoad(argv[0])) return 1;
+  aotScanProgram();
+  return aotWrite(argv[1], argv[0]);
+}
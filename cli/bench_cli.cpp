@@ -0,0 +1,183 @@
+/*
+ * nanoBASIC UNO - CLI benchmark runner
+ * --------------------------------------------
+ * Runs BASIC workloads headless (no TTY, no REPL)
+ * through the host API of the nanoBASIC core and
+ * reports one JSON object per workload on stdout:
+ *
+ *   {"name":"for_next","version":"0.19","runs":50,"statements":20001,
+ *    "wall_ms":12.345,"best_ms":1.180,
+ *    "stmt_per_sec":32414000,"ns_per_stmt":30.85,"error":0}
+ *
+ * Usage:
+ *   nanoBASIC_UNO --bench [-n runs] [-o] [file.bas ...]
+ *
+ *   -n runs : repeat each workload (default 50)
+ *   -o      : show program output on stderr
+ *   files   : run these programs instead of the
+ *             built-in workloads
+ *
+ * Program output is discarded unless -o is given.
+ * The exit status is non-zero if any workload fails.
+ *
+ * GitHub: https://github.com/shachi-lab
+ * Copyright (c) 2025-2026 shachi-lab
+ * License: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include "nano_basic_uno.h"
+#include "nano_basic_uno_conf.h"
+#include "nano_basic_defs.h"
+#include "bios_uno.h"
+#include "bios_uno_cli.h"
+
+int benchMain(int argc, char *argv[]);
+
+typedef struct {
+  const char *name;
+  const char *text;
+} bench_workload_t;
+
+// Built-in workloads, each small enough for the UNO program area
+static const bench_workload_t benchWorkloads[] = {
+  { "for_next",
+    "FOR I=1 TO 20000\n"
+    "NEXT\n" },
+  { "while_loop",
+    "I=0\n"
+    "WHILE I<20000\n"
+    "I+=1\n"
+    "LOOP\n" },
+  { "gosub",
+    "FOR I=1 TO 5000\n"
+    "GOSUB 100\n"
+    "NEXT\n"
+    "END\n"
+    "100 GOSUB 200\n"
+    "RETURN\n"
+    "200 A=A+1\n"
+    "RETURN\n" },
+  { "if_branch",
+    "FOR I=1 TO 10000\n"
+    "IF I%3=0 THEN A=A+1 ELSEIF I%3=1 THEN B=B+1 ELSE C=C+1 ENDIF\n"
+    "IF A>B && B>=C THEN D=D+1 ENDIF\n"
+    "NEXT\n" },
+  { "data_read",
+    "FOR J=1 TO 1000\n"
+    "RESTORE\n"
+    "FOR I=1 TO 8\n"
+    "READ A\n"
+    "S=S+A\n"
+    "NEXT\n"
+    "NEXT\n"
+    "DATA 1,2,3,4,5,6,7,8\n" },
+  { "array_math",
+    "FOR J=1 TO 100\n"
+    "FOR I=0 TO 63\n"
+    "@[I]=@[I]+I*J-(J>>1)\n"
+    "NEXT\n"
+    "NEXT\n" },
+  { "gpio_blink",
+    "FOR I=1 TO 10000\n"
+    "OUTP 13,I&1\n"
+    "A=INP(2)\n"
+    "NEXT\n" },
+  { "print",
+    "FOR I=1 TO 2000\n"
+    "? I;\" \";HEX(I,4);\" \";DEC(I*I,8)\n"
+    "NEXT\n" },
+};
+
+//*************************************************
+static void benchPrintName(const char *name)
+{
+  putchar('"');
+  for (; *name; name++) {
+    if (*name == '"' || *name == '\\') putchar('\\');
+    putchar(*name);
+  }
+  putchar('"');
+}
+
+//*************************************************
+static int benchRun(const char *name, const char *text, int runs)
+{
+  int8_t err;
+  uint32_t statements = 0;
+  double total = 0, best = 0;
+
+  if ((err = basicLoadProgram(text)) == 0) {
+    for (int i = 0; i < runs; i++) {
+      auto start = std::chrono::steady_clock::now();
+      err = basicRunProgram();
+      auto stop = std::chrono::steady_clock::now();
+      double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+      if (err) break;
+      total += ms;
+      if (i == 0 || ms < best) best = ms;
+      statements = basicStatementCount();
+    }
+  }
+
+  double sec = total / 1000.0;
+  uint64_t executed = (uint64_t)statements * runs;
+  printf("{\"name\":");
+  benchPrintName(name);
+  printf(",\"version\":\"%d.%d\",\"runs\":%d,\"statements\":%lu,"
+         "\"wall_ms\":%.3f,\"best_ms\":%.3f,\"stmt_per_sec\":%.0f,\"ns_per_stmt\":%.2f,\"error\":%d}\n",
+         VERSION_MAJOR, VERSION_MINOR, runs, (unsigned long)statements,
+         total, best,
+         (err || sec <= 0) ? 0.0 : executed / sec,
+         (err || executed == 0) ? 0.0 : total * 1e6 / executed,
+         err);
+  fflush(stdout);
+  return err;
+}
+
+//*************************************************
+int benchMain(int argc, char *argv[])
+{
+  int runs = 50;
+  FILE *out = NULL;
+  int i, failed = 0, files = 0;
+
+  for (i = 0; i < argc && argv[i][0] == '-'; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      runs = atoi(argv[++i]);
+      if (runs < 1) runs = 1;
+    }
+    else
+    if (strcmp(argv[i], "-o") == 0) {
+      out = stderr;
+    }
+    else {
+      fprintf(stderr, "usage: --bench [-n runs] [-o] [file.bas ...]\n");
+      return 2;
+    }
+  }
+
+  bios_cliSetHeadless(out);
+  bios_init();
+  bios_randomize(1);
+
+  for (; i < argc; i++, files++) {
+    std::string text;
+    if (!bios_cliReadFile(argv[i], text)) {
+      fprintf(stderr, "%s: cannot open\n", argv[i]);
+      failed++;
+      continue;
+    }
+    if (benchRun(argv[i], text.c_str(), runs)) failed++;
+  }
+  if (files == 0) {
+    for (const bench_workload_t &w : benchWorkloads) {
+      if (benchRun(w.name, w.text, runs)) failed++;
+    }
+  }
+  return failed ? 1 : 0;
+}
@@ -8,6 +8,8 @@
  * functions required by the NanoBASIC core:
  *
  *   - Character input/output
+ *   - Break detection (SIGINT / console control handler)
+ *   - Sampling profiler tick (interval timer, POSIX only)
  *   - GPIO (digital input/output)
  *   - PWM output
  *   - ADC (analog input)
@@ -37,21 +39,247 @@
 #include <time.h>
 #include <setjmp.h>
 #include <cstring>
+#include <chrono>
+#include <random>
+#include <string>
+#include "nano_basic_uno.h"
 #include "nano_basic_defs.h"
 #include "bios_uno.h"
+#include "bios_uno_cli.h"
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <errno.h>
+#endif
 
-extern jmp_buf reset_env;
+extern BIOS_LOCAL jmp_buf reset_env;
 
 static void bios_consoleInit( void );
 static void bios_systemTickInit( void );
+#ifndef _WIN32
+static int bios_consoleRaw( void );
+#endif
 static void bios_polling( void );
+#if PROFILE_SAMPLE_NUM
+static void bios_sampleInit( void );
+#endif
+
+BIOS_LOCAL volatile uint8_t bios_breakFlag;
+BIOS_LOCAL volatile uint8_t bios_sampleContext;
+
+// bios_breakFlag of the thread that owns the console: Ctrl-C handlers
+// run on another thread (Windows) or any thread (SIGINT)
+static volatile uint8_t *volatile consoleBreakFlag;
+
+static BIOS_LOCAL bool headless;
+static BIOS_LOCAL FILE *headlessOut;
+static BIOS_LOCAL std::string *headlessBuf;
+static BIOS_LOCAL const char *headlessIn;
+
+// Virtual clock: statements and waits advance it, nothing sleeps
+static BIOS_LOCAL bool virtualTime;
+static BIOS_LOCAL uint32_t virtualCost;       // [us] per statement
+static BIOS_LOCAL uint64_t virtualUs;
+static BIOS_LOCAL uint32_t virtualCount;      // statement count at the last update
+
+// Console input read-ahead: stdin is read in chunks, not per character
+#define STDIN_READ_SIZE   4096
+#define STDIN_EOF         (-2)                 // bios_stdinGetByte(): end of input
+static BIOS_LOCAL uint8_t stdinBuf[STDIN_READ_SIZE];
+static BIOS_LOCAL uint16_t stdinHead, stdinTail;
+static BIOS_LOCAL bool stdinEof;
+static BIOS_LOCAL bool stdinCr;                // last byte was CR (CR/LF is one Enter)
+static bool stdinPipe;                         // REPL stdin is a pipe or file, not a terminal
 
 //*************************************************
 void bios_init(void)
 {
-  bios_consoleInit();
+  if (!headless) bios_consoleInit();
   bios_systemTickInit();
   bios_randomize( 0 );
+#if PROFILE_SAMPLE_NUM
+  bios_sampleInit();
+#endif
+}
+
+//*************************************************
+void bios_cliSetHeadless( FILE *out )
+{
+  headless = true;
+  headlessOut = out;
+  headlessBuf = NULL;
+}
+
+//*************************************************
+void bios_cliSetCapture( std::string *buf )
+{
+  headless = true;
+  headlessOut = NULL;
+  headlessBuf = buf;
+}
+
+//*************************************************
+void bios_cliSetInput( const char *text )
+{
+  headlessIn = text;
+}
+
+//*************************************************
+bool bios_cliInputLeft( void )
+{
+  return headlessIn && *headlessIn;
+}
+
+//*************************************************
+void bios_cliSetVirtualTime( bool enable, uint32_t stmt_us )
+{
+  virtualTime = enable;
+  virtualCost = stmt_us;
+}
+
+//*************************************************
+static void bios_virtualUpdate( void )
+{
+  uint32_t count = basicStatementCount();
+  // the counter restarts at every basicRunProgram()
+  uint32_t delta = (count >= virtualCount) ? count - virtualCount : count;
+  virtualCount = count;
+  virtualUs += (uint64_t)delta * virtualCost;
+}
+
+//*************************************************
+// Virtual clock: a wait moves the clock to its end at once
+static bool bios_virtualIdle( nb_int_t max_ms )
+{
+  if (!virtualTime) return false;
+  if (max_ms > 0 && !bios_breakFlag) {
+    bios_virtualUpdate();
+    virtualUs += (uint64_t)max_ms * 1000;
+  }
+  return true;
+}
+
+//*************************************************
+bool bios_cliReadFile( const char *path, std::string &text )
+{
+  FILE *fp = fopen(path, "rb");
+  if (!fp) return false;
+  char buf[4096];
+  size_t n;
+  text.clear();
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    text.append(buf, n);
+  }
+  fclose(fp);
+  return true;
+}
+
+//*************************************************
+static bool bios_headlessPutChar( char ch )
+{
+  if (!headless) return false;
+  if (headlessBuf) headlessBuf->push_back(ch);
+  else if (headlessOut) fputc(ch, headlessOut);
+  return true;
+}
+
+//*************************************************
+static bool bios_headlessWrite( const char *buf, uint8_t len )
+{
+  if (!headless) return false;
+  if (headlessBuf) headlessBuf->append(buf, len);
+  else if (headlessOut) fwrite(buf, 1, len, headlessOut);
+  return true;
+}
+
+//*************************************************
+int16_t bios_consoleWritable( void )
+{
+  return 0x7fff;          // host stdout never drops
+}
+
+//*************************************************
+// One read() into the empty buffer, false if nothing is ready
+// (non-blocking stdin) or at the end of the input (stdinEof)
+static bool bios_stdinFill( void )
+{
+  if (stdinEof) return false;
+#ifdef _WIN32
+  int n = _read(_fileno(stdin), stdinBuf, sizeof(stdinBuf));
+#else
+  ssize_t n = read(STDIN_FILENO, stdinBuf, sizeof(stdinBuf));
+  if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+    return false;
+  }
+#endif
+  if (n <= 0) {
+    stdinEof = true;
+    return false;
+  }
+  stdinHead = 0;
+  stdinTail = (uint16_t)n;
+  return true;
+}
+
+//*************************************************
+// Next byte of stdin, -1 if none is ready (non-blocking stdin)
+// or STDIN_EOF. One read() fills the buffer for the next bytes.
+// Text from a pipe or file ends its lines with LF or CR/LF,
+// which are passed on as CR (Enter) like a terminal in raw mode.
+static int16_t bios_stdinGetByte( void )
+{
+  if (stdinHead == stdinTail && !bios_stdinFill()) {
+    return stdinEof ? STDIN_EOF : -1;
+  }
+  uint8_t ch = stdinBuf[stdinHead++];
+  if (headless || stdinPipe) {
+    bool lf = (ch == ASCII_LF);
+    if (lf && stdinCr) {
+      stdinCr = false;
+      return bios_stdinGetByte();
+    }
+    stdinCr = (ch == ASCII_CR);
+    if (lf) ch = ASCII_CR;
+  }
+  return ch;
+}
+
+//*************************************************
+// Console input from stdin outside of headless mode
+static int16_t bios_stdinGetChar( void )
+{
+  int16_t ch = bios_stdinGetByte();
+  if (ch == STDIN_EOF || ch == ASCII_EOT) {   // end of piped input, Ctrl-D
+    fflush(stdout);
+    exit(0);
+  }
+  if (ch == CHR_BREAK) {  // Ctrl-C from a pipe (no SIGINT)
+    bios_breakFlag = 1;
+    return -1;
+  }
+  return ch;
+}
+
+//*************************************************
+static int16_t bios_headlessGetChar( void )
+{
+  int16_t ch;
+  if (headlessIn) {
+    ch = *headlessIn ? (uint8_t)*headlessIn++ : STDIN_EOF;
+  }
+  else {
+    ch = bios_stdinGetByte();
+  }
+  if (ch == STDIN_EOF) {  // end of scripted input stops the program
+    bios_breakFlag = 1;
+    return -1;
+  }
+  if (ch == CHR_BREAK) {
+    bios_breakFlag = 1;
+    return -1;
+  }
+  return ch;
 }
 
 //*************************************************
@@ -65,10 +293,29 @@ void bios_init(void)
 #include <queue>
 #include <string>
 
+//*************************************************
+static BOOL WINAPI bios_ctrlHandler(DWORD type)
+{
+  if (type == CTRL_C_EVENT || type == CTRL_BREAK_EVENT) {
+    if (consoleBreakFlag) *consoleBreakFlag = 1;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+//*************************************************
 static void bios_consoleInit(void)
 {
   HANDLE hInput = GetStdHandle(STD_INPUT_HANDLE);
   static bool initialized = false;
+  consoleBreakFlag = &bios_breakFlag;
+  if (!initialized && !_isatty(_fileno(stdin))) {
+    // Pipe or file: no console mode, input is read in chunks
+    stdinPipe = true;
+    SetConsoleOutputCP(65001);
+    SetConsoleCtrlHandler(bios_ctrlHandler, TRUE);
+    initialized = true;
+  }
   if (!initialized) {
     SetConsoleCP(65001);
     SetConsoleOutputCP(65001);
@@ -76,7 +323,8 @@ static void bios_consoleInit(void)
     GetConsoleMode(hInput, &mode);
     // ENABLE_VIRTUAL_TERMINAL_INPUT LɂƁAOSCSIoƂ܂A
     // OŐ䂷邽߂ɂăItiRaw[hjɋ߂ݒɂ܂B
-    SetConsoleMode(hInput, mode & ~(ENABLE_LINE_INPUT | ENABLE_ECHO_INPUT | ENABLE_PROCESSED_INPUT));
+    SetConsoleMode(hInput, (mode & ~(ENABLE_LINE_INPUT | ENABLE_ECHO_INPUT)) | ENABLE_PROCESSED_INPUT);
+    SetConsoleCtrlHandler(bios_ctrlHandler, TRUE);
     initialized = true;
   }
 }
@@ -91,6 +339,8 @@ void bios_consolePutChar( char c )
   static std::vector<unsigned char> s_buffer;
   unsigned char ch = (unsigned char)c;
 
+  if (bios_headlessPutChar(c)) return;
+
   // 1. ASCII (0xxxxxxx) ̏ꍇ
   if ((ch & 0x80) == 0) {
     s_buffer.clear(); // Ô߃obt@NA
@@ -127,6 +377,14 @@ void bios_consolePutChar( char c )
   }
 }
 
+//*************************************************
+void bios_consoleWrite( const char *buf, uint8_t len )
+{
+  if (bios_headlessWrite(buf, len)) return;
+  while (len--) bios_consolePutChar(*buf++);
+  fflush(stdout);
+}
+
 
 static std::queue<unsigned char> utf8_queue;
 
@@ -151,6 +409,8 @@ static void push_sequence(const char* seq) {
 int16_t bios_consoleGetChar(void)
 {
   bios_polling();
+  if (headless) return bios_headlessGetChar();
+  if (stdinPipe) return bios_stdinGetChar();
 
   while (true)
   {
@@ -177,7 +437,10 @@ int16_t bios_consoleGetChar(void)
         bool isCtrl = (ctrl & (LEFT_CTRL_PRESSED | RIGHT_CTRL_PRESSED));
 
         // --- L[̏ ---
-        if (isCtrl && vk == 'C') return 0x03; // Ctrl+C
+        if (isCtrl && vk == 'C') {            // Ctrl+C
+          bios_breakFlag = 1;
+          continue;
+        }
         if (isCtrl && vk == 'D') exit(0);     // Ctrl+D
 
         // --- CSIV[PXɕϊ ---
@@ -202,13 +465,38 @@ int16_t bios_consoleGetChar(void)
     }
   }
 }
+
+//*************************************************
+void bios_idle( nb_int_t max_ms )
+{
+  if (bios_virtualIdle(max_ms)) return;
+  if (max_ms <= 0 || bios_breakFlag || !utf8_queue.empty()) return;
+  // Ctrl-C is delivered on another thread and does not signal the
+  // input handle, so keep each wait short for the break latency
+  if (max_ms > 10) max_ms = 10;
+  // a pipe or file cannot be waited on (and is often at its end)
+  if (headless || stdinPipe) {
+    Sleep((DWORD)max_ms);
+    return;
+  }
+  WaitForSingleObject(GetStdHandle(STD_INPUT_HANDLE), (DWORD)max_ms);
+}
+
+#if PROFILE_SAMPLE_NUM
+//*************************************************
+static void bios_sampleInit(void)
+{
+  // not supported on Windows: the histogram stays empty
+}
+#endif
 #else
 
-#include <unistd.h>
 #include <termios.h>
 #include <fcntl.h>
-#include <errno.h>
 #include <signal.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/stat.h>
 
 //*************************************************
 static struct termios original_termios;
@@ -219,7 +507,9 @@ static void bios_consoleRestore(void)
   if (original_flags != -1) {
     fcntl(STDIN_FILENO, F_SETFL, original_flags);
   }
-  tcsetattr(STDIN_FILENO, TCSANOW, &original_termios);
+  if (!stdinPipe) {
+    tcsetattr(STDIN_FILENO, TCSANOW, &original_termios);
+  }
 }
 
 static void cleanup_handler(void)
@@ -229,23 +519,17 @@ static void cleanup_handler(void)
 
 static void sigint_handler(int sig)
 {
-  bios_consoleRestore();
-  _exit(0);
+  (void)sig;
+  if (consoleBreakFlag) *consoleBreakFlag = 1;
 }
 
 //*************************************************
 static void bios_consoleInit(void)
 {
-  if (tcgetattr(STDIN_FILENO, &original_termios) != 0) {
-    perror("tcgetattr failed");
-    return;
-  }
-
-  struct termios newt = original_termios;
-  newt.c_lflag &= ~(ICANON | ECHO | ISIG);
-  newt.c_iflag &= ~(ICRNL);
-  if (tcsetattr(STDIN_FILENO, TCSANOW, &newt) != 0) {
-    perror("tcsetattr failed");
+  // A pipe or file has no terminal modes: only O_NONBLOCK is set,
+  // so INKEY() and the break check do not wait for the next chunk
+  stdinPipe = !isatty(STDIN_FILENO);
+  if (!stdinPipe && bios_consoleRaw() != 0) {
     return;
   }
   if ((original_flags = fcntl(STDIN_FILENO, F_GETFL, 0)) == -1) {
@@ -256,64 +540,200 @@ static void bios_consoleInit(void)
     perror("fcntl F_SETFL O_NONBLOCK failed");
     return;
   }
+  consoleBreakFlag = &bios_breakFlag;
   signal(SIGINT, sigint_handler);
   atexit(cleanup_handler);
 }
 
+//*************************************************
+static int bios_consoleRaw(void)
+{
+  if (tcgetattr(STDIN_FILENO, &original_termios) != 0) {
+    perror("tcgetattr failed");
+    return -1;
+  }
+
+  struct termios newt = original_termios;
+  // ISIG stays enabled so that Ctrl-C raises SIGINT (break request)
+  // without reading stdin. NOFLSH keeps typed-ahead keys for INKEY().
+  newt.c_lflag &= ~(ICANON | ECHO);
+  newt.c_lflag |= (ISIG | NOFLSH);
+  newt.c_iflag &= ~(ICRNL);
+  newt.c_cc[VINTR] = CHR_BREAK;
+  newt.c_cc[VQUIT] = _POSIX_VDISABLE;
+  newt.c_cc[VSUSP] = _POSIX_VDISABLE;
+  if (tcsetattr(STDIN_FILENO, TCSANOW, &newt) != 0) {
+    perror("tcsetattr failed");
+    return -1;
+  }
+  return 0;
+}
+
+#if PROFILE_SAMPLE_NUM
+//*************************************************
+static void sample_handler(int sig)
+{
+  (void)sig;
+  basicProfileSample();
+}
+
+//*************************************************
+static void bios_sampleInit(void)
+{
+  struct sigaction sa;
+  struct itimerval tv;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = sample_handler;
+  sa.sa_flags = SA_RESTART;
+  sigaction(SIGALRM, &sa, NULL);
+
+  // 1ms wall-clock period, like Timer0 on the UNO
+  tv.it_interval.tv_sec = 0;
+  tv.it_interval.tv_usec = 1000;
+  tv.it_value = tv.it_interval;
+  setitimer(ITIMER_REAL, &tv, NULL);
+}
+#endif
+
+//*************************************************
+static bool bios_stdinPending( void )
+{
+  return stdinHead != stdinTail || stdinEof;
+}
+
 //*************************************************
 void bios_consolePutChar(char ch)
 {
+  if (bios_headlessPutChar(ch)) return;
   putchar(ch);
 }
 
+//*************************************************
+void bios_consoleWrite(const char *buf, uint8_t len)
+{
+  if (bios_headlessWrite(buf, len)) return;
+  fwrite(buf, 1, len, stdout);
+  // the echo of read-ahead input is flushed once the buffer is drained
+  if (!bios_stdinPending()) fflush(stdout);
+}
+
 //*************************************************
 int16_t bios_consoleGetChar(void)
 {
   bios_polling();
+  if (headless) return bios_headlessGetChar();
+  return bios_stdinGetChar();
+}
 
-  int ch = getchar();
-  if (ch == EOF) {
-    if (errno == EAGAIN || errno == EWOULDBLOCK) {
-      errno = 0;
-      return -1;
-    }
-    return -1;
+//*************************************************
+// poll() reports a file or /dev/null ready at once, so only a
+// terminal, pipe or socket can be waited on for input
+static bool bios_stdinWaitable( void )
+{
+  static int waitable = -1;
+  struct stat st;
+
+  if (waitable < 0) {
+    waitable = isatty(STDIN_FILENO) ||
+               (fstat(STDIN_FILENO, &st) == 0 && (S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode)));
   }
-  if (ch == ASCII_EOT) {  // Ctrl-D
-    exit(0);
+  return waitable;
+}
+
+//*************************************************
+void bios_idle(nb_int_t max_ms)
+{
+  struct pollfd fds;
+
+  if (bios_virtualIdle(max_ms)) return;
+  if (max_ms <= 0 || bios_breakFlag) return;
+  if (headlessIn) {
+    // a break may come from another thread (no EINTR),
+    // so keep each wait short
+    poll(NULL, 0, max_ms > 10 ? 10 : (int)max_ms);
+    return;
+  }
+  // Input that is already read ahead (or at its end) is not what the
+  // caller waits for: sleep, early only with EINTR
+  if (bios_stdinPending() || !bios_stdinWaitable()) {
+    poll(NULL, 0, (int)max_ms);
+    return;
+  }
+  // Wakes on a key, or early with EINTR on SIGINT (break) and SIGALRM.
+  // The ready input is read ahead, so a wait that does not read it
+  // (DELAY) sleeps the next time instead of returning at once.
+  fds.fd = STDIN_FILENO;
+  fds.events = POLLIN;
+  fds.revents = 0;
+  if (poll(&fds, 1, (int)max_ms) > 0) {
+    bios_stdinFill();
   }
-  return (int16_t)ch;
 }
 #endif
 
 //*************************************************
 //    Timing utilities
 //*************************************************
-static clock_t start_clock;
+// Wall-clock milliseconds like millis(): clock() counts CPU time,
+// which stops while bios_idle() sleeps.
+static BIOS_LOCAL std::chrono::steady_clock::time_point start_clock;
 //*************************************************
 static void bios_systemTickInit( void )
 {
-  start_clock = clock();
+  start_clock = std::chrono::steady_clock::now();
+  virtualUs = 0;
+  virtualCount = basicStatementCount();
 }
 
 //*************************************************
 nb_int_t bios_getSystemTick( void )
 {
-  clock_t now = clock();
-  uint32_t ms = (uint32_t)((now - start_clock) * 1000 / CLOCKS_PER_SEC);
+  if (virtualTime) {
+    bios_virtualUpdate();
+    return (nb_int_t)(uint32_t)(virtualUs / 1000);
+  }
+  auto now = std::chrono::steady_clock::now();
+  uint32_t ms = (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(now - start_clock).count();
   return (nb_int_t)ms;
 }
 
+//*************************************************
+nb_int_t bios_getMicroTick( void )
+{
+  if (virtualTime) {
+    bios_virtualUpdate();
+    return (nb_int_t)(uint32_t)virtualUs;
+  }
+  auto now = std::chrono::steady_clock::now();
+  uint32_t us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(now - start_clock).count();
+  return (nb_int_t)us;
+}
+
 //*************************************************
 //    Random number
 //*************************************************
+// Per-thread generator with the same sequence on every host (unlike rand())
+static BIOS_LOCAL std::minstd_rand randState;
+static BIOS_LOCAL bool randFixed;
+static BIOS_LOCAL uint32_t randSeed;
+
+//*************************************************
+void bios_cliSetSeed( uint32_t seed )
+{
+  randFixed = true;
+  randSeed = seed;
+  randState.seed(seed);
+}
+
 //*************************************************
 void bios_randomize( nb_int_t val )
 {
   if (val == 0) {
-      srand((unsigned int)time(NULL));
+    // RANDOMIZE 0 and startup are reproducible once a seed is set
+    randState.seed(randFixed ? randSeed : (uint32_t)time(NULL));
   } else {
-      srand((unsigned int)val);
+    randState.seed((uint32_t)val);
   }
 }
 
@@ -321,7 +741,7 @@ void bios_randomize( nb_int_t val )
 nb_int_t bios_rand( nb_int_t val )
 {
   if (val <= 0) return 0;
-  return (nb_int_t)(rand() % val);
+  return (nb_int_t)(randState() % (uint32_t)val);
 }
 
 //*************************************************
@@ -349,12 +769,68 @@ int8_t bios_readGpio( nb_int_t pin )
 int16_t bios_readAdc( nb_int_t ch )
 {
   // ch : 0..5 (A0..A5)
+  ch &= ~BIOS_ADC_FRESH;
   if(ch < 0 || ch > 5) {
     return -1;
   }
   return 0;
 }
 
+//*************************************************
+//    Timed capture (SAMPLE)
+//*************************************************
+// No timer interrupt on the host: the readings that are due by now
+// are stored when the core polls bios_captureRemain().
+static BIOS_LOCAL nb_int_t *captureBuf;
+static BIOS_LOCAL nb_int_t captureRemain;
+static BIOS_LOCAL nb_int_t capturePeriod;
+static BIOS_LOCAL nb_int_t captureSource;
+static BIOS_LOCAL nb_int_t captureLast;
+
+//*************************************************
+int8_t bios_captureStart( nb_int_t source, nb_int_t *buf, nb_int_t count, nb_int_t period )
+{
+  if(count <= 0 || period <= 0) {
+    return -1;
+  }
+  if(source & BIOS_CAPTURE_ADC) {
+    if(bios_readAdc(source & ~BIOS_CAPTURE_ADC) < 0) return -1;
+  }
+  else {
+    if(bios_readGpio(source) < 0) return -1;
+  }
+  captureBuf = buf;
+  captureRemain = count;
+  capturePeriod = period;
+  captureSource = source;
+  captureLast = bios_getSystemTick() - period + 1;
+  return 0;
+}
+
+//*************************************************
+nb_int_t bios_captureRemain( void )
+{
+  nb_int_t now = bios_getSystemTick();
+
+  while(captureRemain > 0 && (nb_int_t)(now - captureLast) >= capturePeriod) {
+    captureLast += capturePeriod;
+    if(captureSource & BIOS_CAPTURE_ADC) {
+      *captureBuf++ = bios_readAdc(captureSource & ~BIOS_CAPTURE_ADC);
+    }
+    else {
+      *captureBuf++ = bios_readGpio(captureSource);
+    }
+    captureRemain--;
+  }
+  return captureRemain;
+}
+
+//*************************************************
+void bios_captureStop( void )
+{
+  captureRemain = 0;
+}
+
 //*************************************************
 int8_t bios_setPwm( nb_int_t pin, nb_int_t value )
 {
@@ -364,11 +840,36 @@ int8_t bios_setPwm( nb_int_t pin, nb_int_t value )
   return 0;
 }
 
+//*************************************************
+int8_t bios_writePort( nb_int_t port, nb_int_t value, nb_int_t mask )
+{
+  if(port < 0 || port > 2) {
+    return -1;
+  }
+  return 0;
+}
+
+//*************************************************
+int16_t bios_readPort( nb_int_t port )
+{
+  if(port < 0 || port > 2) {
+    return -1;
+  }
+  return 0;
+}
+
+//*************************************************
+int8_t bios_setPortDir( nb_int_t port, nb_int_t dir, nb_int_t mask )
+{
+  if(port < 0 || port > 2) {
+    return -1;
+  }
+  return 0;
+}
+
 //*************************************************
 //    Syetem reset
 //*************************************************
-#include <setjmp.h>
-extern jmp_buf reset_env;
 //*************************************************
 void bios_systemReset( void )
 {
@@ -380,17 +881,28 @@ void bios_systemReset( void )
 //*************************************************
 #define EEPROM_SIZE 1024
 #define EEPROM_FILE "eeprom.bin"
-static FILE* eep;
+static BIOS_LOCAL FILE* eep;
+static BIOS_LOCAL const char *eepFile = EEPROM_FILE;
+
+//*************************************************
+void bios_cliSetEeprom( const char *path )
+{
+  if (eep) {
+    fclose(eep);
+    eep = NULL;
+  }
+  eepFile = path ? path : EEPROM_FILE;
+}
 
 //*************************************************
 static FILE* bios_eepOpenRW( void )
 {
   if (!eep) {
-    eep = fopen(EEPROM_FILE, "rb");
+    eep = fopen(eepFile, "rb");
     if (!eep) {
       return eep;
     }
-    eep = freopen(EEPROM_FILE, "r+b", eep);
+    eep = freopen(eepFile, "r+b", eep);
   }
   return eep;
 }
@@ -426,7 +938,7 @@ void bios_eepWriteBlock( uint16_t addr, const uint8_t* buf, uint16_t len )
 
   eep = bios_eepOpenRW();
   if (!eep) {
-    eep = fopen(EEPROM_FILE, "w+b");
+    eep = fopen(eepFile, "w+b");
   }
   if (!eep) return;
 
@@ -0,0 +1,58 @@
+/*
+ * CLI-only BIOS extensions for nanoBASIC UNO
+ * --------------------------------------------
+ * Host-side controls that have no counterpart
+ * on the Arduino board. They are used by the
+ * CLI runners (benchmark, tests) and are not
+ * part of the portable BIOS interface in
+ * bios_uno.h.
+ *
+ * GitHub: https://github.com/shachi-lab
+ * Copyright (c) 2025-2026 shachi-lab
+ * License: MIT
+ */
+
+#ifndef __BIOS_UNO_CLI_H
+#define __BIOS_UNO_CLI_H
+
+#include <stdio.h>
+#include <string>
+
+// Headless mode (call before basicInit() / bios_init())
+// The terminal is left untouched, console output goes to 'out'
+// (NULL: discarded) and console input is read from stdin.
+// End of input raises a break request instead of exiting.
+void bios_cliSetHeadless( FILE *out );
+
+// Headless mode with the console output appended to 'buf'
+void bios_cliSetCapture( std::string *buf );
+
+// Console input of headless mode from 'text' instead of stdin
+// (NULL: stdin). The text must stay valid while it is read.
+void bios_cliSetInput( const char *text );
+
+// True while the text of bios_cliSetInput() is not read to its end
+bool bios_cliInputLeft( void );
+
+// Virtual clock (time-warp)
+// bios_getSystemTick() and bios_getMicroTick() advance by 'stmt_us'
+// microseconds per executed statement, and bios_idle() moves the
+// clock to the end of the wait instead of sleeping (DELAY, INKEY()
+// timeouts, waits for input).
+// Runs are reproducible and independent of the host speed.
+void bios_cliSetVirtualTime( bool enable, uint32_t stmt_us );
+
+// Random seed used at startup and by RANDOMIZE 0 instead of the time
+void bios_cliSetSeed( uint32_t seed );
+
+// Whole file into 'text' (binary), false if it cannot be opened
+bool bios_cliReadFile( const char *path, std::string &text );
+
+// EEPROM backing file (default "eeprom.bin", NULL: back to default)
+// The path is not copied, it must stay valid while the file is used.
+// With CONTEXT_ENABLE these settings and the rest of the BIOS
+// state are per thread, so call them on the thread that runs
+// the interpreter context.
+void bios_cliSetEeprom( const char *path );
+
+#endif
@@ -11,15 +11,50 @@
  */
 
 #include <setjmp.h>
+#include <string.h>
 #include "nano_basic_uno.h"
+#include "nano_basic_defs.h"
+#include "bios_uno.h"
 
 // Jump buffer used for system reset
-jmp_buf reset_env;
+BIOS_LOCAL jmp_buf reset_env;
 
-int main()
+// Headless benchmark runner (bench_cli.cpp)
+int benchMain(int argc, char *argv[]);
+// Program image / upload / ROM tool (upload_cli.cpp)
+int uploadMain(int argc, char *argv[]);
+// Parallel test runner (test_cli.cpp)
+int testMain(int argc, char *argv[]);
+// Headless program runner (run_cli.cpp)
+int runMain(int argc, char *argv[]);
+// Ahead-of-time compiler to C (aot_cli.cpp)
+int aotMain(int argc, char *argv[]);
+
+int main(int argc, char *argv[])
 {
+  bool bench = (argc > 1 && strcmp(argv[1], "--bench") == 0);
+  bool run = (argc > 1 && strcmp(argv[1], "--run") == 0);
+
   // Save execution context for bios_systemReset()
-  setjmp(reset_env);
+  if (setjmp(reset_env) != 0) {
+    if (bench || run) return 1;   // RESET inside a workload
+  }
+  if (bench) {
+    return benchMain(argc - 2, argv + 2);
+  }
+  if (run) {
+    return runMain(argc - 2, argv + 2);
+  }
+  if (argc > 1 && (strcmp(argv[1], "--image") == 0 || strcmp(argv[1], "--upload") == 0 ||
+                   strcmp(argv[1], "--rom") == 0)) {
+    return uploadMain(argc - 1, argv + 1);
+  }
+  if (argc > 1 && strcmp(argv[1], "--test") == 0) {
+    return testMain(argc - 2, argv + 2);
+  }
+  if (argc > 1 && strcmp(argv[1], "--aot") == 0) {
+    return aotMain(argc - 2, argv + 2);
+  }
 
   // Initialize nanoBASIC core and BIOS
   basicInit();
@@ -0,0 +1,136 @@
+/*
+ * nanoBASIC UNO - CLI headless program runner
+ * --------------------------------------------
+ * Runs one .bas program without a terminal, for
+ * scripts and CI. With a virtual clock and a fixed
+ * seed the output is the same on every run, and
+ * long waits do not take real time.
+ *
+ * Usage:
+ *   nanoBASIC_UNO --run [-c us] [-s seed] [-i input] file.bas
+ *
+ *   -c us    : virtual clock, each statement takes 'us'
+ *              microseconds and DELAY / INKEY() timeouts
+ *              end at once (0: only the waits advance it)
+ *   -s seed  : random seed (RND is reproducible)
+ *   -i input : console input, one line per Enter
+ *              (default: stdin)
+ *
+ * The output goes to stdout. End of the input stops
+ * the program with Break. The exit status is non-zero
+ * if the program stops with an error.
+ *
+ * A program translated by --aot (aot_cli.cpp) links this
+ * file and starts with runNative(), which takes the same
+ * options.
+ *
+ * GitHub: https://github.com/shachi-lab
+ * Copyright (c) 2025-2026 shachi-lab
+ * License: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include "nano_basic_uno.h"
+#include "nano_basic_uno_conf.h"
+#include "nano_basic_defs.h"
+#include "bios_uno.h"
+#include "bios_uno_cli.h"
+
+int runMain(int argc, char *argv[]);
+int runNative(int argc, char *argv[], int8_t (*program)(void));
+
+//*************************************************
+// -c / -s / -i, returns the index of the first other argument (-1: error)
+static int runOptions(int argc, char *argv[], std::string &input)
+{
+  const char *inputFile = NULL;
+  int i;
+
+  for (i = 0; i < argc && argv[i][0] == '-'; i++) {
+    if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      bios_cliSetVirtualTime(true, (uint32_t)strtoul(argv[++i], NULL, 0));
+    }
+    else
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      bios_cliSetSeed((uint32_t)strtoul(argv[++i], NULL, 0));
+    }
+    else
+    if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+      inputFile = argv[++i];
+    }
+    else {
+      break;
+    }
+  }
+  if (inputFile) {
+    if (!bios_cliReadFile(inputFile, input)) {
+      fprintf(stderr, "%s: cannot open\n", inputFile);
+      return -1;
+    }
+    // lines are typed with Enter (CR)
+    input.erase(std::remove(input.begin(), input.end(), '\r'), input.end());
+    std::replace(input.begin(), input.end(), '\n', '\r');
+    bios_cliSetInput(input.c_str());
+  }
+  return i;
+}
+
+//*************************************************
+int runMain(int argc, char *argv[])
+{
+  std::string text, input;
+  int i;
+
+  i = runOptions(argc, argv, input);
+  if (i < 0) return 2;
+  if (argc - i != 1) {
+    fprintf(stderr, "usage: --run [-c us] [-s seed] [-i input] file.bas\n");
+    return 2;
+  }
+  if (!bios_cliReadFile(argv[i], text)) {
+    fprintf(stderr, "%s: cannot open\n", argv[i]);
+    return 2;
+  }
+
+  bios_cliSetHeadless(stdout);
+  bios_init();
+  int8_t err = basicLoadProgram(text.c_str());
+  if (err == 0) {
+    err = basicRunProgram();
+  }
+  fflush(stdout);
+  if (err && err != (int8_t)ERROR_BREAK) {
+    fprintf(stderr, "%s: error %d\n", argv[i], err);
+    return 1;
+  }
+  return 0;
+}
+
+//*************************************************
+// main() of a program translated by --aot (aot_cli.cpp), same options as --run
+int runNative(int argc, char *argv[], int8_t (*program)(void))
+{
+  std::string input;
+  int i;
+
+  i = runOptions(argc, argv, input);
+  if (i < 0) return 2;
+  if (i != argc) {
+    fprintf(stderr, "usage: [-c us] [-s seed] [-i input]\n");
+    return 2;
+  }
+
+  bios_cliSetHeadless(stdout);
+  bios_init();
+  int8_t err = program();
+  fflush(stdout);
+  if (err && err != (int8_t)ERROR_BREAK) {
+    fprintf(stderr, "error %d\n", err);
+    return 1;
+  }
+  return 0;
+}
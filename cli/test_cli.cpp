@@ -0,0 +1,386 @@
+/*
+ * nanoBASIC UNO - CLI parallel test runner
+ * --------------------------------------------
+ * Runs every .bas program of a directory headless
+ * and compares its console output with the expected
+ * output in the .out file of the same name.
+ *
+ * Usage:
+ *   nanoBASIC_UNO --test [-j jobs] [-t sec] [-c us] [-u] [-v] dir
+ *
+ *   -j jobs : worker threads (default: number of host cores)
+ *   -t sec  : time limit per program (default 10)
+ *   -c us   : virtual clock, 'us' microseconds per statement
+ *             (see --run), the time limit stays in real time
+ *   -u      : write the output to the .out files instead of
+ *             comparing (to create or update the expectations)
+ *   -v      : show the first differing line of a failure
+ *
+ * If prog.in exists it is the console input of prog.bas,
+ * otherwise the input is empty (INPUT stops with Break).
+ * The lines the program leaves unread are then entered as
+ * direct commands, as typed at the OK prompt.
+ * The program size of LIST ("[123 bytes]") is not compared.
+ * Its lines are typed with CR (Enter) and line endings
+ * are ignored in the output comparison.
+ *
+ * Each worker owns one interpreter context (nb_context_t)
+ * and takes the next program from a shared queue. Output is
+ * captured in memory, and every worker has its own EEPROM
+ * file, so SAVE/LOAD in one program does not affect another.
+ *
+ * One line per program is printed in name order:
+ *
+ *   PASS   loop.bas  1.234 ms  20001 stmts
+ *   FAIL   input.bas  0.120 ms  12 stmts  error 1
+ *
+ * The exit status is non-zero if any program fails.
+ *
+ * GitHub: https://github.com/shachi-lab
+ * Copyright (c) 2025-2026 shachi-lab
+ * License: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <setjmp.h>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "nano_basic_uno.h"
+#include "nano_basic_uno_conf.h"
+#include "nano_basic_defs.h"
+#include "bios_uno.h"
+#include "bios_uno_cli.h"
+
+int testMain(int argc, char *argv[]);
+
+#if !CONTEXT_ENABLE
+//*************************************************
+int testMain(int argc, char *argv[])
+{
+  (void)argc; (void)argv;
+  fprintf(stderr, "--test needs CONTEXT_ENABLE (nano_basic_uno_conf.h)\n");
+  return 2;
+}
+#else
+
+extern BIOS_LOCAL jmp_buf reset_env;
+
+namespace fs = std::filesystem;
+typedef std::chrono::steady_clock test_clock;
+
+#define TEST_TIMEOUT_DEF    10     // Time limit per program [s]
+#define TEST_WATCH_PERIOD   20     // Watchdog check period [ms]
+
+typedef enum {
+  TEST_PASS = 0,
+  TEST_FAIL,
+  TEST_TIMEOUT,
+  TEST_RESET,
+  TEST_NOFILE,
+  TEST_UPDATED,
+} test_status_t;
+
+static const char *const testStatusName[] = {
+  "PASS", "FAIL", "TIME", "RESET", "NOFILE", "WROTE",
+};
+
+typedef struct {
+  fs::path bas;
+  test_status_t status = TEST_PASS;
+  int8_t error = 0;
+  uint32_t statements = 0;
+  double ms = 0;
+  std::string diff;
+} test_job_t;
+
+// Shared between a worker and the watchdog (main thread)
+typedef struct {
+  std::mutex lock;
+  bool running;
+  bool timedOut;
+  test_clock::time_point start;
+  volatile uint8_t *breakFlag;
+} test_slot_t;
+
+static std::vector<test_job_t> testJobs;
+static std::atomic<size_t> testNext;
+static std::atomic<int> testActive;
+static bool testUpdate;
+static bool testVerbose;
+static bool testVirtual;
+static uint32_t testCost;
+
+//*************************************************
+static bool testWriteFile(const fs::path &path, const std::string &text)
+{
+  FILE *fp = fopen(path.string().c_str(), "wb");
+  if (!fp) return false;
+  bool ok = fwrite(text.data(), 1, text.size(), fp) == text.size();
+  fclose(fp);
+  return ok;
+}
+
+//*************************************************
+// CR/LF, LF/CR (the console newline) and CR line endings become LF
+static std::string testNormalize(const std::string &text)
+{
+  std::string out;
+  out.reserve(text.size());
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '\r') {
+      if (i + 1 < text.size() && text[i + 1] == '\n') continue;
+      if (i > 0 && text[i - 1] == '\n') continue;
+      out.push_back('\n');
+    }
+    else {
+      out.push_back(text[i]);
+    }
+  }
+  return out;
+}
+
+//*************************************************
+// The number of the LIST size line ("[123 bytes]") depends on
+// EXPR_COMPILE_ENABLE and CODE_OPTIMIZE_ENABLE, so it is not compared
+static std::string testMaskSize(const std::string &text)
+{
+  std::string out;
+  size_t bol = 0;
+  while (bol < text.size()) {
+    size_t eol = std::min(text.find('\n', bol), text.size());
+    size_t n = bol + 1;
+    while (n < eol && isdigit((uint8_t)text[n])) n++;
+    if (text[bol] == '[' && n > bol + 1 && text.compare(n, eol - n, " bytes]") == 0) {
+      out += "[n bytes]";
+    }
+    else {
+      out.append(text, bol, eol - bol);
+    }
+    if (eol < text.size()) out.push_back('\n');
+    bol = eol + 1;
+  }
+  return out;
+}
+
+//*************************************************
+static std::string testFirstDiff(const std::string &expect, const std::string &actual)
+{
+  size_t pos = 0, line = 1;
+  while (pos < expect.size() && pos < actual.size() && expect[pos] == actual[pos]) {
+    if (expect[pos] == '\n') line++;
+    pos++;
+  }
+  size_t bol = (pos == 0) ? 0 : std::min(expect.rfind('\n', pos - 1) + 1, pos);
+  auto lineAt = [bol](const std::string &s) {
+    if (bol >= s.size()) return std::string("<end of output>");
+    return s.substr(bol, s.find('\n', bol) - bol);
+  };
+  return "line " + std::to_string(line) + "\n    expected: " + lineAt(expect) +
+         "\n    actual  : " + lineAt(actual);
+}
+
+//*************************************************
+static void testRunJob(test_job_t &job, test_slot_t &slot, const std::string &eeprom)
+{
+  std::string text, input, output;
+  fs::path in = job.bas, out = job.bas;
+  in.replace_extension(".in");
+  out.replace_extension(".out");
+
+  if (!bios_cliReadFile(job.bas.string().c_str(), text)) {
+    job.status = TEST_NOFILE;
+    return;
+  }
+  if (bios_cliReadFile(in.string().c_str(), input)) {
+    input = testNormalize(input);
+    std::replace(input.begin(), input.end(), '\n', '\r');   // Enter key
+  }
+
+  bios_cliSetCapture(&output);
+  bios_cliSetInput(input.c_str());
+  bios_cliSetEeprom(eeprom.c_str());            // closes the previous file
+  std::error_code ec;
+  fs::remove(eeprom, ec);                       // every program starts erased
+  bios_randomize(1);
+
+  {
+    std::lock_guard<std::mutex> guard(slot.lock);
+    bios_breakFlag = 0;
+    slot.timedOut = false;
+    slot.start = test_clock::now();
+    slot.running = true;
+  }
+  job.status = TEST_PASS;
+  if (setjmp(reset_env) != 0) {
+    job.status = TEST_RESET;                    // RESET inside a program
+  }
+  else {
+    job.error = basicLoadProgram(text.c_str());
+    if (job.error == 0) {
+      job.error = basicRunProgram();
+    }
+    // the rest of the input is typed at the OK prompt (LIST, SAVE, RUN...)
+    while (job.error == 0 && !bios_breakFlag && bios_cliInputLeft()) {
+      basicMain();
+    }
+  }
+  {
+    std::lock_guard<std::mutex> guard(slot.lock);
+    slot.running = false;
+    job.ms = std::chrono::duration<double, std::milli>(test_clock::now() - slot.start).count();
+    if (slot.timedOut) job.status = TEST_TIMEOUT;
+  }
+  job.statements = basicStatementCount();
+  if (job.status != TEST_PASS) return;
+
+  if (testUpdate) {
+    job.status = testWriteFile(out, testNormalize(output)) ? TEST_UPDATED : TEST_NOFILE;
+    return;
+  }
+  std::string expect;
+  if (!bios_cliReadFile(out.string().c_str(), expect)) {
+    job.status = TEST_NOFILE;
+    return;
+  }
+  expect = testMaskSize(testNormalize(expect));
+  output = testMaskSize(testNormalize(output));
+  if (expect != output) {
+    job.status = TEST_FAIL;
+    if (testVerbose) job.diff = testFirstDiff(expect, output);
+  }
+}
+
+//*************************************************
+static void testWorker(test_slot_t *slot, fs::path eeprom)
+{
+  nb_context_t *ctx = basicContextNew();
+  basicContextSet(ctx);
+  bios_cliSetCapture(NULL);
+  bios_cliSetVirtualTime(testVirtual, testCost);
+  bios_init();
+  slot->breakFlag = &bios_breakFlag;
+  const std::string file = eeprom.string();     // kept by bios_cliSetEeprom()
+
+  size_t i;
+  while ((i = testNext++) < testJobs.size()) {
+    testRunJob(testJobs[i], *slot, file);
+  }
+
+  bios_cliSetEeprom(NULL);
+  std::error_code ec;
+  fs::remove(eeprom, ec);
+  basicContextFree(ctx);
+  testActive--;
+}
+
+//*************************************************
+// Stops the programs that run past the time limit
+static void testWatchdog(std::vector<test_slot_t> &slots, double limit_ms)
+{
+  while (testActive > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(TEST_WATCH_PERIOD));
+    auto now = test_clock::now();
+    for (test_slot_t &slot : slots) {
+      std::lock_guard<std::mutex> guard(slot.lock);
+      if (!slot.running || slot.timedOut) continue;
+      if (std::chrono::duration<double, std::milli>(now - slot.start).count() > limit_ms) {
+        slot.timedOut = true;
+        *slot.breakFlag = 1;
+      }
+    }
+  }
+}
+
+//*************************************************
+int testMain(int argc, char *argv[])
+{
+  int jobs = (int)std::thread::hardware_concurrency();
+  double timeout = TEST_TIMEOUT_DEF;
+  int i;
+
+  for (i = 0; i < argc && argv[i][0] == '-'; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      jobs = atoi(argv[++i]);
+    }
+    else
+    if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      timeout = atof(argv[++i]);
+    }
+    else
+    if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      testVirtual = true;
+      testCost = (uint32_t)strtoul(argv[++i], NULL, 0);
+    }
+    else
+    if (strcmp(argv[i], "-u") == 0) {
+      testUpdate = true;
+    }
+    else
+    if (strcmp(argv[i], "-v") == 0) {
+      testVerbose = true;
+    }
+    else {
+      break;
+    }
+  }
+  if (argc - i != 1) {
+    fprintf(stderr, "usage: --test [-j jobs] [-t sec] [-c us] [-u] [-v] dir\n");
+    return 2;
+  }
+
+  std::error_code ec;
+  for (const fs::directory_entry &entry : fs::directory_iterator(argv[i], ec)) {
+    if (entry.is_regular_file() && entry.path().extension() == ".bas") {
+      testJobs.emplace_back();
+      testJobs.back().bas = entry.path();
+    }
+  }
+  if (ec) {
+    fprintf(stderr, "%s: %s\n", argv[i], ec.message().c_str());
+    return 2;
+  }
+  std::sort(testJobs.begin(), testJobs.end(),
+            [](const test_job_t &a, const test_job_t &b) { return a.bas < b.bas; });
+
+  if (jobs < 1) jobs = 1;
+  if ((size_t)jobs > testJobs.size()) jobs = (int)std::max<size_t>(testJobs.size(), 1);
+
+  auto start = test_clock::now();
+  std::string tag = std::to_string(start.time_since_epoch().count());
+  std::vector<test_slot_t> slots(jobs);
+  std::vector<std::thread> workers;
+  testActive = jobs;
+  for (int n = 0; n < jobs; n++) {
+    fs::path eeprom = fs::temp_directory_path(ec) /
+                      ("nbtest_" + tag + "_" + std::to_string(n) + ".bin");
+    workers.emplace_back(testWorker, &slots[n], eeprom);
+  }
+  testWatchdog(slots, timeout * 1000.0);
+  for (std::thread &t : workers) t.join();
+  double total = std::chrono::duration<double>(test_clock::now() - start).count();
+
+  int count[sizeof(testStatusName) / sizeof(testStatusName[0])] = {};
+  for (const test_job_t &job : testJobs) {
+    count[job.status]++;
+    printf("%-6s %s  %.3f ms  %lu stmts", testStatusName[job.status],
+           job.bas.filename().string().c_str(), job.ms, (unsigned long)job.statements);
+    if (job.error) printf("  error %d", job.error);
+    printf("\n");
+    if (!job.diff.empty()) printf("    %s\n", job.diff.c_str());
+  }
+  int failed = count[TEST_FAIL] + count[TEST_TIMEOUT] + count[TEST_RESET] + count[TEST_NOFILE];
+  printf("%d programs, %d passed, %d failed, %d timed out (%.2f s, %d jobs)\n",
+         (int)testJobs.size(), count[TEST_PASS] + count[TEST_UPDATED],
+         failed - count[TEST_TIMEOUT], count[TEST_TIMEOUT], total, jobs);
+  return failed ? 1 : 0;
+}
+#endif
@@ -0,0 +1,310 @@
+/*
+ * nanoBASIC UNO - CLI program image tool
+ * --------------------------------------------
+ * Tokenizes a .bas file on the host with the same
+ * core as the board, and writes the resulting image
+ * (EEP_Header_t + program area, the layout of SAVE)
+ * to a file or uploads it to a board with LOAD !.
+ *
+ * Usage:
+ *   nanoBASIC_UNO --image [-a] file.bas image.bin
+ *   nanoBASIC_UNO --upload [-a] [-b baud] file.bas device
+ *   nanoBASIC_UNO --rom [-a] file.bas nano_basic_rom.h
+ *
+ *   -a      : enable AutoRun in the image (like SAVE !)
+ *   -b baud : serial speed for --upload (default 115200)
+ *
+ * The image is only valid for a board built with the same
+ * version and configuration (nano_basic_uno_conf.h) as
+ * this executable. An --image file can also be used as
+ * the eeprom.bin of the CLI version.
+ *
+ * --upload sends "LOAD !" to the board, then the image as
+ * hex records (see nano_basic_defs.h), each one answered
+ * with ACK or NAK. It is available on POSIX hosts only.
+ *
+ * --rom writes the program as a PROGMEM array for a board
+ * built with ROM_PROGRAM_ENABLE, which runs it from flash.
+ *
+ * GitHub: https://github.com/shachi-lab
+ * Copyright (c) 2025-2026 shachi-lab
+ * License: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "nano_basic_uno.h"
+#include "nano_basic_uno_conf.h"
+#include "nano_basic_defs.h"
+#include "bios_uno.h"
+#include "bios_uno_cli.h"
+
+int uploadMain(int argc, char *argv[]);
+
+#define UPLOAD_RETRY_NUM    5      // Retransmissions of a record before giving up
+#define UPLOAD_ACK_TIMEOUT  2000   // Wait for ACK/NAK of a record [ms]
+#define UPLOAD_END_TIMEOUT  10000  // Wait for the final ACK (EEPROM write) [ms]
+
+// Large enough for any PROGRAM_AREA_SIZE / RAM_ARENA_SIZE
+static uint8_t uploadImage[EEP_HEADER_SIZE + 0x4000];
+
+//*************************************************
+static int uploadBuildImage(const char *path, bool autorun)
+{
+  std::string text;
+  if (!bios_cliReadFile(path, text)) {
+    fprintf(stderr, "%s: cannot open\n", path);
+    return -1;
+  }
+
+  bios_cliSetHeadless(NULL);
+  bios_init();
+  int8_t err = basicLoadProgram(text.c_str());
+  if (err) {
+    fprintf(stderr, "%s: error %d while tokenizing\n", path, err);
+    return -1;
+  }
+  int16_t len = basicProgramImage(uploadImage, sizeof(uploadImage), autorun);
+  if (len < 0) {
+    fprintf(stderr, "%s: empty program\n", path);
+    return -1;
+  }
+  return len;
+}
+
+//*************************************************
+// ':' LL OOOO DD..DD CC CR
+static int uploadFormatRecord(char *buf, uint16_t offset, const uint8_t *data, uint8_t len)
+{
+  uint8_t sum = len + (offset >> 8) + (offset & 0xff);
+  int n = sprintf(buf, "%c%02X%04X", CHR_UPLOAD_MARK, len, offset);
+  for (uint8_t i = 0; i < len; i++) {
+    n += sprintf(buf + n, "%02X", data[i]);
+    sum += data[i];
+  }
+  n += sprintf(buf + n, "%02X\r", (uint8_t)-sum);
+  return n;
+}
+
+//*************************************************
+// nano_basic_rom.h for ROM_PROGRAM_ENABLE: the program area without the header,
+// the header fields become macros checked when the core is compiled
+static int uploadWriteRom(const char *path, const char *source, int len)
+{
+  const EEP_Header_t *eep = (const EEP_Header_t *)uploadImage;
+  const char *name = strrchr(source, '/');
+  FILE *fp = fopen(path, "w");
+  if (!fp) {
+    fprintf(stderr, "%s: cannot write\n", path);
+    return 1;
+  }
+  fprintf(fp, "/*\n"
+              " * nanoBASIC UNO - ROM program\n"
+              " * Generated by nanoBASIC_UNO --rom from %s, do not edit.\n"
+              " * Used by the core with ROM_PROGRAM_ENABLE (nano_basic_uno_conf.h).\n"
+              " */\n\n"
+              "#ifndef __NANO_BASIC_ROM_H\n"
+              "#define __NANO_BASIC_ROM_H\n\n",
+          name ? name + 1 : source);
+  fprintf(fp, "#define ROM_PROGRAM_VERSION  0x%02X%02X  // VERSION_MAJOR, VERSION_MINOR\n",
+          eep->verMajor, eep->verMinor);
+  fprintf(fp, "#define ROM_PROGRAM_FORMAT   0x%02X    // EEP_FORMAT_BUILD\n", eep->format);
+  fprintf(fp, "#define ROM_PROGRAM_AUTORUN  %d\n\n", eep->autoRun ? 1 : 0);
+  fprintf(fp, "static const uint8_t romProgram[] PROGMEM = {");
+  for (int i = EEP_HEADER_SIZE; i < len; i++) {
+    fprintf(fp, "%s0x%02X,", ((i - EEP_HEADER_SIZE) % 16) ? " " : "\n  ", uploadImage[i]);
+  }
+  fprintf(fp, "\n};\n\n#endif\n");
+  if (fclose(fp) != 0) {
+    fprintf(stderr, "%s: cannot write\n", path);
+    return 1;
+  }
+  printf("%s: %d bytes\n", path, len - (int)EEP_HEADER_SIZE);
+  return 0;
+}
+
+#ifdef _WIN32
+//*************************************************
+static int uploadSend(const char *device, int len, long baud)
+{
+  (void)device; (void)len; (void)baud;
+  fprintf(stderr, "--upload is not supported on Windows, use --image\n");
+  return 1;
+}
+#else
+
+#include <unistd.h>
+#include <termios.h>
+#include <fcntl.h>
+#include <poll.h>
+
+//*************************************************
+static speed_t uploadBaud(long baud)
+{
+  switch (baud) {
+  case 9600:   return B9600;
+  case 19200:  return B19200;
+  case 38400:  return B38400;
+  case 57600:  return B57600;
+  case 115200: return B115200;
+  default:     return B0;
+  }
+}
+
+//*************************************************
+static int uploadOpen(const char *device, long baud)
+{
+  int fd = open(device, O_RDWR | O_NOCTTY);
+  if (fd < 0) {
+    perror(device);
+    return -1;
+  }
+
+  struct termios tio;
+  if (tcgetattr(fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    tio.c_cflag |= (CLOCAL | CREAD);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, uploadBaud(baud));
+    cfsetospeed(&tio, uploadBaud(baud));
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  return fd;
+}
+
+//*************************************************
+static bool uploadWrite(int fd, const char *buf, int len)
+{
+  while (len > 0) {
+    ssize_t n = write(fd, buf, len);
+    if (n <= 0) return false;
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+//*************************************************
+// Waits for ACK or NAK, everything else (echo, messages) is skipped
+static int uploadWaitReply(int fd, int timeout_ms)
+{
+  struct pollfd fds;
+  uint8_t ch;
+
+  fds.fd = fd;
+  fds.events = POLLIN;
+  while (poll(&fds, 1, timeout_ms) > 0) {
+    if (read(fd, &ch, 1) != 1) break;
+    if (ch == CHR_UPLOAD_ACK || ch == CHR_UPLOAD_NAK) return ch;
+  }
+  return -1;
+}
+
+//*************************************************
+static bool uploadRecord(int fd, uint16_t offset, const uint8_t *data, uint8_t len,
+                         int timeout_ms, int retries)
+{
+  char buf[16 + UPLOAD_RECORD_LEN * 2];
+  int n = uploadFormatRecord(buf, offset, data, len);
+
+  for (int retry = 0; retry <= retries; retry++) {
+    if (!uploadWrite(fd, buf, n)) return false;
+    if (uploadWaitReply(fd, timeout_ms) == CHR_UPLOAD_ACK) return true;
+  }
+  return false;
+}
+
+//*************************************************
+static int uploadSend(const char *device, int len, long baud)
+{
+  if (uploadBaud(baud) == B0) {
+    fprintf(stderr, "%ld: unsupported baud rate\n", baud);
+    return 1;
+  }
+  int fd = uploadOpen(device, baud);
+  if (fd < 0) return 1;
+
+  // a CR first to clear a half-typed line, then wait for the start ACK
+  static const char start[] = "\rLOAD !\r";
+  bool ok = uploadWrite(fd, start, sizeof(start) - 1) &&
+            uploadWaitReply(fd, UPLOAD_ACK_TIMEOUT) == CHR_UPLOAD_ACK;
+  if (!ok) {
+    fprintf(stderr, "%s: no answer to LOAD !\n", device);
+    close(fd);
+    return 1;
+  }
+
+  // the header goes alone in the first record
+  int pos = 0;
+  while (ok && pos < len) {
+    int n = (pos == 0) ? (int)EEP_HEADER_SIZE : len - pos;
+    if (n > UPLOAD_RECORD_LEN) n = UPLOAD_RECORD_LEN;
+    ok = uploadRecord(fd, (uint16_t)pos, uploadImage + pos, (uint8_t)n,
+                      UPLOAD_ACK_TIMEOUT, UPLOAD_RETRY_NUM);
+    if (ok) pos += n;
+  }
+  if (ok) {
+    // sent once: the board is back in the REPL after the end record
+    ok = uploadRecord(fd, (uint16_t)len, NULL, 0, UPLOAD_END_TIMEOUT, 0);
+  }
+  close(fd);
+
+  if (!ok) {
+    fprintf(stderr, "%s: upload failed at offset %d\n", device, pos);
+    return 1;
+  }
+  printf("%s: %d bytes uploaded\n", device, len);
+  return 0;
+}
+#endif
+
+//*************************************************
+int uploadMain(int argc, char *argv[])
+{
+  bool upload = (strcmp(argv[0], "--upload") == 0);
+  bool rom = (strcmp(argv[0], "--rom") == 0);
+  bool autorun = false;
+  long baud = 115200;
+  int i;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+    if (strcmp(argv[i], "-a") == 0) {
+      autorun = true;
+    }
+    else
+    if (upload && strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      baud = atol(argv[++i]);
+    }
+    else {
+      break;
+    }
+  }
+  if (argc - i != 2) {
+    fprintf(stderr, upload ? "usage: --upload [-a] [-b baud] file.bas device\n" :
+                    rom    ? "usage: --rom [-a] file.bas nano_basic_rom.h\n"
+                           : "usage: --image [-a] file.bas image.bin\n");
+    return 2;
+  }
+
+  int len = uploadBuildImage(argv[i], autorun);
+  if (len < 0) return 1;
+  if (upload) {
+    return uploadSend(argv[i + 1], len, baud);
+  }
+  if (rom) {
+    return uploadWriteRom(argv[i + 1], argv[i], len);
+  }
+
+  FILE *fp = fopen(argv[i + 1], "wb");
+  if (!fp || fwrite(uploadImage, 1, len, fp) != (size_t)len) {
+    fprintf(stderr, "%s: cannot write\n", argv[i + 1]);
+    if (fp) fclose(fp);
+    return 1;
+  }
+  fclose(fp);
+  printf("%s: %d bytes\n", argv[i + 1], len);
+  return 0;
+}
@@ -8,9 +8,12 @@
  * functions required by the nanoBASIC core:
  *
  *   - Character input/output
+ *   - Break detection (Timer0 COMPB interrupt)
+ *   - Sampling profiler tick (Timer0 COMPB interrupt)
  *   - GPIO (digital input/output)
  *   - PWM output
  *   - ADC (analog input)
+ *   - Timed capture for SAMPLE (Timer0 COMPB interrupt)
  *   - Timing utilities (millis / delay)
  *   - Random number support
  *   - System reset
@@ -35,11 +38,43 @@
 #include "bios_uno.h"
 
 #define BIOS_SELIAR_BAUDRATE        115200
+// Key buffer: at least the HardwareSerial RX ring, so moving the bytes
+// out of it does not lose input earlier than reading Serial directly
+#if defined(SERIAL_RX_BUFFER_SIZE) && SERIAL_RX_BUFFER_SIZE > 16
+#define BIOS_KEY_BUFF_SIZE          SERIAL_RX_BUFFER_SIZE   // Must be a power of 2
+#else
+#define BIOS_KEY_BUFF_SIZE          16      // Must be a power of 2
+#endif
+#define BIOS_GPIO_NUM               20      // D0-D13, A0-A5 (14-19)
+#define BIOS_PORT_NUM               3       // PORTD, PORTB, PORTC
+#define BIOS_ADC_NUM                6       // A0-A5
+
+volatile uint8_t bios_breakFlag;
+volatile uint8_t bios_sampleContext;
+static volatile uint8_t keyBuff[BIOS_KEY_BUFF_SIZE];
+static volatile uint8_t keyHead;
+static volatile uint8_t keyTail;
+static_assert((BIOS_KEY_BUFF_SIZE & (BIOS_KEY_BUFF_SIZE - 1)) == 0 && BIOS_KEY_BUFF_SIZE <= 256,
+              "BIOS_KEY_BUFF_SIZE must be a power of 2 up to 256");
 
 static void bios_consoleInit(void);
 static void bios_systemTickInit(void);
 static void bios_eepInit(void);
 static void bios_polling(void);
+#if ADC_CACHE_ENABLE
+static void bios_adcTick(void);
+#endif
+#if CAPTURE_ENABLE
+static void bios_captureTick(void);
+#endif
+
+#if PROFILE_SAMPLE_NUM
+#define BIOS_SAMPLE_ENTER() (bios_sampleContext |= SAMPLE_CTX_BIOS)
+#define BIOS_SAMPLE_LEAVE() (bios_sampleContext &= ~SAMPLE_CTX_BIOS)
+#else
+#define BIOS_SAMPLE_ENTER()
+#define BIOS_SAMPLE_LEAVE()
+#endif
 
 //*************************************************
 void bios_init(void)
@@ -57,19 +92,74 @@ void bios_init(void)
 static void bios_consoleInit(void)
 {
   Serial.begin(BIOS_SELIAR_BAUDRATE);
+
+  // Timer0 is already running for millis() (about 1ms period).
+  // Its COMPB interrupt is used to move received characters
+  // into the key buffer and to catch CHR_BREAK while a program runs.
+  // It also drives the sampling profiler (PROFILE_SAMPLE_NUM).
+  OCR0B = 0x80;
+  TIMSK0 |= (1 << OCIE0B);
+}
+
+//*************************************************
+ISR(TIMER0_COMPB_vect)
+{
+  while (Serial.available() > 0) {
+    uint8_t ch = (uint8_t)Serial.read();
+    if (ch == CHR_BREAK) {
+      bios_breakFlag = 1;
+      continue;
+    }
+    uint8_t next = (keyHead + 1) & (BIOS_KEY_BUFF_SIZE - 1);
+    if (next == keyTail) {
+      continue;   // key buffer full : drop the key, so a later CHR_BREAK is still seen
+    }
+    keyBuff[keyHead] = ch;
+    keyHead = next;
+  }
+#if ADC_CACHE_ENABLE
+  bios_adcTick();
+#endif
+#if CAPTURE_ENABLE
+  bios_captureTick();
+#endif
+#if PROFILE_SAMPLE_NUM
+  basicProfileSample();
+#endif
 }
 
 //*************************************************
 void bios_consolePutChar(char ch)
 {
+  BIOS_SAMPLE_ENTER();
   Serial.write(ch);
+  BIOS_SAMPLE_LEAVE();
+}
+
+//*************************************************
+void bios_consoleWrite(const char *buf, uint8_t len)
+{
+  BIOS_SAMPLE_ENTER();
+  Serial.write((const uint8_t *)buf, len);
+  BIOS_SAMPLE_LEAVE();
+}
+
+//*************************************************
+int16_t bios_consoleWritable(void)
+{
+  return Serial.availableForWrite();
 }
 
 //*************************************************
 int16_t bios_consoleGetChar(void)
 {
-    bios_polling();
-  return (int16_t)Serial.read();
+  bios_polling();
+  if (keyHead == keyTail) {
+    return -1;
+  }
+  uint8_t ch = keyBuff[keyTail];
+  keyTail = (keyTail + 1) & (BIOS_KEY_BUFF_SIZE - 1);
+  return (int16_t)ch;
 }
 
 //*************************************************
@@ -86,6 +176,26 @@ nb_int_t bios_getSystemTick(void)
   return (nb_int_t)millis();
 }
 
+//*************************************************
+// micros() counts Timer0 overflows and reads TCNT0: 4us steps at 16MHz
+nb_int_t bios_getMicroTick(void)
+{
+  return (nb_int_t)micros();
+}
+
+#include <avr/sleep.h>
+//*************************************************
+void bios_idle(nb_int_t max_ms)
+{
+  // Idle sleep until the next interrupt: the 1ms Timer0 tick (which also
+  // drains serial RX into the key buffer) or the UART wakes the CPU.
+  if (max_ms <= 0 || keyHead != keyTail) return;
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  sleep_enable();
+  sleep_cpu();
+  sleep_disable();
+}
+
 //*************************************************
 //    Random number
 //*************************************************
@@ -108,62 +218,139 @@ nb_int_t bios_rand(nb_int_t val)
 //*************************************************
 //    GPIO, ADC, PWM
 //*************************************************
+// Arduino pin -> port number and bit mask
+static const uint8_t gpioPinMap[BIOS_GPIO_NUM][2] PROGMEM = {
+  {0, 0x01}, {0, 0x02}, {0, 0x04}, {0, 0x08},   // D0-D3   : PORTD
+  {0, 0x10}, {0, 0x20}, {0, 0x40}, {0, 0x80},   // D4-D7   : PORTD
+  {1, 0x01}, {1, 0x02}, {1, 0x04}, {1, 0x08},   // D8-D11  : PORTB
+  {1, 0x10}, {1, 0x20},                         // D12-D13 : PORTB
+  {2, 0x01}, {2, 0x02}, {2, 0x04}, {2, 0x08},   // A0-A3   : PORTC
+  {2, 0x10}, {2, 0x20},                         // A4-A5   : PORTC
+};
+
+// PINx, DDRx and PORTx are consecutive registers on the ATmega328P
+static volatile uint8_t * const portRegs[BIOS_PORT_NUM] = { &PIND, &PINB, &PINC };
+static const uint8_t portValidBits[BIOS_PORT_NUM] PROGMEM = { 0xff, 0x3f, 0x3f };
+#define REG_PIN(r)    (r)[0]
+#define REG_DDR(r)    (r)[1]
+#define REG_PORT(r)   (r)[2]
+
 //*************************************************
 int8_t bios_writeGpio(nb_int_t pin, nb_int_t value)
 {
-  if(pin < 0 || pin > 19) {
+  if ((nb_uint_t)pin >= BIOS_GPIO_NUM) {
     return -1;
   }
-  // D0〜D7 : PORTD
-  if (pin <= 7){
-      DDRD |= (1 << pin);
-      if(value) PORTD |= (1 << pin);
-      else      PORTD &= ~(1 << pin);
+  volatile uint8_t *reg = portRegs[pgm_read_byte(&gpioPinMap[pin][0])];
+  uint8_t bit = pgm_read_byte(&gpioPinMap[pin][1]);
+  REG_DDR(reg) |= bit;
+  if (value) REG_PORT(reg) |= bit;
+  else       REG_PORT(reg) &= ~bit;
+  return 0;
+}
+
+//*************************************************
+int8_t bios_readGpio(nb_int_t pin)
+{
+  if ((nb_uint_t)pin >= BIOS_GPIO_NUM) {
+    return -1;
+  }
+  if (pin >= 14) return -1;     // A0-A5 are read with ADC()
+
+  volatile uint8_t *reg = portRegs[pgm_read_byte(&gpioPinMap[pin][0])];
+  return (REG_PIN(reg) & pgm_read_byte(&gpioPinMap[pin][1])) != 0;
+}
+
+//*************************************************
+int8_t bios_writePort(nb_int_t port, nb_int_t value, nb_int_t mask)
+{
+  if ((nb_uint_t)port >= BIOS_PORT_NUM) {
+    return -1;
   }
-  // D8〜D13 : PORTB
-  else if(pin <= 13){
-      int b = pin - 8;
-      DDRB |= (1 << b);
-      if(value) PORTB |= (1 << b);
-      else      PORTB &= ~(1 << b);
+  volatile uint8_t *reg = portRegs[port];
+  uint8_t bits = (uint8_t)mask & pgm_read_byte(&portValidBits[port]);
+  if (bits == 0xff) {
+    REG_PORT(reg) = (uint8_t)value;     // one register write
   }
-  // A0〜A5 (14〜19) : PORTC
   else {
-      int c = pin - 14;
-      DDRC |= (1 << c);
-      if(value) PORTC |= (1 << c);
-      else      PORTC &= ~(1 << c);
+    REG_PORT(reg) = (REG_PORT(reg) & ~bits) | ((uint8_t)value & bits);
   }
   return 0;
 }
 
 //*************************************************
-int8_t bios_readGpio(nb_int_t pin)
+int16_t bios_readPort(nb_int_t port)
 {
-  if (pin < 0 || pin > 19) {
+  if ((nb_uint_t)port >= BIOS_PORT_NUM) {
     return -1;
   }
-  if (pin >= 14 && pin <= 19) return -1; 
+  return REG_PIN(portRegs[port]) & pgm_read_byte(&portValidBits[port]);
+}
 
-  if (pin <= 7) {
-      return (PIND >> pin) & 1;
-  } else if(pin <= 13) {
-      return (PINB >> (pin - 8)) & 1;
-  } else if(pin <= 19) { 
-      return (PINC >> (pin - 14)) & 1;
+//*************************************************
+int8_t bios_setPortDir(nb_int_t port, nb_int_t dir, nb_int_t mask)
+{
+  if ((nb_uint_t)port >= BIOS_PORT_NUM) {
+    return -1;
   }
+  volatile uint8_t *reg = portRegs[port];
+  uint8_t bits = (uint8_t)mask & pgm_read_byte(&portValidBits[port]);
+  REG_DDR(reg) = (REG_DDR(reg) & ~bits) | ((uint8_t)dir & bits);
   return 0;
 }
 
+#define ADC_PRESCALER   ((1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0))  // 16MHz/128
+
+#if ADC_CACHE_ENABLE
+#if ADC_AVERAGE_SHIFT > 5
+#error "ADC_AVERAGE_SHIFT must be 0..5"
+#endif
+// Background scan: the ADC interrupt converts the channels in adcScanMask
+// in turn (the first conversion after switching the mux is discarded)
+// and keeps a running sum of 2^ADC_AVERAGE_SHIFT samples per channel.
+// The Timer0 tick starts one conversion per ms, so the scan does not
+// keep the CPU busy or wake it from idle more than the tick does.
+static volatile uint16_t adcSum[BIOS_ADC_NUM];
+static volatile uint8_t adcScanMask;
+static volatile uint8_t adcChannel;
+static volatile uint8_t adcSettled;
+
 //*************************************************
-int16_t bios_readAdc(nb_int_t ch)
+ISR(ADC_vect)
 {
-  // ch : 0〜5（A0〜A5）
-  if (ch < 0 || ch > 5) {
-    return -1;
+  uint8_t ch = adcChannel;
+
+  if (!adcSettled) {
+    adcSettled = 1;
+    return;
+  }
+  uint16_t sum = adcSum[ch];
+  adcSum[ch] = sum - (sum >> ADC_AVERAGE_SHIFT) + ADC;
+  do {
+    ch = (ch + 1 < BIOS_ADC_NUM) ? ch + 1 : 0;
+  } while (!(adcScanMask & (1 << ch)));
+  if (ch != adcChannel) {
+    adcChannel = ch;
+    ADMUX = (1 << REFS0) | ch;
+    adcSettled = 0;
   }
+}
+
+//*************************************************
+// From the Timer0 tick: next conversion of the scan
+static void bios_adcTick(void)
+{
+  if ((ADCSRA & ((1 << ADIE) | (1 << ADSC))) == (1 << ADIE)) {
+    ADCSRA |= (1 << ADSC);
+  }
+}
+#endif
+
+//*************************************************
+static int16_t bios_adcConvert(uint8_t ch)
+{
   ADMUX = (1 << REFS0) | (ch & 0x07);
-  ADCSRA = (1 << ADEN) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+  ADCSRA = (1 << ADEN) | ADC_PRESCALER;
   ADCSRA |= (1 << ADSC);
   while (ADCSRA & (1 << ADSC));
   ADCSRA |= (1 << ADSC);
@@ -171,6 +358,145 @@ int16_t bios_readAdc(nb_int_t ch)
   return ADC;
 }
 
+//*************************************************
+int16_t bios_readAdc(nb_int_t ch)
+{
+  int16_t val;
+#if ADC_CACHE_ENABLE
+  uint8_t fresh = (ch & BIOS_ADC_FRESH) != 0;
+#endif
+
+  // ch : 0〜5（A0〜A5）
+  ch &= ~BIOS_ADC_FRESH;
+  if (ch < 0 || ch > 5) {
+    return -1;
+  }
+#if ADC_CACHE_ENABLE
+  uint8_t bit = 1 << ch;
+  if (!fresh && (adcScanMask & bit)) {
+    uint8_t sreg = SREG;
+    cli();
+    val = adcSum[ch] >> ADC_AVERAGE_SHIFT;
+    SREG = sreg;
+    return val;
+  }
+
+  // Synchronous conversion, then (re)start the scan including this channel
+  BIOS_SAMPLE_ENTER();
+  ADCSRA &= ~(1 << ADIE);
+  while (ADCSRA & (1 << ADSC));
+  val = bios_adcConvert(ch);
+  if (!(adcScanMask & bit)) {
+    adcSum[ch] = val << ADC_AVERAGE_SHIFT;
+    adcScanMask |= bit;
+  }
+  if (!(adcScanMask & (1 << adcChannel))) {
+    adcChannel = ch;
+  }
+  ADMUX = (1 << REFS0) | adcChannel;
+  adcSettled = 0;
+  ADCSRA = (1 << ADEN) | (1 << ADIE) | (1 << ADSC) | (1 << ADIF) | ADC_PRESCALER;
+  BIOS_SAMPLE_LEAVE();
+#else
+  BIOS_SAMPLE_ENTER();
+  val = bios_adcConvert(ch);
+  BIOS_SAMPLE_LEAVE();
+#endif
+  return val;
+}
+
+#if CAPTURE_ENABLE
+//*************************************************
+//    Timed capture (SAMPLE)
+//*************************************************
+// Serviced from the Timer0 COMPB interrupt (about 1ms per tick), so the
+// sample timing does not depend on the interpreter.
+// ADC capture reads the background scan (ADC_CACHE_ENABLE), or the last
+// conversion of the channel and starts the next one.
+static nb_int_t * volatile captureBuf;
+static volatile nb_int_t captureRemain;
+static nb_int_t capturePeriod;
+static nb_int_t captureWait;
+static volatile uint8_t *capturePin;    // NULL: ADC
+static uint8_t captureBit;              // pin mask, or ADC channel
+
+//*************************************************
+static void bios_captureTick(void)
+{
+  nb_int_t val;
+
+  if (captureRemain == 0 || --captureWait > 0) return;
+  captureWait = capturePeriod;
+  if (capturePin) {
+    val = (*capturePin & captureBit) != 0;
+  }
+  else {
+#if ADC_CACHE_ENABLE
+    val = adcSum[captureBit] >> ADC_AVERAGE_SHIFT;
+#else
+    val = ADC;
+    ADCSRA |= (1 << ADSC);
+#endif
+  }
+  *captureBuf++ = val;
+  captureRemain--;
+}
+
+//*************************************************
+int8_t bios_captureStart(nb_int_t source, nb_int_t *buf, nb_int_t count, nb_int_t period)
+{
+  volatile uint8_t *pin = NULL;
+  uint8_t bit;
+
+  if (count <= 0 || period <= 0) {
+    return -1;
+  }
+  if (source & BIOS_CAPTURE_ADC) {
+    bit = source & ~BIOS_CAPTURE_ADC;
+    // Also adds the channel to the background scan (ADC_CACHE_ENABLE)
+    if (bios_readAdc(bit) < 0) return -1;
+#if !ADC_CACHE_ENABLE
+    ADCSRA |= (1 << ADSC);
+#endif
+  }
+  else {
+    if (bios_readGpio(source) < 0) return -1;
+    pin = &REG_PIN(portRegs[pgm_read_byte(&gpioPinMap[source][0])]);
+    bit = pgm_read_byte(&gpioPinMap[source][1]);
+  }
+
+  uint8_t sreg = SREG;
+  cli();
+  captureBuf = buf;
+  capturePin = pin;
+  captureBit = bit;
+  capturePeriod = period;
+  captureWait = 1;              // first reading on the next tick
+  captureRemain = count;
+  SREG = sreg;
+  return 0;
+}
+
+//*************************************************
+nb_int_t bios_captureRemain(void)
+{
+  uint8_t sreg = SREG;
+  cli();
+  nb_int_t remain = captureRemain;
+  SREG = sreg;
+  return remain;
+}
+
+//*************************************************
+void bios_captureStop(void)
+{
+  uint8_t sreg = SREG;
+  cli();
+  captureRemain = 0;
+  SREG = sreg;
+}
+#endif
+
 //*************************************************
 int8_t bios_setPwm(nb_int_t pin, nb_int_t value)
 {
@@ -206,25 +532,31 @@ static void bios_eepInit(void)
 //*************************************************
 void bios_eepEraseBlock(uint16_t addr, uint16_t len)
 {
+  BIOS_SAMPLE_ENTER();
   for (uint16_t i = 0; i < len; i++) {
     EEPROM.update(addr + i, 0xff);
   }
+  BIOS_SAMPLE_LEAVE();
 }
 
 //*************************************************
 void bios_eepWriteBlock(uint16_t addr, const uint8_t* buf, uint16_t len)
 {
+  BIOS_SAMPLE_ENTER();
   for (uint16_t i = 0; i < len; i++) {
     EEPROM.update(addr + i, buf[i]);
   }
+  BIOS_SAMPLE_LEAVE();
 }
 
 //*************************************************
 void bios_eepReadBlock(uint16_t addr, uint8_t* buf, uint16_t len)
 {
+  BIOS_SAMPLE_ENTER();
   for (uint16_t i = 0; i < len; i++) {
     buf[i] = EEPROM.read(addr + i);
   }
+  BIOS_SAMPLE_LEAVE();
 }
 
 /**
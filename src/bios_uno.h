@@ -11,8 +11,11 @@
  *
  * This header defines:
  *   - Character I/O for the console
+ *   - Break request flag
+ *   - Sampling profiler hook
  *   - GPIO (digital input/output)
  *   - Analog input (ADC)
+ *   - Timed capture (SAMPLE)
  *   - PWM output
  *   - Timing utilities
  *   - Random number support
@@ -31,6 +34,15 @@
 #ifndef __BIOS_UNO_H
 #define __BIOS_UNO_H
 
+// Per-thread BIOS state (CONTEXT_ENABLE, host only)
+// Each thread that drives its own interpreter context also
+// gets its own break flag and console/EEPROM bindings.
+#if CONTEXT_ENABLE
+#define BIOS_LOCAL  thread_local
+#else
+#define BIOS_LOCAL
+#endif
+
 // Initialize
 void bios_init(void);
 
@@ -38,8 +50,45 @@ void bios_init(void);
 void bios_consolePutChar( char ch );
 int16_t bios_consoleGetChar( void );
 
+// Block output
+// bios_consoleWrite() sends 'len' bytes in one call (may block).
+// bios_consoleWritable() returns how many bytes can be written
+// right now without blocking (used with CONSOLE_TX_DROP).
+void bios_consoleWrite( const char *buf, uint8_t len );
+int16_t bios_consoleWritable( void );
+
+// Break request
+// Set to non-zero by the BIOS when CHR_BREAK (Ctrl-C) arrives
+// asynchronously (serial RX path, signal handler, etc.).
+// The break key itself is not returned by bios_consoleGetChar().
+// The interpreter tests and clears this flag between statements.
+// With CONTEXT_ENABLE it is per thread; the CLI console handlers set
+// the flag of the thread that initialized the console.
+extern BIOS_LOCAL volatile uint8_t bios_breakFlag;
+
+// Sampling profiler (PROFILE_SAMPLE_NUM > 0)
+// The BIOS calls basicProfileSample() (implemented by the core)
+// from a periodic timer interrupt, about every 1ms.
+// bios_sampleContext tells the sampler what is running;
+// the BIOS sets SAMPLE_CTX_BIOS around its slow calls.
+#define SAMPLE_CTX_EXPR     0x01
+#define SAMPLE_CTX_FINDST   0x02
+#define SAMPLE_CTX_BIOS     0x04
+extern BIOS_LOCAL volatile uint8_t bios_sampleContext;
+void basicProfileSample( void );
+
 // Timing utilities
+// bios_getSystemTick() counts milliseconds, bios_getMicroTick() microseconds;
+// both only wrap around (at the width of nb_int_t), the core subtracts
+// two readings (ELAPSED) to get an interval.
 nb_int_t bios_getSystemTick( void );
+nb_int_t bios_getMicroTick( void );
+
+// Idle wait
+// Called by the core while it waits (DELAY, PAUSE, INKEY, REPL input).
+// Sleeps for at most max_ms, and returns earlier on console input or
+// a break request. It may return at any time; the core re-checks.
+void bios_idle( nb_int_t max_ms );
 
 // Random number
 void bios_randomize( nb_int_t val );
@@ -49,8 +98,26 @@ nb_int_t bios_rand( nb_int_t val );
 int8_t bios_writeGpio( nb_int_t pin, nb_int_t value );
 int8_t bios_readGpio( nb_int_t pin );
 int16_t bios_readAdc( nb_int_t ch );
+#define BIOS_ADC_FRESH      0x80  // ch | BIOS_ADC_FRESH: wait for a new conversion
 int8_t bios_setPwm( nb_int_t pin, nb_int_t value );
 
+// Timed capture (CAPTURE_ENABLE)
+// Stores 'count' readings into buf, one every 'period' ms, from the
+// BIOS timer interrupt. source = pin (digital) or ch | BIOS_CAPTURE_ADC.
+// Starting a capture replaces the running one; returns -1 on a bad source.
+// bios_captureRemain() returns the number of readings still to be taken.
+#define BIOS_CAPTURE_ADC    0x100
+int8_t bios_captureStart( nb_int_t source, nb_int_t *buf, nb_int_t count, nb_int_t period );
+nb_int_t bios_captureRemain( void );
+void bios_captureStop( void );
+
+// Port I/O (8-bit ports, bits set in 'mask' are changed)
+// UNO: port 0 = D0-D7 (PORTD), 1 = D8-D13 (PORTB), 2 = A0-A5 (PORTC)
+// bios_setPortDir(): 1 = output, 0 = input
+int8_t bios_writePort( nb_int_t port, nb_int_t value, nb_int_t mask );
+int16_t bios_readPort( nb_int_t port );
+int8_t bios_setPortDir( nb_int_t port, nb_int_t dir, nb_int_t mask );
+
 // System reset
 void bios_systemReset( void );
 
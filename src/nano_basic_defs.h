@@ -9,6 +9,7 @@
  *   - Built-in value/function identifiers
  *   - Error code definitions
  *   - Stack structures for FOR/NEXT loops
+ *   - Index structures for label and block lookup
  *
  * These definitions form the core specification
  * of the nanoBASIC language and remain common
@@ -56,6 +57,8 @@ typedef uint8_t ascii_code_t;
 // Internal Code 
 typedef enum {
   ST_EOL        = 0x00,
+  ST_EXPR       = 0x01,  // compiled expression block
+  ST_FAST       = 0x02,  // optimized statement block
   ST_VAL        = 0x08,  // 0000 1xxx
   ST_VAL_DEC    = 0x08,  // 0000 10xx
   ST_VAL_HEX    = 0x0c,  // 0000 11xx
@@ -96,32 +99,51 @@ typedef enum {
   ST_RESTORE    = 0x9c,
   ST_OUTP       = 0x9d,
   ST_PWM        = 0x9e,
+  ST_PROFILE    = 0x9f,
+  ST_EVERY      = 0xa0,
+  ST_AFTER      = 0xa1,
+  ST_OUTPORT    = 0xa2,
+  ST_PORTDIR    = 0xa3,
+  ST_SAMPLE     = 0xa4,
+  ST_FILL       = 0xa5,
+  ST_COPY       = 0xa6,
+  ST_SHIFT      = 0xa7,
+  ST_DIM        = 0xa8,
+  ST_STAT       = 0xa9,
 
-  STSP_START    = 0x9f,
-  ST_ELSE       = 0x9f,
-  ST_ELSEIF     = 0xa0,
-  ST_ENDIF      = 0xa1,
-  STCODE_END    = 0xa1,
-
-  ST_THEN       = 0xa2,
-  ST_TO         = 0xa3,
-  ST_STEP       = 0xa4,
-  STSP_END      = 0xa4,
-
-  FUNC_START    = 0xa5,
-  FUNC_RND      = 0xa5,
-  FUNC_ABS      = 0xa6,
-  FUNC_INP      = 0xa7,
-  FUNC_ADC      = 0xa8,
-  FUNC_INKEY    = 0xa9,
-  FUNC_CHR      = 0xaa,
-  FUNC_DEC      = 0xab,
-  FUNC_HEX      = 0xac,
-  FUNC_END      = 0xac,
-
-  SVAR_START    = 0xad,
-  SVAR_TICK     = 0xad,
-  SVAR_END      = 0xad
+  STSP_START    = 0xaa,
+  ST_ELSE       = 0xaa,
+  ST_ELSEIF     = 0xab,
+  ST_ENDIF      = 0xac,
+  STCODE_END    = 0xac,
+
+  ST_THEN       = 0xad,
+  ST_TO         = 0xae,
+  ST_STEP       = 0xaf,
+  STSP_END      = 0xaf,
+
+  FUNC_START    = 0xb0,
+  FUNC_RND      = 0xb0,
+  FUNC_ABS      = 0xb1,
+  FUNC_INP      = 0xb2,
+  FUNC_ADC      = 0xb3,
+  FUNC_INKEY    = 0xb4,
+  FUNC_CHR      = 0xb5,
+  FUNC_DEC      = 0xb6,
+  FUNC_HEX      = 0xb7,
+  FUNC_INPORT   = 0xb8,
+  FUNC_SUM      = 0xb9,
+  FUNC_MIN      = 0xba,
+  FUNC_MAX      = 0xbb,
+  FUNC_RAW      = 0xbc,
+  FUNC_ELAPSED  = 0xbd,
+  FUNC_END      = 0xbd,
+
+  SVAR_START    = 0xbe,
+  SVAR_TICK     = 0xbe,
+  SVAR_FREE     = 0xbf,
+  SVAR_UTICK    = 0xc0,
+  SVAR_END      = 0xc0
 } internal_code_e;
 typedef uint8_t internal_code_t;
 
@@ -148,7 +170,10 @@ typedef enum {
   ERROR_UXEXIT    = 17,
   ERROR_UXCONTINUE= 18,
   ERROR_UXREAD    = 19,
-  ERROR_CODE_MAX  = 19,
+  ERROR_UPLOAD    = 20,
+  ERROR_PGVER     = 21,
+  ERROR_PGROM     = 22,
+  ERROR_CODE_MAX  = 22,
 } error_code_e;
 typedef uint8_t error_code_t;
 
@@ -169,6 +194,24 @@ typedef int16_t nb_int_t;
 typedef uint16_t nb_uint_t;
 #endif
 
+// Runtime counters (STAT_ENABLE), STAT(n) returns counter n
+typedef enum {
+  STAT_STATEMENTS = 0,    // statements executed
+  STAT_LABEL_LOOKUPS,     // GOTO / GOSUB / RESTORE label look-ups
+  STAT_LABEL_BYTES,       // program bytes scanned by look-ups not in the label index
+  STAT_FIND_SCANS,        // forward keyword searches (findST)
+  STAT_FIND_BYTES,        // program bytes skipped by findST
+  STAT_STACK_MAX,         // high-water mark of the FOR/GOSUB/DO/WHILE stack
+  STAT_EXPR_MAX,          // high-water mark of the expression depth
+  STAT_CONSOLE_IN,        // console bytes received
+  STAT_CONSOLE_OUT,       // console bytes sent
+  STAT_EEP_READ,          // EEPROM bytes read
+  STAT_EEP_WRITE,         // EEPROM bytes written (erase included)
+  STAT_COUNTER_NUM,       // counters above are kept in RAM
+  STAT_PROG_FREE = STAT_COUNTER_NUM,  // free program bytes (computed)
+  STAT_NUM
+} stat_counter_e;
+
 // Stack structure
 typedef struct {
   uint8_t   type;             // ST type (DO/FOR/WHILE)
@@ -177,11 +220,42 @@ typedef struct {
   nb_int_t  *pvar;            // counter variable
   nb_int_t  limit;            // limit value
   nb_int_t  step;             // step value
-} stack_t;
+} nb_stack_t;
+
+// Label index structure
+typedef struct {
+  nb_int_t  label;            // label value
+  uint16_t  offset;           // line top offset in program area
+  int16_t   line;             // line number
+} label_index_t;
+
+// Block index structure
+typedef struct {
+  uint16_t  key;              // token offset << 2 | search kind
+  uint16_t  offset;           // matched position offset in program area
+  int16_t   line;             // matched line number
+} block_index_t;
+
+// Event timer entry (EVERY / AFTER)
+typedef struct {
+  uint8_t   type;             // ST_EVERY / ST_AFTER (0: free)
+  nb_int_t  label;            // GOSUB label
+  nb_int_t  interval;         // period [ms]
+  nb_int_t  due;              // system tick of the next call
+} event_timer_t;
+
+// Profiler line entry
+typedef struct {
+  uint32_t  count;            // statements executed
+  uint32_t  ticks;            // accumulated system tick [ms]
+} profile_line_t;
 
 // Special character definitions
 #define CHR_BREAK       ASCII_ETX
 #define CHR_PROG_TERM   '#'
+#define CHR_UPLOAD_ACK  ASCII_ACK   // LOAD ! : record accepted
+#define CHR_UPLOAD_NAK  0x15        // LOAD ! : record rejected, send it again
+#define CHR_UPLOAD_MARK ':'         // LOAD ! : start of a record
 
 // ST_VAL bytecode format (value literal)
 #define VAL_ST_MASK   0xf8    // 1111 1xxx 
@@ -200,6 +274,37 @@ typedef struct {
   uint8_t size : 2;   // bytes - 1
 } st_val_t;
 
+// ST_EXPR bytecode format (compiled expression)
+//   [ST_EXPR][rpn length][infix length][rpn code ...][infix code ...]
+// The infix code is kept as typed for LIST and for the interpreter
+// when expression compile is disabled.
+#define EXPR_HEADER_SIZE  3
+
+// Postfix operator codes (used only inside ST_EXPR rpn code)
+// Literals, variables, '@', functions and single-character operators
+// ('*' '/' '%' '+' '-' '>' '<' '=' '&' '|' '^' '!' '~') keep their
+// internal code.
+typedef enum {
+  RPN_NEG       = 0x10,  // unary -
+  RPN_GE        = 0x11,  // >=
+  RPN_LE        = 0x12,  // <=
+  RPN_NE        = 0x13,  // <>, !=
+  RPN_SHL       = 0x14,  // <<
+  RPN_SHR       = 0x15,  // >>
+  RPN_LAND      = 0x16,  // &&
+  RPN_LOR       = 0x17,  // ||
+  RPN_VL        = 0x18,  // [RPN_VL][variable][literal][op] (optimized)
+  RPN_VV        = 0x19,  // [RPN_VV][variable][variable][op] (optimized)
+} rpn_code_e;
+
+// ST_FAST bytecode format (optimized statement)
+//   [ST_FAST][op length][statement length][op code ...][statement code ...]
+typedef enum {
+  FAST_ADD      = 0x01,  // [FAST_ADD][variable][literal]  : V+=k, V-=k, V++, V--, V=V+k
+  FAST_SET      = 0x02,  // [FAST_SET][variable][literal]  : V=k
+  FAST_OUTP     = 0x03,  // [FAST_OUTP][value offset][pin literal] : OUTP k,expr
+} fast_code_e;
+
 // int2str format
 #define FORM_NONE     0x00
 #define FORM_FLAG     0x01
@@ -218,9 +323,9 @@ typedef struct {
   uint8_t magic2;       // 'B'
   uint8_t verMajor;
   uint8_t verMinor;
-  int16_t progLength;
+  int16_t length;       // program bytes that follow (progLength)
   uint8_t autoRun;
-  uint8_t reserved;
+  uint8_t format;       // EEP_FORMAT_xxx (was reserved, 0 before Ver 0.19)
 } EEP_Header_t;
 
 #define EEP_MAGIC_1         'n'
@@ -229,4 +334,32 @@ typedef struct {
 #define EEP_HEADER_SIZE      sizeof(EEP_Header_t)
 #define EEP_PROGRAM_ADDR     (EEP_HEADER_ADDR + EEP_HEADER_SIZE)
 
+// EEP_Header_t.format
+// A program image is only valid for the build options it was made with.
+#define EEP_FORMAT_LZ        0x01 // Program stored compressed (SAVE_COMPRESS_ENABLE)
+#define EEP_FORMAT_INT32     0x10 // NANOBASIC_INT32_EN
+#define EEP_FORMAT_RPN       0x20 // EXPR_COMPILE_ENABLE
+#define EEP_FORMAT_FAST      0x40 // CODE_OPTIMIZE_ENABLE
+#define EEP_FORMAT_BUILD    ((NANOBASIC_INT32_EN ? EEP_FORMAT_INT32 : 0) | \
+                             (EXPR_COMPILE_ENABLE ? EEP_FORMAT_RPN : 0) | \
+                             (CODE_OPTIMIZE_ENABLE ? EEP_FORMAT_FAST : 0))
+
+// Compressed program (EEP_FORMAT_LZ)
+// A sequence of codes, decoded in place into the program area:
+//   0x00-0x7f      : copy the next (code + 1) bytes
+//   0x80-0xff, DD  : repeat (code - 0x80 + LZ_MATCH_MIN) bytes from DD + 1 bytes back
+#define LZ_MATCH_MIN         3
+#define LZ_MATCH_MAX         (0x7f + LZ_MATCH_MIN)
+#define LZ_LITERAL_MAX       0x80
+#define LZ_WINDOW            256
+
+// Program upload (LOAD !)
+// The image is EEP_Header_t followed by progLength bytes of program area,
+// the same layout as the EEPROM. It is sent as records of hex digits:
+//   ':' LL OOOO DD..DD CC CR
+// LL = data length, OOOO = image offset, CC = two's complement of the
+// byte sum of LL, OOOO and DD. A record with LL = 00 ends the upload,
+// its OOOO being the image length.
+#define UPLOAD_RECORD_LEN    32   // Data bytes per record sent by the host tool
+
 #endif
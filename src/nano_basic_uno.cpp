@@ -49,28 +49,257 @@
 #include "nano_basic_uno_conf.h"
 #include "nano_basic_defs.h"
 #include "bios_uno.h"
+#if ROM_PROGRAM_ENABLE
+#include "nano_basic_rom.h"
+#endif
+
+// Runtime counters (STAT)
+#if STAT_ENABLE
+#define STAT_ADD(id, n)   (statCounters[id] += (n))
+#define STAT_MAX(id, v)   do { if (statCounters[id] < (uint32_t)(v)) statCounters[id] = (v); } while (0)
+#else
+#define STAT_ADD(id, n)   ((void)0)
+#define STAT_MAX(id, v)   ((void)0)
+#endif
+
+#if OUTPUT_BUFF_SIZE
+#define printChar(c)      outputChar((char)c)
+#else
+#define printChar(c)      (STAT_ADD(STAT_CONSOLE_OUT, 1), bios_consolePutChar((char)c))
+#define outputFlush()
+#endif
+
+#define IDLE_WAIT_MAX     100   // [ms] longest bios_idle() in waits without a time limit
+#define OUTPUT_DROPPED_MAX 0x7fff  // count of dropped output bytes saturates here (CONSOLE_TX_DROP)
+
+#if CODE_OPTIMIZE_ENABLE && !EXPR_COMPILE_ENABLE
+#error "CODE_OPTIMIZE_ENABLE requires EXPR_COMPILE_ENABLE"
+#endif
+#if INTERP_DISPATCH == 2 && !defined(__GNUC__)
+#error "INTERP_DISPATCH 2 requires GCC or Clang (computed goto)"
+#endif
+
+#if ROM_PROGRAM_ENABLE
+#if RAM_ARENA_SIZE
+#error "ROM_PROGRAM_ENABLE cannot be used with RAM_ARENA_SIZE"
+#endif
+#if ROM_PROGRAM_VERSION != ((VERSION_MAJOR << 8) | VERSION_MINOR) || ROM_PROGRAM_FORMAT != EEP_FORMAT_BUILD
+#error "nano_basic_rom.h is for another version or configuration, make it again with --rom"
+#endif
+#if defined(__AVR__) && !defined(ROM_ADDR_TAG)
+// Flash addresses are tagged with bit 15: the RAM of the ATmega328P ends
+// at 0x08ff and its 32 KB flash at 0x7fff, so one pointer can hold either
+#define ROM_ADDR_TAG      0x8000
+#endif
+#endif
 
-#define inputChar()       bios_consoleGetChar()
-#define printChar(c)      bios_consolePutChar((char)c)
-
-static char inputBuff[INPUT_BUFF_SIZE];
-static uint8_t internalcodeBuff[CODE_BUFF_SIZE];
-static nb_int_t globalVariables[VARIABLE_NUM];
-static nb_int_t arrayValiables[ARRAY_INDEX_NUM];
-static stack_t stacks[STACK_NUM];
-static int16_t lineNumber;
-static uint8_t *executionPointer;
-static error_code_t errorCode;
-static uint8_t returnRequest;
-static uint8_t stackPointer;
-static uint8_t exprDepth;
-static uint8_t *dataReadPointer;
-static uint8_t *resumePointer;
-static int16_t resumeLineNumber;
-static int16_t progLength;
-static uint8_t programArea[PROGRAM_AREA_SIZE];
+// Program code is read with CODE_BYTE(), so that it can be executed from flash
+#ifdef ROM_ADDR_TAG
+#define CODE_BYTE(p)      codeByte(p)
+#define ROM_PTR(a)        ((uint8_t*)((uintptr_t)(a) | ROM_ADDR_TAG))
+#else
+#define CODE_BYTE(p)      (*(const uint8_t*)(p))
+#define ROM_PTR(a)        ((uint8_t*)(a))
+#endif
+
+#ifdef ROM_ADDR_TAG
+//*************************************************
+static inline uint8_t codeByte(const uint8_t *p)
+{
+  uintptr_t addr = (uintptr_t)p;
+  if (addr & ROM_ADDR_TAG) return pgm_read_byte(addr & ~(uintptr_t)ROM_ADDR_TAG);
+  return *p;
+}
+#endif
 
+#if ROM_PROGRAM_ENABLE
+// The program stays in flash, REPL lines still run from internalcodeBuff
+#define PROGRAM_AREA_TOP  ROM_PTR(romProgram)
+#define PROGRAM_AREA_LEN  ((int16_t)sizeof(romProgram))
+#define PROGRAM_AREA_MAX  PROGRAM_AREA_LEN
+#define ARRAY_SIZE        ARRAY_INDEX_NUM
+#elif RAM_ARENA_SIZE
+#define PROGRAM_AREA_TOP  ((uint8_t*)ramArena)
+#define PROGRAM_AREA_LEN  ((int16_t)((uint8_t*)arrayValiables - PROGRAM_AREA_TOP))
+#define PROGRAM_AREA_MAX  RAM_ARENA_SIZE
+#define ARRAY_SIZE        arraySize
+#if ARRAY_INDEX_NUM * (NANOBASIC_INT32_EN ? 4 : 2) + 3 > RAM_ARENA_SIZE
+#error "RAM_ARENA_SIZE must hold ARRAY_INDEX_NUM elements"
+#endif
+#else
 #define PROGRAM_AREA_TOP  programArea
+#define PROGRAM_AREA_LEN  PROGRAM_AREA_SIZE
+#define PROGRAM_AREA_MAX  PROGRAM_AREA_SIZE
+#define ARRAY_SIZE        ARRAY_INDEX_NUM
+#endif
+#define PROGRAM_AREA_FREE (PROGRAM_AREA_LEN - 3 - progLength)
+#define PROGRAM_FREE_BYTES (PROGRAM_AREA_FREE > 0 ? PROGRAM_AREA_FREE : 0)
+#if RAM_ARENA_SIZE && REPL_EDIT_ENABLE && REPL_HISTORY_ENABLE
+#define ARENA_HISTORY     1
+#endif
+
+#if REPL_EDIT_ENABLE && REPL_HISTORY_ENABLE
+#define HISTOTY_BUFF_SIZE	INPUT_BUFF_SIZE
+#endif
+
+// Interpreter state
+// The UNO build has a single static instance. Host builds (CONTEXT_ENABLE)
+// reach it through a per-thread pointer, so that several instances can run
+// in one process (see basicContextSet()).
+struct nb_context {
+  char inputBuff[INPUT_BUFF_SIZE];
+  uint8_t internalcodeBuff[CODE_BUFF_SIZE];
+  nb_int_t globalVariables[VARIABLE_NUM];
+#if RAM_ARENA_SIZE
+  // Program grows from the bottom of the arena, @array sits at the top (DIM)
+  nb_int_t ramArena[RAM_ARENA_SIZE / sizeof(nb_int_t)];
+  nb_int_t *arrayValiables = ramArena + (RAM_ARENA_SIZE / sizeof(nb_int_t) - ARRAY_INDEX_NUM);
+  int16_t arraySize = ARRAY_INDEX_NUM;
+#else
+  nb_int_t arrayValiables[ARRAY_INDEX_NUM];
+#endif
+  nb_stack_t stacks[STACK_NUM];
+  int16_t lineNumber;
+  uint8_t *executionPointer;
+  error_code_t errorCode;
+  uint8_t returnRequest;
+  uint8_t stackPointer;
+  uint8_t exprDepth;
+  uint8_t *dataReadPointer;
+  uint8_t *resumePointer;
+  int16_t resumeLineNumber;
+  int16_t progLength;
+#if !RAM_ARENA_SIZE && !ROM_PROGRAM_ENABLE
+  uint8_t programArea[PROGRAM_AREA_SIZE];
+#endif
+  char int2strBuff[13];
+#if OUTPUT_BUFF_SIZE
+  char outputBuff[OUTPUT_BUFF_SIZE];
+  uint8_t outputLen;
+#if CONSOLE_TX_DROP
+  uint16_t outputDropped;
+#endif
+#endif
+#if HISTOTY_BUFF_SIZE
+#if ARENA_HISTORY
+  uint8_t historyValid;
+#else
+  char historyBuff[HISTOTY_BUFF_SIZE];
+#endif
+#endif
+#if HOST_API_ENABLE
+  uint32_t statementCount;
+#endif
+#if STAT_ENABLE
+  uint32_t statCounters[STAT_COUNTER_NUM];
+#endif
+#if EVENT_TIMER_NUM
+  event_timer_t eventTimers[EVENT_TIMER_NUM];
+  uint8_t eventCount;        // timers in use
+  uint8_t eventLevel;        // stack level of the running handler (0: none)
+  uint8_t *waitResume;       // DELAY cut short by a timer, resumed after its handler
+  nb_int_t waitEnd;          // end tick of that DELAY
+#endif
+#if CAPTURE_ENABLE
+  nb_int_t captureTotal;     // samples requested by the last SAMPLE
+#endif
+#if PROFILE_LINE_NUM
+  profile_line_t profileLines[PROFILE_LINE_NUM];
+  int16_t profileLine;
+  nb_int_t profileTick;
+#endif
+#if PROFILE_SAMPLE_NUM
+  volatile uint16_t sampleLines[PROFILE_SAMPLE_NUM];
+  volatile uint16_t sampleContexts[4];   // interpreter, expr, findST, BIOS
+#endif
+#if LABEL_INDEX_NUM
+  label_index_t labelIndex[LABEL_INDEX_NUM];
+  uint8_t labelIndexCount;
+  uint8_t labelIndexOver;
+#endif
+#if BLOCK_INDEX_NUM
+  block_index_t blockIndex[BLOCK_INDEX_NUM];
+  uint8_t blockIndexCount;
+#endif
+#if DATA_INDEX_NUM
+  uint16_t dataIndex[DATA_INDEX_NUM];    // DATA item offsets in program order
+  uint16_t dataIndexCount;
+  uint16_t dataReadIndex;                // next item for READ
+  uint8_t dataIndexOver;
+#endif
+#if EXPR_COMPILE_ENABLE
+  uint8_t *rpnPointer;
+  uint8_t rpnDepth;
+  uint8_t rpnOps;
+#if CODE_OPTIMIZE_ENABLE
+  uint8_t *rpnItem;
+#endif
+#endif
+};
+
+#if CONTEXT_ENABLE
+static nb_context_t nbDefault;
+static thread_local nb_context_t *nbContext = &nbDefault;
+#define NB                (*nbContext)
+#else
+static nb_context_t nbContext;
+#define NB                nbContext
+#endif
+#define inputBuff         NB.inputBuff
+#define internalcodeBuff  NB.internalcodeBuff
+#define globalVariables   NB.globalVariables
+#define ramArena          NB.ramArena
+#define arrayValiables    NB.arrayValiables
+#define arraySize         NB.arraySize
+#define stacks            NB.stacks
+#define lineNumber        NB.lineNumber
+#define executionPointer  NB.executionPointer
+#define errorCode         NB.errorCode
+#define returnRequest     NB.returnRequest
+#define stackPointer      NB.stackPointer
+#define exprDepth         NB.exprDepth
+#define dataReadPointer   NB.dataReadPointer
+#define resumePointer     NB.resumePointer
+#define resumeLineNumber  NB.resumeLineNumber
+#define progLength        NB.progLength
+#define programArea       NB.programArea
+#define int2strBuff       NB.int2strBuff
+#define outputBuff        NB.outputBuff
+#define outputLen         NB.outputLen
+#define outputDropped     NB.outputDropped
+#define historyValid      NB.historyValid
+#if ARENA_HISTORY
+// Kept in the free arena space below @array while the program leaves room
+#define historyBuff       ((char*)arrayValiables - HISTOTY_BUFF_SIZE)
+#else
+#define historyBuff       NB.historyBuff
+#endif
+#define statementCount    NB.statementCount
+#define statCounters      NB.statCounters
+#define eventTimers       NB.eventTimers
+#define eventCount        NB.eventCount
+#define eventLevel        NB.eventLevel
+#define waitResume        NB.waitResume
+#define waitEnd           NB.waitEnd
+#define captureTotal      NB.captureTotal
+#define profileLines      NB.profileLines
+#define profileLine       NB.profileLine
+#define profileTick       NB.profileTick
+#define sampleLines       NB.sampleLines
+#define sampleContexts    NB.sampleContexts
+#define labelIndex        NB.labelIndex
+#define labelIndexCount   NB.labelIndexCount
+#define labelIndexOver    NB.labelIndexOver
+#define blockIndex        NB.blockIndex
+#define blockIndexCount   NB.blockIndexCount
+#define dataIndex         NB.dataIndex
+#define dataIndexCount    NB.dataIndexCount
+#define dataReadIndex     NB.dataReadIndex
+#define dataIndexOver     NB.dataIndexOver
+#define rpnPointer        NB.rpnPointer
+#define rpnDepth          NB.rpnDepth
+#define rpnOps            NB.rpnOps
+#define rpnItem           NB.rpnItem
 
 static void proc_print(void);
 static void proc_input(void);
@@ -107,6 +336,17 @@ static void proc_data(void);
 static void proc_read(void);
 static void proc_restore(void);
 static void proc_pwm(void);
+static void proc_profile(void);
+static void proc_every(void);
+static void proc_after(void);
+static void proc_outport(void);
+static void proc_portdir(void);
+static void proc_sample(void);
+static void proc_fill(void);
+static void proc_copy(void);
+static void proc_shift(void);
+static void proc_dim(void);
+static void proc_stat(void);
 
 static void interpreterMain(void);
 static uint8_t inputString(uint8_t history_flag);
@@ -114,37 +354,136 @@ static uint8_t convertInternalCode(uint8_t *dst, char *src);
 static void proc_let(nb_int_t*pvar);
 static void initializeValiables(void);
 static nb_int_t *getArrayReference(void);
+static nb_int_t *getArrayRange(nb_int_t index, nb_int_t count);
+#if RAM_ARENA_SIZE
+static void arraySetSize(int16_t num);
+#endif
+#if ARENA_HISTORY
+static void historyCheck(void);
+#endif
 static nb_int_t calcValue(void);
 static nb_int_t expr4th(void);
 static nb_int_t expr3nd(void);
 static nb_int_t expr2nd(void);
 static nb_int_t expr(void);
+static nb_int_t exprMain(void);
+#if EXPR_COMPILE_ENABLE
+static uint8_t rpnExpr(void);
+static uint8_t exprCompileLine(uint8_t *top);
+static nb_int_t exprCompiled(void);
+static nb_int_t rpnCalc(uint8_t op, nb_int_t a, nb_int_t b);
+#endif
+#if CODE_OPTIMIZE_ENABLE
+static uint8_t codeOptimizeLine(uint8_t *top);
+static void proc_fast(void);
+#endif
+#if INTERP_DISPATCH
+static void dispatchFast(void);
+static void dispatchArray(void);
+static void dispatchVariable(void);
+#endif
+#if INTERP_DISPATCH == 1
+static void dispatchNop(void);
+static void dispatchSyntax(void);
+#endif
 static nb_int_t calcValueFunc(void);
 static void printInternalcode(void);
 static void printError(void);
 static void executeBreak(void);
 static error_code_t checkST(uint8_t ch);
+static uint8_t isDelimiter(uint8_t ch);
 static error_code_t checkDelimiter(void);
 static error_code_t delayMs(nb_int_t val);
+static int16_t inputChar(void);
+static int16_t checkBreak(void);
 static int16_t checkBreakKey(void);
 static uint8_t* findST(const uint8_t* st_list, int16_t* lnum);
+static uint8_t* findSTMain(const uint8_t* st_list, int16_t* lnum);
+static uint8_t* findNextLoop(uint8_t* ptr, uint8_t ch);
 static int8_t progLoad(void);
+static int8_t progHeaderCheck(const EEP_Header_t *eep);
+static void progHeaderSet(EEP_Header_t *eep, uint8_t autorun);
+static void progSave(uint8_t autorun);
+static uint8_t progChainCheck(void);
+#if SAVE_COMPRESS_ENABLE
+static int16_t progCompress(uint16_t limit);
+#if !ROM_PROGRAM_ENABLE
+static int8_t progExpand(void);
+#endif
+#endif
+#if UPLOAD_ENABLE
+static void progUpload(void);
+static int16_t uploadGetChar(void);
+static int16_t uploadGetByte(uint8_t *sum);
+static void uploadReply(char ch);
+#endif
 static void programNew(void);
 static void programInit(void);
+static void programIndexBuild(void);
+static void programIndexClear(void);
+static uint8_t *programStoreLine(uint8_t *ptr);
+static void programStoreEnd(uint8_t *ptr);
+#if PROFILE_LINE_NUM || PROFILE_SAMPLE_NUM
+static void profilePrintLine(int16_t line);
+#endif
+#if PROFILE_LINE_NUM
+static void profileStatement(void);
+static uint8_t profileBefore(const profile_line_t *a, const profile_line_t *b);
+static void profilePrint(nb_int_t num);
+static void profileClear(void);
+#endif
+#if PROFILE_SAMPLE_NUM
+static void samplePrint(nb_int_t num);
+static void sampleClear(void);
+#endif
+#if STAT_ENABLE
+static uint32_t statValue(uint8_t id);
+static void statPrint(void);
+static void statClear(void);
+#endif
+static nb_int_t stat_func(nb_int_t val);
+#if LABEL_INDEX_NUM
+static uint8_t labelIndexSearch(nb_int_t val);
+#endif
+#if DATA_INDEX_NUM
+static void dataIndexBuild(void);
+static uint16_t dataIndexSearch(uint8_t *ptr);
+#endif
+#if EVENT_TIMER_NUM
+static void eventSet(uint8_t type);
+static uint8_t eventService(void);
+static nb_int_t eventIdleTime(nb_int_t max_ms);
+static void eventClear(void);
+#endif
 static void programRun(void);
 static void printVal(nb_int_t val);
 static void printString(const char *str);
 static void printStringFlash(const __FlashStringHelper* ifsh);
 static void printNewline(void);
+#if OUTPUT_BUFF_SIZE
+static void outputChar(char ch);
+static void outputFlush(void);
+#endif
+#if OUTPUT_BUFF_SIZE && CONSOLE_TX_DROP
+static void printDropped(void);
+#else
+#define printDropped()
+#endif
+#if PROFILE_LINE_NUM || PROFILE_SAMPLE_NUM || STAT_ENABLE
+static void printCounter(uint32_t val, uint8_t width);
+#endif
 static char *int2str(nb_int_t para, uint8_t ff, int16_t len);
+static nb_int_t str2val(char* str);
+static nb_int_t inkey_func(nb_int_t val);
 static uint8_t* get_dec_val(uint8_t* ptr, nb_int_t* val);
 static uint8_t* set_dec_val(uint8_t* ptr, nb_int_t val);
 static uint8_t* get_next_ptr(uint8_t* ptr);
 static uint8_t* findNextLoop(uint8_t* ptr, uint8_t ch);
+static uint8_t get_port_args(nb_int_t *port, nb_int_t *value, nb_int_t *mask);
 
 typedef void (*PROC)(void);
 
-static const PROC procCodeList[] = {
+static constexpr PROC procCodeList[] = {
   proc_print    , // 0x80 : ST_PRINT
   proc_input    , // 0x81 : ST_INPUT
   proc_goto     , // 0x82 : ST_GOTO
@@ -176,69 +515,181 @@ static const PROC procCodeList[] = {
   proc_restore  , // 0x9c : ST_RESTORE
   proc_outp     , // 0x9d : ST_OUTP
   proc_pwm      , // 0x9e : ST_PWM
-  proc_else     , // 0x9f : ST_ELSE
-  proc_elseif   , // 0xa0 : ST_ELSEIF
-  proc_endif    , // 0xa1 : ST_ENDIF
+  proc_profile  , // 0x9f : ST_PROFILE
+  proc_every    , // 0xa0 : ST_EVERY
+  proc_after    , // 0xa1 : ST_AFTER
+  proc_outport  , // 0xa2 : ST_OUTPORT
+  proc_portdir  , // 0xa3 : ST_PORTDIR
+  proc_sample   , // 0xa4 : ST_SAMPLE
+  proc_fill     , // 0xa5 : ST_FILL
+  proc_copy     , // 0xa6 : ST_COPY
+  proc_shift    , // 0xa7 : ST_SHIFT
+  proc_dim      , // 0xa8 : ST_DIM
+  proc_stat     , // 0xa9 : ST_STAT
+  proc_else     , // 0xaa : ST_ELSE
+  proc_elseif   , // 0xab : ST_ELSEIF
+  proc_endif    , // 0xac : ST_ENDIF
+};
+
+// Classify one code byte for the interpreter dispatch tables.
+// Every case is resolved at compile time, so the tables hold the final target.
+#define DISPATCH_SELECT(c, eol, nop, fast, array, var, comment, stmt, syntax) \
+  ((c) == ST_EOL ? (eol) : \
+   ((c) == ' ' || (c) == '\t' || (c) == ':') ? (nop) : \
+   (c) == ST_FAST ? (fast) : \
+   (c) == ST_ARRAY ? (array) : \
+   ((c) >= 'A' && (c) <= 'Z') ? (var) : \
+   (c) == ST_COMMENT ? (comment) : \
+   ((c) >= STCODE_START && (c) <= STCODE_END) ? (stmt) : (syntax))
+
+// Per-statement hooks (host statement counter, STAT, profiler)
+#if HOST_API_ENABLE
+#define COUNT_HOST()      statementCount++
+#else
+#define COUNT_HOST()
+#endif
+#if PROFILE_LINE_NUM
+#define COUNT_PROFILE()   profileStatement()
+#else
+#define COUNT_PROFILE()
+#endif
+#define COUNT_STATEMENT() do { COUNT_HOST(); STAT_ADD(STAT_STATEMENTS, 1); COUNT_PROFILE(); } while (0)
+
+#define DISPATCH_ROW(E, h) \
+  E(h##0), E(h##1), E(h##2), E(h##3), E(h##4), E(h##5), E(h##6), E(h##7), \
+  E(h##8), E(h##9), E(h##a), E(h##b), E(h##c), E(h##d), E(h##e), E(h##f)
+
+#define DISPATCH_TABLE(E) \
+  DISPATCH_ROW(E, 0x0), DISPATCH_ROW(E, 0x1), DISPATCH_ROW(E, 0x2), DISPATCH_ROW(E, 0x3), \
+  DISPATCH_ROW(E, 0x4), DISPATCH_ROW(E, 0x5), DISPATCH_ROW(E, 0x6), DISPATCH_ROW(E, 0x7), \
+  DISPATCH_ROW(E, 0x8), DISPATCH_ROW(E, 0x9), DISPATCH_ROW(E, 0xa), DISPATCH_ROW(E, 0xb), \
+  DISPATCH_ROW(E, 0xc), DISPATCH_ROW(E, 0xd), DISPATCH_ROW(E, 0xe), DISPATCH_ROW(E, 0xf)
+
+#if INTERP_DISPATCH == 1
+#define DISPATCH_PROC(c) DISPATCH_SELECT(c, dispatchSyntax, dispatchNop, dispatchFast, \
+  dispatchArray, dispatchVariable, proc_comment, \
+  procCodeList[(c) - STCODE_START], dispatchSyntax)
+
+static const PROC dispatchTable[256] PROGMEM = {
+  DISPATCH_TABLE(DISPATCH_PROC)
 };
+#endif
 
-const char token_st_80[] PROGMEM = "Print"    ; // 0x80 : ST_PRINT
-const char token_st_81[] PROGMEM = "Input"    ; // 0x81 : ST_INPUT
-const char token_st_82[] PROGMEM = "Goto"     ; // 0x82 : ST_GOTO
-const char token_st_83[] PROGMEM = "Gosub"    ; // 0x83 : ST_GOSUB
-const char token_st_84[] PROGMEM = "Return"   ; // 0x84 : ST_RETURN
-const char token_st_85[] PROGMEM = "For"      ; // 0x85 : ST_FOR
-const char token_st_86[] PROGMEM = "Next"     ; // 0x86 : ST_NEXT
-const char token_st_87[] PROGMEM = "Do"       ; // 0x87 : ST_DO
-const char token_st_88[] PROGMEM = "Loop"     ; // 0x88 : ST_LOOP
-const char token_st_89[] PROGMEM = "While"    ; // 0x89 : ST_WHILE
-const char token_st_8a[] PROGMEM = "If"       ; // 0x8a : ST_IF
-const char token_st_8b[] PROGMEM = "Run"      ; // 0x8b : ST_RUN
-const char token_st_8c[] PROGMEM = "Resume"   ; // 0x8c : ST_RESUME
-const char token_st_8d[] PROGMEM = "Stop"     ; // 0x8d : ST_STOP
-const char token_st_8e[] PROGMEM = "End"      ; // 0x8e : ST_END
-const char token_st_8f[] PROGMEM = "New"      ; // 0x8f : ST_NEW
-const char token_st_90[] PROGMEM = "List"     ; // 0x90 : ST_LIST
-const char token_st_91[] PROGMEM = "Prog"     ; // 0x91 : ST_PROG
-const char token_st_92[] PROGMEM = "Save"     ; // 0x92 : ST_SAVE
-const char token_st_93[] PROGMEM = "Load"     ; // 0x93 : ST_LOAD
-const char token_st_94[] PROGMEM = "Delay"    ; // 0x94 : ST_DELAY
-const char token_st_95[] PROGMEM = "Pause"    ; // 0x95 : ST_PAUSE
-const char token_st_96[] PROGMEM = "Reset"    ; // 0x96 : ST_RESET
-const char token_st_97[] PROGMEM = "Exit"     ; // 0x97 : ST_EXIT
-const char token_st_98[] PROGMEM = "Continue" ; // 0x98 : ST_CONTINUE
-const char token_st_99[] PROGMEM = "Randomize"; // 0x99 : ST_RONDOMIZE
-const char token_st_9a[] PROGMEM = "Data"     ; // 0x9a : ST_DATA
-const char token_st_9b[] PROGMEM = "Read"     ; // 0x9b : ST_READ
-const char token_st_9c[] PROGMEM = "Restore"  ; // 0x9c : ST_RESTORE
-const char token_st_9d[] PROGMEM = "Outp"     ; // 0x9d : ST_OUTP
-const char token_st_9e[] PROGMEM = "Pwm"      ; // 0x9e : ST_PWM
-const char token_st_9f[] PROGMEM = "Else"     ; // 0x9f : ST_ELSE
-const char token_st_a0[] PROGMEM = "ElseIf"   ; // 0xa0 : ST_ELSEIF
-const char token_st_a1[] PROGMEM = "EndIf"    ; // 0xa1 : ST_ENDIF
-const char token_st_a2[] PROGMEM = "Then"     ; // 0xa2 : ST_THEN
-const char token_st_a3[] PROGMEM = "To"       ; // 0xa3 : ST_TO
-const char token_st_a4[] PROGMEM = "Step"     ; // 0xa4 : ST_STEP
-const char token_fn_a5[] PROGMEM = "Rnd"      ; // 0xa5 : FUNC_RND
-const char token_fn_a6[] PROGMEM = "Abs"      ; // 0xa6 : FUNC_ABS
-const char token_fn_a7[] PROGMEM = "Inp"      ; // 0xa7 : FUNC_INP
-const char token_fn_a8[] PROGMEM = "Adc"      ; // 0xa8 : FUNC_ADC
-const char token_fn_a9[] PROGMEM = "Inkey"    ; // 0xa9 : VAL_INKEY
-const char token_fn_aa[] PROGMEM = "Chr"      ; // 0xaa : FUNC_CHR
-const char token_fn_ab[] PROGMEM = "Dec"      ; // 0xaa : FUNC_DEC
-const char token_fn_ac[] PROGMEM = "Hex"      ; // 0xab : FUNC_HEX
-const char token_va_ad[] PROGMEM = "Tick"     ; // 0xac : VAL_TICK
-
-static const char * const keyWordList[] PROGMEM = {
+constexpr char token_st_80[] PROGMEM = "Print"    ; // 0x80 : ST_PRINT
+constexpr char token_st_81[] PROGMEM = "Input"    ; // 0x81 : ST_INPUT
+constexpr char token_st_82[] PROGMEM = "Goto"     ; // 0x82 : ST_GOTO
+constexpr char token_st_83[] PROGMEM = "Gosub"    ; // 0x83 : ST_GOSUB
+constexpr char token_st_84[] PROGMEM = "Return"   ; // 0x84 : ST_RETURN
+constexpr char token_st_85[] PROGMEM = "For"      ; // 0x85 : ST_FOR
+constexpr char token_st_86[] PROGMEM = "Next"     ; // 0x86 : ST_NEXT
+constexpr char token_st_87[] PROGMEM = "Do"       ; // 0x87 : ST_DO
+constexpr char token_st_88[] PROGMEM = "Loop"     ; // 0x88 : ST_LOOP
+constexpr char token_st_89[] PROGMEM = "While"    ; // 0x89 : ST_WHILE
+constexpr char token_st_8a[] PROGMEM = "If"       ; // 0x8a : ST_IF
+constexpr char token_st_8b[] PROGMEM = "Run"      ; // 0x8b : ST_RUN
+constexpr char token_st_8c[] PROGMEM = "Resume"   ; // 0x8c : ST_RESUME
+constexpr char token_st_8d[] PROGMEM = "Stop"     ; // 0x8d : ST_STOP
+constexpr char token_st_8e[] PROGMEM = "End"      ; // 0x8e : ST_END
+constexpr char token_st_8f[] PROGMEM = "New"      ; // 0x8f : ST_NEW
+constexpr char token_st_90[] PROGMEM = "List"     ; // 0x90 : ST_LIST
+constexpr char token_st_91[] PROGMEM = "Prog"     ; // 0x91 : ST_PROG
+constexpr char token_st_92[] PROGMEM = "Save"     ; // 0x92 : ST_SAVE
+constexpr char token_st_93[] PROGMEM = "Load"     ; // 0x93 : ST_LOAD
+constexpr char token_st_94[] PROGMEM = "Delay"    ; // 0x94 : ST_DELAY
+constexpr char token_st_95[] PROGMEM = "Pause"    ; // 0x95 : ST_PAUSE
+constexpr char token_st_96[] PROGMEM = "Reset"    ; // 0x96 : ST_RESET
+constexpr char token_st_97[] PROGMEM = "Exit"     ; // 0x97 : ST_EXIT
+constexpr char token_st_98[] PROGMEM = "Continue" ; // 0x98 : ST_CONTINUE
+constexpr char token_st_99[] PROGMEM = "Randomize"; // 0x99 : ST_RONDOMIZE
+constexpr char token_st_9a[] PROGMEM = "Data"     ; // 0x9a : ST_DATA
+constexpr char token_st_9b[] PROGMEM = "Read"     ; // 0x9b : ST_READ
+constexpr char token_st_9c[] PROGMEM = "Restore"  ; // 0x9c : ST_RESTORE
+constexpr char token_st_9d[] PROGMEM = "Outp"     ; // 0x9d : ST_OUTP
+constexpr char token_st_9e[] PROGMEM = "Pwm"      ; // 0x9e : ST_PWM
+constexpr char token_st_9f[] PROGMEM = "Profile"  ; // 0x9f : ST_PROFILE
+constexpr char token_st_a0[] PROGMEM = "Every"    ; // 0xa0 : ST_EVERY
+constexpr char token_st_a1[] PROGMEM = "After"    ; // 0xa1 : ST_AFTER
+constexpr char token_st_a2[] PROGMEM = "OutPort"  ; // 0xa2 : ST_OUTPORT
+constexpr char token_st_a3[] PROGMEM = "PortDir"  ; // 0xa3 : ST_PORTDIR
+constexpr char token_st_a4[] PROGMEM = "Sample"   ; // 0xa4 : ST_SAMPLE
+constexpr char token_st_a5[] PROGMEM = "Fill"     ; // 0xa5 : ST_FILL
+constexpr char token_st_a6[] PROGMEM = "Copy"     ; // 0xa6 : ST_COPY
+constexpr char token_st_a7[] PROGMEM = "Shift"    ; // 0xa7 : ST_SHIFT
+constexpr char token_st_a8[] PROGMEM = "Dim"      ; // 0xa8 : ST_DIM
+constexpr char token_st_a9[] PROGMEM = "Stat"     ; // 0xa9 : ST_STAT
+constexpr char token_st_aa[] PROGMEM = "Else"     ; // 0xaa : ST_ELSE
+constexpr char token_st_ab[] PROGMEM = "ElseIf"   ; // 0xab : ST_ELSEIF
+constexpr char token_st_ac[] PROGMEM = "EndIf"    ; // 0xac : ST_ENDIF
+constexpr char token_st_ad[] PROGMEM = "Then"     ; // 0xad : ST_THEN
+constexpr char token_st_ae[] PROGMEM = "To"       ; // 0xae : ST_TO
+constexpr char token_st_af[] PROGMEM = "Step"     ; // 0xaf : ST_STEP
+constexpr char token_fn_b0[] PROGMEM = "Rnd"      ; // 0xb0 : FUNC_RND
+constexpr char token_fn_b1[] PROGMEM = "Abs"      ; // 0xb1 : FUNC_ABS
+constexpr char token_fn_b2[] PROGMEM = "Inp"      ; // 0xb2 : FUNC_INP
+constexpr char token_fn_b3[] PROGMEM = "Adc"      ; // 0xb3 : FUNC_ADC
+constexpr char token_fn_b4[] PROGMEM = "Inkey"    ; // 0xb4 : VAL_INKEY
+constexpr char token_fn_b5[] PROGMEM = "Chr"      ; // 0xb5 : FUNC_CHR
+constexpr char token_fn_b6[] PROGMEM = "Dec"      ; // 0xb6 : FUNC_DEC
+constexpr char token_fn_b7[] PROGMEM = "Hex"      ; // 0xb7 : FUNC_HEX
+constexpr char token_fn_b8[] PROGMEM = "InPort"   ; // 0xb8 : FUNC_INPORT
+constexpr char token_fn_b9[] PROGMEM = "Sum"      ; // 0xb9 : FUNC_SUM
+constexpr char token_fn_ba[] PROGMEM = "Min"      ; // 0xba : FUNC_MIN
+constexpr char token_fn_bb[] PROGMEM = "Max"      ; // 0xbb : FUNC_MAX
+constexpr char token_fn_bc[] PROGMEM = "Raw"      ; // 0xbc : FUNC_RAW
+constexpr char token_fn_bd[] PROGMEM = "Elapsed"  ; // 0xbd : FUNC_ELAPSED
+constexpr char token_va_be[] PROGMEM = "Tick"     ; // 0xbe : VAL_TICK
+constexpr char token_va_bf[] PROGMEM = "Free"     ; // 0xbf : SVAR_FREE
+constexpr char token_va_c0[] PROGMEM = "UTick"    ; // 0xc0 : SVAR_UTICK
+
+static constexpr const char *keyWordList[] PROGMEM = {
   token_st_80, token_st_81, token_st_82, token_st_83, token_st_84, token_st_85, token_st_86, token_st_87,
   token_st_88, token_st_89, token_st_8a, token_st_8b, token_st_8c, token_st_8d, token_st_8e, token_st_8f,
   token_st_90, token_st_91, token_st_92, token_st_93, token_st_94, token_st_95, token_st_96, token_st_97,
   token_st_98, token_st_99, token_st_9a, token_st_9b, token_st_9c, token_st_9d, token_st_9e, token_st_9f,
-  token_st_a0, token_st_a1, token_st_a2, token_st_a3, token_st_a4,
-  token_fn_a5, token_fn_a6, token_fn_a7, token_fn_a8, token_fn_a9, token_fn_aa, token_fn_ab, token_fn_ac,
-  token_va_ad,
+  token_st_a0, token_st_a1, token_st_a2, token_st_a3, token_st_a4, token_st_a5, token_st_a6, token_st_a7,
+  token_st_a8, token_st_a9, token_st_aa, token_st_ab, token_st_ac, token_st_ad, token_st_ae, token_st_af,
+  token_fn_b0, token_fn_b1, token_fn_b2, token_fn_b3, token_fn_b4, token_fn_b5, token_fn_b6, token_fn_b7,
+  token_fn_b8, token_fn_b9, token_fn_ba, token_fn_bb, token_fn_bc, token_fn_bd,
+  token_va_be, token_va_bf, token_va_c0,
   NULL
 };
 
+// First-letter index of keyWordList[] for convertInternalCode(), built by the compiler:
+// keyWordFirst[] holds the first keyword of each letter, keyWordNext[] the next one
+// with the same letter, so a word is only compared with the keywords of its letter
+#define KEYWORD_NUM   (sizeof(keyWordList) / sizeof(keyWordList[0]) - 1)
+#define KEYWORD_NONE  0xff
+
+static constexpr uint8_t keyWordFind(uint8_t index, char letter)
+{
+  return (index >= KEYWORD_NUM) ? KEYWORD_NONE :
+         (keyWordList[index][0] == letter) ? index : keyWordFind(index + 1, letter);
+}
+
+static constexpr uint8_t keyWordFollow(uint8_t index)
+{
+  return (index >= KEYWORD_NUM) ? KEYWORD_NONE : keyWordFind(index + 1, keyWordList[index][0]);
+}
+
+#define KEYWORD_FIRST(c) keyWordFind(0, c)
+
+static const uint8_t keyWordFirst[26] PROGMEM = {
+  KEYWORD_FIRST('A'), KEYWORD_FIRST('B'), KEYWORD_FIRST('C'), KEYWORD_FIRST('D'),
+  KEYWORD_FIRST('E'), KEYWORD_FIRST('F'), KEYWORD_FIRST('G'), KEYWORD_FIRST('H'),
+  KEYWORD_FIRST('I'), KEYWORD_FIRST('J'), KEYWORD_FIRST('K'), KEYWORD_FIRST('L'),
+  KEYWORD_FIRST('M'), KEYWORD_FIRST('N'), KEYWORD_FIRST('O'), KEYWORD_FIRST('P'),
+  KEYWORD_FIRST('Q'), KEYWORD_FIRST('R'), KEYWORD_FIRST('S'), KEYWORD_FIRST('T'),
+  KEYWORD_FIRST('U'), KEYWORD_FIRST('V'), KEYWORD_FIRST('W'), KEYWORD_FIRST('X'),
+  KEYWORD_FIRST('Y'), KEYWORD_FIRST('Z'),
+};
+
+static const uint8_t keyWordNext[] PROGMEM = {
+  DISPATCH_ROW(keyWordFollow, 0x0), DISPATCH_ROW(keyWordFollow, 0x1),
+  DISPATCH_ROW(keyWordFollow, 0x2), DISPATCH_ROW(keyWordFollow, 0x3),
+  DISPATCH_ROW(keyWordFollow, 0x4),
+};
+static_assert(KEYWORD_NUM <= sizeof(keyWordNext), "keyWordNext[] needs another DISPATCH_ROW");
+
 const char error00[] PROGMEM = "";                    // 00 : No error
 const char error01[] PROGMEM = "Syntax";              // 01 : ERROR_SYNTAX
 const char error02[] PROGMEM = "Division by 0";       // 02 : ERROR_DIVZERO
@@ -259,16 +710,29 @@ const char error16[] PROGMEM = "Loop";                // 16 : ERROR_UXLOOP
 const char error17[] PROGMEM = "Exit";                // 17 : ERROR_UXEXIT
 const char error18[] PROGMEM = "Continue";            // 18 : ERROR_UXCONTINUE
 const char error19[] PROGMEM = "Read";                // 18 : ERROR_UXREAD
+const char error20[] PROGMEM = "Upload";              // 20 : ERROR_UPLOAD
+const char error21[] PROGMEM = "PG version";          // 21 : ERROR_PGVER
+const char error22[] PROGMEM = "PG in ROM";           // 22 : ERROR_PGROM
 
 static const char * const errorSting[] PROGMEM = {
   error00, error01, error02, error03, error04, error05, error06, error07,
   error08, error09, error10, error11, error12, error13,
-  error14, error15, error16, error17, error18, error19
+  error14, error15, error16, error17, error18, error19,
+  error20, error21, error22
 };
 
 #define IS_ST_VAL(c)        (((c) & VAL_ST_MASK) == ST_VAL)
 #define IS_ST_VAL_DEC(c)    (((c) & (VAL_ST_MASK | VAL_BASE_MASK)) == ST_VAL_DEC)
 #define IS_VAL(c)           (IS_ST_VAL(c) || ((c) >= '0' && (c) <= '9'))
+
+// Block search kinds (findBlockST / block index key)
+#define BLOCK_IF            0   // IF / ELSEIF -> ENDIF, ELSE, ELSEIF
+#define BLOCK_ENDIF         1   // ELSE / ELSEIF -> ENDIF
+#define BLOCK_LOOP          2   // WHILE / EXIT -> LOOP
+#define BLOCK_NEXT          3   // EXIT / CONTINUE -> NEXT
+
+static const uint8_t st_list_if[] = { ST_ENDIF, ST_ELSE, ST_ELSEIF, 0 };
+static const uint8_t st_list_endif[] = { ST_ENDIF, 0 };
 #define GET_VAL_SIZE(c)     (((c) & VAL_SIZE_MASK) + 1)
 #define IS_VALID_CHR(c)     ((c)<0x3f || (c)=='^' || (c)=='|' || (c)=='~' || (c)=='[' || (c)==']')
 
@@ -276,6 +740,9 @@ static const char * const errorSting[] PROGMEM = {
 void basicInit(void)
 {
   bios_init();
+#if RAM_ARENA_SIZE
+  arraySetSize(ARRAY_INDEX_NUM);
+#endif
   initializeValiables();
   printStringFlash(F("\r\n" NAME_STR EXT_NAME_STR " " VERSION_STR "\r\n"));
 
@@ -284,6 +751,7 @@ void basicInit(void)
     if (delayMs(AUTORUN_WAIT_TIME) == ERROR_NONE) {
       programRun();
       interpreterMain();
+      printDropped();
       return;
     }
     printError();
@@ -304,28 +772,229 @@ void basicMain(void)
     if (inputString(true) == 0) {
       if (!errorCode) continue;
       printError();
-      return;
+      break;
     }
     if (inputBuff[0] == '\0') continue;
     len = convertInternalCode(internalcodeBuff, inputBuff);
     if (errorCode != ERROR_NONE) {
       printError();
-      return;
+      break;
     }
     if (len > 1) {
       executionPointer = internalcodeBuff;
       interpreterMain();
-      return;
+      printDropped();
+      break;
+    }
+  }
+  outputFlush();    // the output of the line is complete when it returns
+}
+
+#if CONTEXT_ENABLE
+//*************************************************
+nb_context_t *basicContextNew(void)
+{
+  return new nb_context_t();
+}
+
+//*************************************************
+void basicContextFree(nb_context_t *ctx)
+{
+  if (ctx == nbContext) nbContext = &nbDefault;
+  delete ctx;
+}
+
+//*************************************************
+void basicContextSet(nb_context_t *ctx)
+{
+  nbContext = ctx ? ctx : &nbDefault;
+}
+
+//*************************************************
+void basicInitContext(nb_context_t *ctx)
+{
+  basicContextSet(ctx);
+  basicInit();
+}
+
+//*************************************************
+void basicMainContext(nb_context_t *ctx)
+{
+  basicContextSet(ctx);
+  basicMain();
+}
+#endif
+
+#if HOST_API_ENABLE
+//*************************************************
+int8_t basicLoadProgram(const char *text)
+{
+#if ROM_PROGRAM_ENABLE
+  (void)text;
+  errorCode = ERROR_PGROM;
+  return (int8_t)errorCode;
+#else
+  uint8_t *ptr, len;
+
+  initializeValiables();
+  programNew();
+  errorCode = ERROR_NONE;
+  lineNumber = 0;
+  ptr = (uint8_t*)PROGRAM_AREA_TOP;
+  while (*text && errorCode == ERROR_NONE) {
+    len = 0;
+    while (*text && *text != '\n' && *text != '\r') {
+      if (len >= INPUT_BUFF_SIZE - 1) {
+        errorCode = ERROR_SYNTAX;
+        break;
+      }
+      inputBuff[len++] = *text++;
+    }
+    if (errorCode != ERROR_NONE) break;
+    if (*text == '\r') text++;
+    if (*text == '\n') text++;
+    inputBuff[len] = '\0';
+    if (inputBuff[0] == CHR_PROG_TERM) break;
+    if (len > 0) {
+      ptr = programStoreLine(ptr);
+    }
+  }
+  programStoreEnd(ptr);
+  return (int8_t)errorCode;
+#endif
+}
+
+//*************************************************
+int8_t basicRunProgram(void)
+{
+  statementCount = 0;
+  programRun();
+  interpreterMain();
+  printDropped();
+  outputFlush();
+  lineNumber = 0;
+  return (int8_t)errorCode;
+}
+
+//*************************************************
+uint32_t basicStatementCount(void)
+{
+  return statementCount;
+}
+
+//*************************************************
+int16_t basicProgramImage(uint8_t *buf, uint16_t size, uint8_t autorun)
+{
+  EEP_Header_t eep;
+
+  if (CODE_BYTE(PROGRAM_AREA_TOP) == ST_EOL) return -1;
+  if (EEP_HEADER_SIZE + (uint16_t)progLength > size) return -1;
+  progHeaderSet(&eep, autorun);
+  memcpy(buf, &eep, EEP_HEADER_SIZE);
+  for (int16_t i = 0; i < progLength; i++) {
+    buf[EEP_HEADER_SIZE + i] = CODE_BYTE(PROGRAM_AREA_TOP + i);
+  }
+  return (int16_t)(EEP_HEADER_SIZE + progLength);
+}
+
+//*************************************************
+void basicProgramLimits(int16_t *array_size, int16_t *free_bytes)
+{
+  *array_size = ARRAY_SIZE;
+  *free_bytes = PROGRAM_FREE_BYTES;
+}
+
+//*************************************************
+int8_t basicLoadSaved(void)
+{
+  initializeValiables();
+  programNew();
+  errorCode = ERROR_NONE;
+  lineNumber = 0;
+  if (progLoad() < 0 && errorCode == ERROR_NONE) {
+    errorCode = ERROR_PGEMPTY;
+  }
+  return (int8_t)errorCode;
+}
+
+//*************************************************
+// Native programs (CLI --aot): the variables live in the generated code,
+// the core provides the console, the waits and the error report
+uint32_t *basicNativeBegin(void)
+{
+  statementCount = 0;
+  programRun();
+  return &statementCount;
+}
+
+//*************************************************
+void basicNativePrint(int32_t val, uint8_t form, int16_t len)
+{
+  printString(int2str((nb_int_t)val, form, len));
+}
+
+//*************************************************
+void basicNativePutChar(char ch)
+{
+  printChar(ch);
+}
+
+//*************************************************
+int32_t basicNativeCall(uint8_t code, int32_t val, int8_t *error)
+{
+  errorCode = ERROR_NONE;
+  switch (code) {
+  case ST_INPUT :
+    if (inputString(false) > 0) {
+      val = str2val(inputBuff);
     }
+    break;
+  case ST_DELAY :
+    delayMs((nb_int_t)val);
+    break;
+  case ST_PAUSE :
+    while (checkBreakKey() == 0) {
+      bios_idle(IDLE_WAIT_MAX);
+    }
+    break;
+  case ST_RESET :
+    outputFlush();
+    bios_systemReset();
+    break;
+  case FUNC_INKEY :
+    val = inkey_func((nb_int_t)val);
+    break;
+  default :
+    errorCode = ERROR_SYNTAX;
+    break;
+  }
+  *error = (int8_t)errorCode;
+  return val;
+}
+
+//*************************************************
+int8_t basicNativeEnd(int8_t error, int16_t line)
+{
+  errorCode = (error_code_t)error;
+  lineNumber = line;
+  if (errorCode != ERROR_NONE) {
+    printError();
+  }
+  else {
+    programInit();
   }
+  outputFlush();
+  lineNumber = 0;
+  return (int8_t)errorCode;
 }
+#endif
 
 //*************************************************
 static void initializeValiables(void)
 {
   programInit();
   memset(globalVariables, 0, sizeof(globalVariables));
-  memset(arrayValiables , 0, sizeof(arrayValiables));
+  memset(arrayValiables , 0, ARRAY_SIZE * sizeof(nb_int_t));
 }
 
 //*************************************************
@@ -335,13 +1004,42 @@ static void programInit(void)
   resumePointer = NULL;
   resumeLineNumber = 0;
   dataReadPointer = 0;
+#if DATA_INDEX_NUM
+  dataReadIndex = 0;
+#endif
+#if EVENT_TIMER_NUM
+  eventClear();
+#endif
+#if CAPTURE_ENABLE
+  bios_captureStop();
+  captureTotal = 0;
+#endif
 }
 
 //*************************************************
 static void programNew(void)
 {
+#if !ROM_PROGRAM_ENABLE
   progLength = 0;
   *((uint8_t*)PROGRAM_AREA_TOP) = ST_EOL;
+  programIndexClear();
+#endif
+}
+
+//*************************************************
+static void programIndexClear(void)
+{
+#if LABEL_INDEX_NUM
+  labelIndexCount = 0;
+  labelIndexOver = false;
+#endif
+#if BLOCK_INDEX_NUM
+  blockIndexCount = 0;
+#endif
+#if DATA_INDEX_NUM
+  dataIndexCount = 0;
+  dataIndexOver = false;
+#endif
 }
 
 //*************************************************
@@ -353,7 +1051,7 @@ static void printError(void)
     }
     else{
       printNewline();
-      if (errorCode >= ERROR_UXNEXT) {
+      if (errorCode >= ERROR_UXNEXT && errorCode <= ERROR_UXREAD) {
         printStringFlash(F("Unexpected "));
       }
       if (errorCode > ERROR_CODE_MAX) errorCode = ERROR_SYNTAX;
@@ -386,11 +1084,11 @@ static void printInternalcode(void)
   uint8_t len, ch, *ptr;
 
   ptr = executionPointer;
-  len = *ptr;
+  len = CODE_BYTE(ptr);
   if (len > 0) {
     len++;
     while(len--) {
-      ch = *ptr++;
+      ch = CODE_BYTE(ptr++);
       printString(int2str(ch, FORM_HEX, -2));
       printChar(ASCII_SP);
     }
@@ -403,13 +1101,44 @@ static void printInternalcode(void)
 static void interpreterMain(void)
 {
   uint8_t ch;
+#if INTERP_DISPATCH == 0
   nb_int_t *pvar;
+#endif
+#if INTERP_DISPATCH == 2
+#define DISPATCH_LABEL(c) DISPATCH_SELECT(c, &&op_eol, &&op_nop, &&op_fast, \
+  &&op_array, &&op_variable, &&op_comment, &&op_statement, &&op_syntax)
+
+  static const void* const dispatchLabel[256] = {
+    DISPATCH_TABLE(DISPATCH_LABEL)
+  };
+
+  // Each handler ends by fetching and jumping to the next statement itself
+#define DISPATCH_NEXT() \
+  do { \
+    if (errorCode != ERROR_NONE) { printError(); return; } \
+    if (returnRequest) goto op_line; \
+    if (checkBreak() < 0) { printError(); return; } \
+    exprDepth = 0; \
+    EVENT_NEXT(); \
+    ch = CODE_BYTE(executionPointer++); \
+    goto *dispatchLabel[ch]; \
+  } while (0)
+#if EVENT_TIMER_NUM
+#define EVENT_NEXT() \
+  if (eventCount && eventService()) { \
+    if (errorCode != ERROR_NONE) { printError(); return; } \
+    goto op_line; \
+  }
+#else
+#define EVENT_NEXT()
+#endif
+#endif
 
   while(true) {
 #if CODE_DEBUG_ENABLE
     printInternalcode();
 #endif
-    ch = *executionPointer++;
+    ch = CODE_BYTE(executionPointer++);
     if (ch == ST_EOL || returnRequest == REQUEST_END) {
       if (lineNumber) {
         programInit();
@@ -417,21 +1146,68 @@ static void interpreterMain(void)
       return;
     }
     if (lineNumber) {
-      ch = *executionPointer;
+      ch = CODE_BYTE(executionPointer);
 	  if (ch >= '0' && ch <= '9') executionPointer++;
       else
       if (IS_ST_VAL_DEC(ch)) {
         executionPointer += GET_VAL_SIZE(ch) + 1;
       }
     }
+#if INTERP_DISPATCH == 2
+    returnRequest = 0;
+    DISPATCH_NEXT();
+
+op_eol:
+    if (lineNumber == 0) {
+      return;
+    }
+    lineNumber++;
+    continue;
+op_nop:
+    DISPATCH_NEXT();
+op_fast:
+    COUNT_STATEMENT();
+    dispatchFast();
+    DISPATCH_NEXT();
+op_array:
+    COUNT_STATEMENT();
+    dispatchArray();
+    DISPATCH_NEXT();
+op_variable:
+    COUNT_STATEMENT();
+    dispatchVariable();
+    DISPATCH_NEXT();
+op_comment:
+    COUNT_STATEMENT();
+    proc_comment();
+    DISPATCH_NEXT();
+op_statement:
+    COUNT_STATEMENT();
+    (*procCodeList[ch - STCODE_START])();
+    DISPATCH_NEXT();
+op_syntax:
+    errorCode = ERROR_SYNTAX;
+    DISPATCH_NEXT();
+op_line:
+    ;
+#else
     while(true) {
-      if (checkBreakKey() < 0) {
+      if (checkBreak() < 0) {
         printError();
         return;
       }
       exprDepth = 0;
       returnRequest = 0;
-      ch = *executionPointer++;
+#if EVENT_TIMER_NUM
+      if (eventCount && eventService()) {
+        if (errorCode != ERROR_NONE) {
+          printError();
+          return;
+        }
+        break;
+      }
+#endif
+      ch = CODE_BYTE(executionPointer++);
       if (ch == ST_EOL) {
         if (lineNumber == 0) {
           return;
@@ -439,14 +1215,27 @@ static void interpreterMain(void)
         lineNumber++;
         break;
       }
-      else
+#if HOST_API_ENABLE || PROFILE_LINE_NUM || STAT_ENABLE
+      if (ch != ' ' && ch != '\t' && ch != ':') COUNT_STATEMENT();
+#endif
+#if INTERP_DISPATCH == 1
+      ((PROC)pgm_read_ptr(&dispatchTable[ch]))();
+#else
       if (ch == ' ' || ch == '\t' || ch == ':') {
         /* nop */
       }
       else
-      if (ch == ST_ARRAY) {
-        pvar = getArrayReference();
-        if (pvar == NULL) {
+      if (ch == ST_FAST) {
+#if CODE_OPTIMIZE_ENABLE
+        proc_fast();
+#else
+        executionPointer += EXPR_HEADER_SIZE - 1 + CODE_BYTE(executionPointer);
+#endif
+      }
+      else
+      if (ch == ST_ARRAY) {
+        pvar = getArrayReference();
+        if (pvar == NULL) {
           printError();
           return;
         }
@@ -469,6 +1258,7 @@ static void interpreterMain(void)
       else {
         errorCode = ERROR_SYNTAX;
       }
+#endif
       if (errorCode != ERROR_NONE) {
         printError();
         return;
@@ -477,9 +1267,50 @@ static void interpreterMain(void)
         break;
       }
     }
+#endif
+  }
+}
+
+#if INTERP_DISPATCH
+//*************************************************
+static void dispatchFast(void)
+{
+#if CODE_OPTIMIZE_ENABLE
+  proc_fast();
+#else
+  executionPointer += EXPR_HEADER_SIZE - 1 + CODE_BYTE(executionPointer);
+#endif
+}
+
+//*************************************************
+static void dispatchArray(void)
+{
+  nb_int_t *pvar = getArrayReference();
+  if (pvar != NULL) {
+    proc_let(pvar);
   }
 }
 
+//*************************************************
+static void dispatchVariable(void)
+{
+  proc_let(&globalVariables[CODE_BYTE(executionPointer - 1) - 'A']);
+}
+#endif
+
+#if INTERP_DISPATCH == 1
+//*************************************************
+static void dispatchNop(void)
+{
+}
+
+//*************************************************
+static void dispatchSyntax(void)
+{
+  errorCode = ERROR_SYNTAX;
+}
+#endif
+
 //*************************************************
 #if REPL_EDIT_ENABLE
 #define CSI_SEQ     "\x1b["
@@ -489,10 +1320,17 @@ static void interpreterMain(void)
 #define CSI_SCP     CSI_SEQ "s"
 #define CSI_RCP     CSI_SEQ "u"
 
-#if REPL_HISTORY_ENABLE
-#define HISTOTY_BUFF_SIZE	INPUT_BUFF_SIZE
-static char historyBuff[HISTOTY_BUFF_SIZE] = "";
 #endif
+
+#if ARENA_HISTORY
+//*************************************************
+// Forget the history once the program has grown into it
+static void historyCheck(void)
+{
+  if (PROGRAM_AREA_FREE < HISTOTY_BUFF_SIZE) {
+    historyValid = false;
+  }
+}
 #endif
 	
 //*************************************************
@@ -567,7 +1405,10 @@ static uint8_t inputString(uint8_t history_flag)
   while (1)
   {
     int16_t c = inputChar();
-    if (c < 0) continue;
+    if (c < 0) {
+      bios_idle(IDLE_WAIT_MAX);
+      continue;
+    }
     uint8_t ch = (uint8_t)c;
     switch (ch)
     {
@@ -581,7 +1422,11 @@ static uint8_t inputString(uint8_t history_flag)
 #if REPL_EDIT_ENABLE
 #if REPL_HISTORY_ENABLE
 	    if (history_flag) {
-	      memcpy(historyBuff, inputBuff, sizeof(historyBuff));
+#if ARENA_HISTORY
+	      historyValid = (PROGRAM_AREA_FREE >= HISTOTY_BUFF_SIZE);
+	      if (historyValid)
+#endif
+	      memcpy(historyBuff, inputBuff, HISTOTY_BUFF_SIZE);
 	    }
 #endif
         printString(&inputBuff[pos]);
@@ -638,10 +1483,13 @@ static uint8_t inputString(uint8_t history_flag)
         esc_count = 0;
 #if REPL_HISTORY_ENABLE
         if (ch == 'A') {                // Up
+#if ARENA_HISTORY
+          if (!historyValid) break;
+#endif
           if (historyBuff[0] == '\0') break;
           while (pos) pos = inputStringLeft(inputBuff, pos);
           printString(CSI_ED);
-          memcpy(inputBuff, historyBuff, sizeof(historyBuff));
+          memcpy(inputBuff, historyBuff, HISTOTY_BUFF_SIZE);
           printString(inputBuff);
           pos = len = (uint8_t)strlen(inputBuff);
         }
@@ -754,6 +1602,25 @@ static void printVal(nb_int_t val)
   printString(int2str(val, 0, 0));
 }
 
+#if PROFILE_LINE_NUM || PROFILE_SAMPLE_NUM || STAT_ENABLE
+//*************************************************
+static void printCounter(uint32_t val, uint8_t width)
+{
+  char str[11], *s = &str[10];
+
+  *s = '\0';
+  do {
+    *--s = (val % 10) + '0';
+    val /= 10;
+  } while (val != 0);
+  while (&str[10] - s < width) {
+    printChar(ASCII_SP);
+    width--;
+  }
+  printString(s);
+}
+#endif
+
 //*************************************************
 static void printString(const char *str)
 {
@@ -779,6 +1646,57 @@ static void printNewline(void)
   printChar('\r');
 }
 
+#if OUTPUT_BUFF_SIZE
+//*************************************************
+static void outputChar(char ch)
+{
+  outputBuff[outputLen++] = ch;
+  if (ch == '\n' || outputLen >= OUTPUT_BUFF_SIZE) {
+    outputFlush();
+  }
+}
+
+//*************************************************
+static void outputFlush(void)
+{
+  uint8_t len = outputLen;
+
+  if (len == 0) return;
+  outputLen = 0;
+#if CONSOLE_TX_DROP
+  // While running, never wait for the serial line: keep what fits
+  if (lineNumber != 0) {
+    int16_t room = bios_consoleWritable();
+    if (room < len) {
+      if (room < 0) room = 0;
+      uint16_t dropped = outputDropped + (len - room);
+      outputDropped = (dropped > OUTPUT_DROPPED_MAX) ? OUTPUT_DROPPED_MAX : dropped;
+      len = (uint8_t)room;
+      if (len == 0) return;
+    }
+  }
+#endif
+  STAT_ADD(STAT_CONSOLE_OUT, len);
+  bios_consoleWrite(outputBuff, len);
+}
+
+#if CONSOLE_TX_DROP
+//*************************************************
+// At the end of a program: how many output bytes it dropped
+static void printDropped(void)
+{
+  if (outputDropped == 0) return;
+  outputFlush();
+  lineNumber = 0;     // the program has ended: this report is not dropped
+  printNewline();
+  printStringFlash(F("["));
+  printVal((nb_int_t)outputDropped);
+  printStringFlash(F(" bytes dropped]\r\n"));
+  outputDropped = 0;
+}
+#endif
+#endif
+
 //*************************************************
 static uint8_t convertInternalCode(uint8_t *dst, char *src)
 {
@@ -802,6 +1720,12 @@ static uint8_t convertInternalCode(uint8_t *dst, char *src)
         if (len <=1) len = 0;
         *dst++ = ST_EOL;
         *topptr = len;
+#if EXPR_COMPILE_ENABLE
+        if (len) len = exprCompileLine(topptr);
+#endif
+#if CODE_OPTIMIZE_ENABLE
+        if (len) len = codeOptimizeLine(topptr);
+#endif
         return len;
       }
       src++;
@@ -846,13 +1770,13 @@ static uint8_t convertInternalCode(uint8_t *dst, char *src)
         src++;
       }
       else{
-        uint8_t index = 0;
+        uint8_t index = pgm_read_byte(&keyWordFirst[ch - 'A']);
         while(true) {
-          PGM_P s1 = (PGM_P)pgm_read_ptr(&keyWordList[index]);
-          if (s1 == NULL) {
+          if (index == KEYWORD_NONE) {
             errorCode = ERROR_SYNTAX;
             return 0;
           }
+          PGM_P s1 = (PGM_P)pgm_read_ptr(&keyWordList[index]);
           char *s2 = src;
           while(true) {
             ch = toupper(*s2);
@@ -869,7 +1793,7 @@ static uint8_t convertInternalCode(uint8_t *dst, char *src)
             src = s2;
             break;
           }
-          index++;
+          index = pgm_read_byte(&keyWordNext[index]);
         }
       }
     }else
@@ -943,11 +1867,26 @@ static uint8_t *label2exeptr(nb_int_t val)
   uint8_t ch, *ptr;
   int16_t lnum;
 
+  STAT_ADD(STAT_LABEL_LOOKUPS, 1);
+#if LABEL_INDEX_NUM
+  uint8_t pos = labelIndexSearch(val);
+  if (pos < labelIndexCount && labelIndex[pos].label == val) {
+    ptr = (uint8_t*)PROGRAM_AREA_TOP + labelIndex[pos].offset;
+    executionPointer = ptr;
+    lineNumber = labelIndex[pos].line;
+    return get_dec_val(ptr + 1, &val);
+  }
+  if (!labelIndexOver) {
+    return NULL;
+  }
+#endif
+
   lnum = 1;
   ptr = (uint8_t*)PROGRAM_AREA_TOP;
   while(true) {
-    ch = *ptr++;
+    ch = CODE_BYTE(ptr++);
     if (ch == ST_EOL) {
+      STAT_ADD(STAT_LABEL_BYTES, ptr - (uint8_t*)PROGRAM_AREA_TOP);
       return NULL;
     }
 
@@ -955,13 +1894,14 @@ static uint8_t *label2exeptr(nb_int_t val)
     uint8_t* p = get_dec_val(ptr, &dec);
     if (p != NULL) {
       if (dec == val) {
+        STAT_ADD(STAT_LABEL_BYTES, p - (uint8_t*)PROGRAM_AREA_TOP);
         executionPointer = ptr - 1;
         lineNumber = lnum;
         return p;
       }
       ptr = p;
     }
-    while(*ptr != ST_EOL) {
+    while(CODE_BYTE(ptr) != ST_EOL) {
       ptr = get_next_ptr(ptr);
     }
     ptr++;
@@ -969,6 +1909,305 @@ static uint8_t *label2exeptr(nb_int_t val)
   }
 }
 
+#if LABEL_INDEX_NUM
+//*************************************************
+static uint8_t labelIndexSearch(nb_int_t val)
+{
+  uint8_t lo = 0;
+  uint8_t hi = labelIndexCount;
+
+  while (lo < hi) {
+    uint8_t mid = (lo + hi) >> 1;
+    if (labelIndex[mid].label < val) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+//*************************************************
+static void labelIndexAdd(nb_int_t val, uint8_t *ptr, int16_t lnum)
+{
+  uint8_t pos = labelIndexSearch(val);
+
+  if (pos < labelIndexCount && labelIndex[pos].label == val) {
+    return;     // duplicate label : the earliest one is used
+  }
+  if (labelIndexCount >= LABEL_INDEX_NUM) {
+    labelIndexOver = true;
+    return;
+  }
+  memmove(&labelIndex[pos + 1], &labelIndex[pos], (labelIndexCount - pos) * sizeof(label_index_t));
+  labelIndex[pos].label = val;
+  labelIndex[pos].offset = (uint16_t)(ptr - (uint8_t*)PROGRAM_AREA_TOP);
+  labelIndex[pos].line = lnum;
+  labelIndexCount++;
+}
+
+//*************************************************
+static void labelIndexBuild(void)
+{
+  uint8_t *ptr;
+  int16_t lnum;
+  nb_int_t val;
+
+  lnum = 1;
+  ptr = (uint8_t*)PROGRAM_AREA_TOP;
+  while (CODE_BYTE(ptr) != ST_EOL) {
+    if (get_dec_val(ptr + 1, &val) != NULL) {
+      labelIndexAdd(val, ptr, lnum);
+    }
+    ptr += CODE_BYTE(ptr) + 1;
+    lnum++;
+  }
+}
+#endif
+
+#if BLOCK_INDEX_NUM
+//*************************************************
+static void blockIndexAdd(uint8_t *ptr, uint8_t kind, int16_t lnum)
+{
+  uint8_t *target;
+
+  if (blockIndexCount >= BLOCK_INDEX_NUM) {
+    return;     // table full : the rest falls back to findST()
+  }
+  executionPointer = ptr;
+  lineNumber = lnum;
+  switch (kind) {
+  case BLOCK_IF :
+    target = findST(st_list_if, &lineNumber);
+    break;
+  case BLOCK_ENDIF :
+    target = findST(st_list_endif, &lineNumber);
+    break;
+  case BLOCK_LOOP :
+    target = findNextLoop(ptr, ST_LOOP);
+    break;
+  default :
+    target = findNextLoop(ptr, ST_NEXT);
+    break;
+  }
+  if (target == NULL) {
+    return;     // unmatched block : the error is reported at run time
+  }
+  block_index_t *bp = &blockIndex[blockIndexCount++];
+  bp->key = (uint16_t)(((ptr - (uint8_t*)PROGRAM_AREA_TOP) << 2) | kind);
+  bp->offset = (uint16_t)(target - (uint8_t*)PROGRAM_AREA_TOP);
+  bp->line = lineNumber;
+}
+
+//*************************************************
+static void blockIndexBuild(void)
+{
+  uint8_t ch, last_st, *top, *ptr;
+  int16_t lnum;
+  uint8_t *saveExecutionPointer = executionPointer;
+  int16_t saveLineNumber = lineNumber;
+
+  lnum = 1;
+  top = (uint8_t*)PROGRAM_AREA_TOP;
+  while (CODE_BYTE(top) != ST_EOL) {
+    ptr = top + 1;
+    last_st = 0;
+    while ((ch = CODE_BYTE(ptr++)) != ST_EOL) {
+      switch (ch) {
+      case ST_COMMENT :
+        ptr = top + CODE_BYTE(top);
+        break;
+      case ST_EXPR :
+      case ST_FAST :
+        ptr += EXPR_HEADER_SIZE - 1 + CODE_BYTE(ptr);
+        break;
+      case ST_STRING :
+        do {
+          ch = CODE_BYTE(ptr++);
+          if (ch == '\\') ptr++;
+        } while (ch != ST_STRING && ch != ST_EOL);
+        break;
+      case ST_IF :
+        blockIndexAdd(ptr, BLOCK_IF, lnum);
+        break;
+      case ST_ELSEIF :
+        blockIndexAdd(ptr, BLOCK_IF, lnum);
+        blockIndexAdd(ptr, BLOCK_ENDIF, lnum);
+        break;
+      case ST_ELSE :
+        blockIndexAdd(ptr, BLOCK_ENDIF, lnum);
+        break;
+      case ST_WHILE :
+        if (last_st != ST_LOOP) {
+          blockIndexAdd(ptr, BLOCK_LOOP, lnum);
+        }
+        break;
+      case ST_EXIT :
+        blockIndexAdd(ptr, BLOCK_LOOP, lnum);
+        blockIndexAdd(ptr, BLOCK_NEXT, lnum);
+        break;
+      case ST_CONTINUE :
+        blockIndexAdd(ptr, BLOCK_NEXT, lnum);
+        break;
+      default :
+        if (IS_ST_VAL(ch)) {
+          ptr += GET_VAL_SIZE(ch);
+        }
+      }
+      last_st = ch;
+    }
+    top = ptr;
+    lnum++;
+  }
+  executionPointer = saveExecutionPointer;
+  lineNumber = saveLineNumber;
+}
+
+//*************************************************
+static uint8_t *blockIndexFind(uint8_t *ptr, uint8_t kind)
+{
+  if (ptr < (uint8_t*)PROGRAM_AREA_TOP || ptr >= (uint8_t*)PROGRAM_AREA_TOP + PROGRAM_AREA_MAX) {
+    return NULL;    // REPL line in internalcodeBuff
+  }
+  uint16_t key = (uint16_t)(((ptr - (uint8_t*)PROGRAM_AREA_TOP) << 2) | kind);
+  uint8_t lo = 0;
+  uint8_t hi = blockIndexCount;
+
+  while (lo < hi) {
+    uint8_t mid = (lo + hi) >> 1;
+    if (blockIndex[mid].key < key) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  if (lo < blockIndexCount && blockIndex[lo].key == key) {
+    lineNumber = blockIndex[lo].line;
+    return (uint8_t*)PROGRAM_AREA_TOP + blockIndex[lo].offset;
+  }
+  return NULL;
+}
+#endif
+
+#if DATA_INDEX_NUM
+//*************************************************
+// Add the items of one DATA statement, returns the delimiter position
+static uint8_t *dataIndexAdd(uint8_t *ptr)
+{
+  uint8_t depth;
+
+  while (true) {
+    if (dataIndexCount >= DATA_INDEX_NUM) {
+      dataIndexOver = true;     // table full : READ falls back to findST()
+      return ptr;
+    }
+    dataIndex[dataIndexCount++] = (uint16_t)(ptr - (uint8_t*)PROGRAM_AREA_TOP);
+    depth = 0;
+    while (CODE_BYTE(ptr) != ST_EOL && (depth || (CODE_BYTE(ptr) != ',' && !isDelimiter(CODE_BYTE(ptr))))) {
+      if (CODE_BYTE(ptr) == '(' || CODE_BYTE(ptr) == '[') depth++;
+      else
+      if (CODE_BYTE(ptr) == ')' || CODE_BYTE(ptr) == ']') depth--;
+      ptr = get_next_ptr(ptr);
+    }
+    if (CODE_BYTE(ptr) != ',') return ptr;
+    ptr++;
+  }
+}
+
+//*************************************************
+static void dataIndexBuild(void)
+{
+  uint8_t ch, *top, *ptr;
+
+  top = (uint8_t*)PROGRAM_AREA_TOP;
+  while (CODE_BYTE(top) != ST_EOL && !dataIndexOver) {
+    ptr = top + 1;
+    while ((ch = CODE_BYTE(ptr++)) != ST_EOL) {
+      switch (ch) {
+      case ST_COMMENT :
+        ptr = top + CODE_BYTE(top);
+        break;
+      case ST_EXPR :
+      case ST_FAST :
+        ptr += EXPR_HEADER_SIZE - 1 + CODE_BYTE(ptr);
+        break;
+      case ST_STRING :
+        do {
+          ch = CODE_BYTE(ptr++);
+          if (ch == '\\') ptr++;
+        } while (ch != ST_STRING && ch != ST_EOL);
+        break;
+      case ST_DATA :
+        ptr = dataIndexAdd(ptr);
+        break;
+      default :
+        if (IS_ST_VAL(ch)) {
+          ptr += GET_VAL_SIZE(ch);
+        }
+      }
+    }
+    top = ptr;
+  }
+}
+
+//*************************************************
+// First DATA item at or after ptr
+static uint16_t dataIndexSearch(uint8_t *ptr)
+{
+  uint16_t offset = (uint16_t)(ptr - (uint8_t*)PROGRAM_AREA_TOP);
+  uint16_t lo = 0;
+  uint16_t hi = dataIndexCount;
+
+  while (lo < hi) {
+    uint16_t mid = (lo + hi) >> 1;
+    if (dataIndex[mid] < offset) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+#endif
+
+//*************************************************
+static uint8_t *findBlockST(uint8_t *top, uint8_t kind)
+{
+#if BLOCK_INDEX_NUM
+  uint8_t *ptr = blockIndexFind(top, kind);
+  if (ptr != NULL) return ptr;
+#endif
+  return findST((kind == BLOCK_IF) ? st_list_if : st_list_endif, &lineNumber);
+}
+
+//*************************************************
+static uint8_t *findBlockLoop(uint8_t *top, uint8_t ch)
+{
+#if BLOCK_INDEX_NUM
+  uint8_t *ptr = blockIndexFind(top, (ch == ST_LOOP) ? BLOCK_LOOP : BLOCK_NEXT);
+  if (ptr != NULL) return ptr;
+#endif
+  return findNextLoop(top, ch);
+}
+
+//*************************************************
+static void programIndexBuild(void)
+{
+  programIndexClear();
+#if LABEL_INDEX_NUM
+  labelIndexBuild();
+#endif
+#if BLOCK_INDEX_NUM
+  blockIndexBuild();
+#endif
+#if DATA_INDEX_NUM
+  dataIndexBuild();
+#endif
+}
+
 //*************************************************
 static uint8_t isDelimiter(uint8_t ch)
 {
@@ -984,7 +2223,7 @@ static uint8_t isDelimiter(uint8_t ch)
 static error_code_t checkDelimiter(void)
 {
   if (errorCode == ERROR_NONE) {
-    if (!isDelimiter(*executionPointer)) {
+    if (!isDelimiter(CODE_BYTE(executionPointer))) {
       errorCode = ERROR_SYNTAX;
     }
   }
@@ -995,7 +2234,7 @@ static error_code_t checkDelimiter(void)
 static error_code_t checkST(uint8_t ch)
 {
   if (errorCode == ERROR_NONE) {
-    if (*executionPointer != ch) {
+    if (CODE_BYTE(executionPointer) != ch) {
       errorCode = ERROR_SYNTAX;
     }
     executionPointer++;
@@ -1008,7 +2247,7 @@ static nb_int_t *getParameterPointer(void)
 {
   uint8_t ch;
 
-  ch = *executionPointer++;
+  ch = CODE_BYTE(executionPointer++);
   if (ch == ST_ARRAY) {
     return getArrayReference();
   }
@@ -1022,6 +2261,24 @@ static nb_int_t *getParameterPointer(void)
 
 //*************************************************
 static uint8_t *findST(const uint8_t *st_list, int16_t *lnum)
+{
+  uint8_t *ptr;
+
+#if PROFILE_SAMPLE_NUM
+  uint8_t ctx = bios_sampleContext;
+  bios_sampleContext = ctx | SAMPLE_CTX_FINDST;
+  ptr = findSTMain(st_list, lnum);
+  bios_sampleContext = ctx;
+#else
+  ptr = findSTMain(st_list, lnum);
+#endif
+  STAT_ADD(STAT_FIND_SCANS, 1);
+  if (ptr != NULL) STAT_ADD(STAT_FIND_BYTES, ptr - executionPointer);
+  return ptr;
+}
+
+//*************************************************
+static uint8_t *findSTMain(const uint8_t *st_list, int16_t *lnum)
 {
   uint8_t ch, count_if, *ptr;
   int16_t num;
@@ -1031,15 +2288,19 @@ static uint8_t *findST(const uint8_t *st_list, int16_t *lnum)
   num = *lnum;
   while (true) {
     while (true) {
-      ch = *ptr++;
+      ch = CODE_BYTE(ptr++);
       if (ch == ST_EOL) break;
       switch(ch) {
       case ST_COMMENT :
-        while (*ptr++ != ST_EOL);
+        while (CODE_BYTE(ptr) != ST_EOL) ptr++;
+        break;
+      case ST_EXPR :
+      case ST_FAST :
+        ptr += EXPR_HEADER_SIZE - 1 + CODE_BYTE(ptr);
         break;
       case ST_STRING :
         do {
-          ch = *ptr++;
+          ch = CODE_BYTE(ptr++);
           if (ch == '\\') ptr++;
         } while (ch != ST_STRING && ch != ST_EOL);
         break;
@@ -1070,7 +2331,7 @@ static uint8_t *findST(const uint8_t *st_list, int16_t *lnum)
       }
     }
     if (num == 0)  break;
-    if (*ptr++ == ST_EOL) break;
+    if (CODE_BYTE(ptr++) == ST_EOL) break;
     num++;
   }
   return NULL;
@@ -1088,26 +2349,27 @@ static uint8_t* findNextLoop(uint8_t* ptr, uint8_t ch)
   uint8_t count = 1;
   while (count) {
     executionPointer = ptr;
-    num = lineNumber;
-    ptr = findST(st_list, &num);
-    if (ptr == NULL)	return ptr;
-    ch = *(ptr - 1);
+    ptr = findST(st_list, &lineNumber);
+    if (ptr == NULL) {
+      lineNumber = num;
+      return ptr;
+    }
+    ch = CODE_BYTE(ptr - 1);
     if (*st_list == ch) {
-      if (ch == ST_LOOP && *ptr == ST_WHILE) ptr++;
+      if (ch == ST_LOOP && CODE_BYTE(ptr) == ST_WHILE) ptr++;
       count--;
     }
     else {
       count++;
     }
   }
-  lineNumber = num;
   return ptr;
 }
 
 //*************************************************
-static stack_t *pushStack(uint8_t st)
+static nb_stack_t *pushStack(uint8_t st)
 {
-  stack_t *prevsp;
+  nb_stack_t *prevsp;
 
   if (stackPointer >= STACK_NUM) {
     errorCode = ERROR_STACK;
@@ -1118,13 +2380,14 @@ static stack_t *pushStack(uint8_t st)
   prevsp->returnPointer = executionPointer;
   prevsp->returnLineNumber = lineNumber;
   stackPointer++;
+  STAT_MAX(STAT_STACK_MAX, stackPointer);
   return prevsp;
 }
 
 //*************************************************
-static stack_t *popStack(uint8_t st)
+static nb_stack_t *popStack(uint8_t st)
 {
-  stack_t *prevsp;
+  nb_stack_t *prevsp;
 
   if (stackPointer == 0) {
     return NULL;
@@ -1137,6 +2400,30 @@ static stack_t *popStack(uint8_t st)
   return prevsp;
 }
 
+//*************************************************
+static int16_t inputChar(void)
+{
+  if (bios_breakFlag) {
+    bios_breakFlag = 0;
+    return CHR_BREAK;
+  }
+  outputFlush();
+  int16_t ch = bios_consoleGetChar();
+  if (ch >= 0) STAT_ADD(STAT_CONSOLE_IN, 1);
+  return ch;
+}
+
+//*************************************************
+static int16_t checkBreak(void)
+{
+  if (bios_breakFlag) {
+    bios_breakFlag = 0;
+    executeBreak();
+    return -1;
+  }
+  return 0;
+}
+
 //*************************************************
 static int16_t checkBreakKey(void)
 {
@@ -1159,7 +2446,7 @@ static char *get_StringPara_Form(uint8_t fm)
   if (checkST('(')) return NULL;
   val = expr();
   if (errorCode) return NULL;
-  if (*executionPointer == ',')
+  if (CODE_BYTE(executionPointer) == ',')
   {
     executionPointer++;
     len = (int16_t)expr();
@@ -1169,19 +2456,48 @@ static char *get_StringPara_Form(uint8_t fm)
 }
 
 //*************************************************
-static uint8_t *print_escaped(uint8_t* s)
+// RAW(value[,bytes]) : 1, 2 or 4 bytes little-endian, without any conversion
+static void print_raw(void)
+{
+  int16_t len = sizeof(nb_int_t);
+  nb_int_t val;
+  uint32_t v;
+
+  if (checkST('(')) return;
+  val = expr();
+  if (errorCode) return;
+  if (CODE_BYTE(executionPointer) == ',')
+  {
+    executionPointer++;
+    len = (int16_t)expr();
+    if (errorCode) return;
+  }
+  if (checkST(')')) return;
+  if (len != 1 && len != 2 && len != 4) {
+    errorCode = ERROR_PARA;
+    return;
+  }
+  v = (uint32_t)(int32_t)val;     // sign extended for 4 bytes
+  while (len--) {
+    printChar((uint8_t)v);
+    v >>= 8;
+  }
+}
+
+//*************************************************
+static uint8_t *print_escaped(uint8_t* s)
 {
   uint8_t val;
   uint8_t count;
 
-  while (*s) {
-    if (*s == ST_STRING) {
+  while (CODE_BYTE(s)) {
+    if (CODE_BYTE(s) == ST_STRING) {
       s++;
       break;
     }
-    if (*s == '\\') {
+    if (CODE_BYTE(s) == '\\') {
       s++;
-      switch (*s) {
+      switch (CODE_BYTE(s)) {
       case 'a':  printChar('\a'); break;
       case 'b':  printChar('\b'); break;
       case 'f':  printChar('\f'); break;
@@ -1199,7 +2515,7 @@ static uint8_t *print_escaped(uint8_t* s)
         val = 0;
         count = 0;
         while(count < 2) {
-          uint8_t ch = hex2byte(*s);
+          uint8_t ch = hex2byte(CODE_BYTE(s));
           if (ch > 0x0f) break;
           val = (val << 4) + ch;
           s++;
@@ -1209,16 +2525,16 @@ static uint8_t *print_escaped(uint8_t* s)
         s--;
         break;
       default:
-        if (*s < '0' || *s > '7') {
-          if (*s) printChar(*s); // Unknown
+        if (CODE_BYTE(s) < '0' || CODE_BYTE(s) > '7') {
+          if (CODE_BYTE(s)) printChar(CODE_BYTE(s)); // Unknown
           break;
         }
         // oct escape: \OOO
         val = 0;
         count = 0;
         while (count < 3) {
-          if (*s < '0' || *s > '7') break;
-          val = (val << 3) + (*s - '0');
+          if (CODE_BYTE(s) < '0' || CODE_BYTE(s) > '7') break;
+          val = (val << 3) + (CODE_BYTE(s) - '0');
           s++;
           count++;
         }
@@ -1228,7 +2544,7 @@ static uint8_t *print_escaped(uint8_t* s)
       }
     }
     else {
-      printChar(*s);
+      printChar(CODE_BYTE(s));
     }
     s++;
   }
@@ -1245,13 +2561,13 @@ static void proc_print(void)
   uint8_t exp_flag = false;
   uint8_t lastChar = 0;
   while(true) {
-    if (isDelimiter(*executionPointer)) {
+    if (isDelimiter(CODE_BYTE(executionPointer))) {
       if (lastChar != ';' && lastChar != ',') {
         printNewline();
       }
       return;
     }
-    lastChar = ch = *executionPointer++;
+    lastChar = ch = CODE_BYTE(executionPointer++);
     switch (ch) {
     case ST_STRING :
       executionPointer = print_escaped(executionPointer);
@@ -1279,13 +2595,21 @@ static void proc_print(void)
 
     case FUNC_HEX: 
       p = get_StringPara_Form(FORM_HEX);
-      if (!errorCode) printString(p);
+      if (errorCode != ERROR_NONE) return;
+      printString(p);
       exp_flag = false;
       break;
 
     case FUNC_DEC:
       p = get_StringPara_Form(FORM_DEC);
-      if (!errorCode) printString(p);
+      if (errorCode != ERROR_NONE) return;
+      printString(p);
+      exp_flag = false;
+      break;
+
+    case FUNC_RAW:
+      print_raw();
+      if (errorCode != ERROR_NONE) return;
       exp_flag = false;
       break;
 
@@ -1377,7 +2701,7 @@ static void proc_goto(void)
 //*************************************************
 static void proc_gosub(void)
 {
-  stack_t *prevsp;
+  nb_stack_t *prevsp;
 
   prevsp = pushStack(ST_GOSUB);
   if (prevsp == NULL)  return;
@@ -1390,7 +2714,7 @@ static void proc_gosub(void)
 //*************************************************
 static void proc_return(void)
 {
-  stack_t *prevsp;
+  nb_stack_t *prevsp;
   prevsp = &stacks[stackPointer];
 
   if (checkDelimiter())  return;
@@ -1412,7 +2736,7 @@ static void proc_for(void)
 {
   uint8_t ch;
   nb_int_t from, to, step, *pvar;
-  stack_t *prevsp;
+  nb_stack_t *prevsp;
 
   pvar = getParameterPointer();
   if (pvar == NULL)  return;
@@ -1421,7 +2745,7 @@ static void proc_for(void)
   if (checkST(ST_TO)) return;
   to = expr();
   if (errorCode != ERROR_NONE) return;
-  ch = *executionPointer++;
+  ch = CODE_BYTE(executionPointer++);
   if (ch == ST_STEP) {
     step = expr();
     if (errorCode != ERROR_NONE) return;
@@ -1441,7 +2765,7 @@ static void proc_for(void)
 //*************************************************
 static void proc_next(void)
 {
-  stack_t *prevsp;
+  nb_stack_t *prevsp;
 
   if (checkDelimiter()) return;
   prevsp = popStack(ST_FOR);
@@ -1471,7 +2795,7 @@ static void proc_next(void)
 //*************************************************
 static void proc_do(void)
 {
-  stack_t *prevsp;
+  nb_stack_t *prevsp;
 
   if (checkDelimiter()) return;
   prevsp = pushStack(ST_DO);
@@ -1483,7 +2807,7 @@ static void proc_do(void)
 static void proc_loop(void)
 {
   nb_int_t val;
-  stack_t *prevsp;
+  nb_stack_t *prevsp;
 
   prevsp = popStack(ST_DO);
   if (prevsp == NULL) {
@@ -1491,7 +2815,7 @@ static void proc_loop(void)
     return;
   }
 
-  if (*executionPointer == ST_WHILE) {
+  if (CODE_BYTE(executionPointer) == ST_WHILE) {
     executionPointer++;
     val = expr();
     if (checkDelimiter()) return;
@@ -1506,7 +2830,7 @@ static void proc_loop(void)
 //*************************************************
 static uint8_t* skipToDelimiter(uint8_t* ptr)
 {
-  while (!isDelimiter(*ptr)) ptr++;
+  while (!isDelimiter(CODE_BYTE(ptr))) ptr = get_next_ptr(ptr);
   return ptr;
 }
 
@@ -1514,7 +2838,7 @@ static uint8_t* skipToDelimiter(uint8_t* ptr)
 static void proc_while(void)
 {
   nb_int_t val;
-  stack_t *prevsp;
+  nb_stack_t *prevsp;
   uint8_t *ptr;
 
   ptr = executionPointer;
@@ -1526,7 +2850,7 @@ static void proc_while(void)
     prevsp->returnPointer = ptr - 1;
   }
   else {
-    ptr = findNextLoop(ptr, ST_LOOP);
+    ptr = findBlockLoop(ptr, ST_LOOP);
     if (ptr == NULL) {
       errorCode = ERROR_NOLOOP;
       return;
@@ -1541,14 +2865,14 @@ static void proc_exit(void)
   uint8_t* ptr = NULL;
   if (checkDelimiter()) return;
   if (stackPointer) {
-    stack_t* prevsp = &stacks[stackPointer - 1];
+    nb_stack_t* prevsp = &stacks[stackPointer - 1];
 
     if (prevsp->type == ST_DO) {
-      ptr = findNextLoop(executionPointer, ST_LOOP);
+      ptr = findBlockLoop(executionPointer, ST_LOOP);
     }
     else
     if (prevsp->type == ST_FOR) {
-      ptr = findNextLoop(executionPointer, ST_NEXT);
+      ptr = findBlockLoop(executionPointer, ST_NEXT);
     }
   }
   if (ptr) {
@@ -1565,7 +2889,7 @@ static void proc_continue(void)
   uint8_t* ptr = NULL;
   if (checkDelimiter()) return;
   if (stackPointer) {
-    stack_t* prevsp = &stacks[stackPointer - 1];
+    nb_stack_t* prevsp = &stacks[stackPointer - 1];
 
     if (prevsp->type == ST_DO) {
     	stackPointer--;
@@ -1575,9 +2899,12 @@ static void proc_continue(void)
     }
     else
     if (prevsp->type == ST_FOR) {
-      ptr = findNextLoop(executionPointer, ST_NEXT);
+      ptr = findBlockLoop(executionPointer, ST_NEXT);
+      if (ptr) {
+        executionPointer = ptr - 1;   // execute the matching NEXT
+        return;
+      }
     }
-    if (ptr) return;
   }
   errorCode = ERROR_UXCONTINUE;
 }
@@ -1585,30 +2912,30 @@ static void proc_continue(void)
 //*************************************************
 static void proc_if (void)
 {
-  static const uint8_t st_list[] = { ST_ENDIF, ST_ELSE, ST_ELSEIF, 0 };
   nb_int_t val;
-  uint8_t ch, *ptr;
+  uint8_t ch, *ptr, *top;
 
   do{
+    top = executionPointer;
     val = expr();
     if (checkST(ST_THEN)) return;
     if (val) {
-      if (IS_VAL(*executionPointer)) {
+      if (IS_VAL(CODE_BYTE(executionPointer))) {
         proc_goto();
       }
       return;
     }
-    ptr = findST(st_list, &lineNumber);
+    ptr = findBlockST(top, BLOCK_IF);
     if (ptr == NULL) {
       errorCode = ERROR_NOENDIF;
       return;
     }
     executionPointer = ptr;
-    ch =  *(executionPointer - 1);
+    ch =  CODE_BYTE(executionPointer - 1);
   }while(ch == ST_ELSEIF);
 
   if (ch == ST_ELSE) {
-    if (IS_VAL(*executionPointer)) {
+    if (IS_VAL(CODE_BYTE(executionPointer))) {
       proc_goto();
     }
   }
@@ -1617,10 +2944,9 @@ static void proc_if (void)
 //*************************************************
 static void proc_else(void)
 {
-  static const uint8_t st_list[] = { ST_ENDIF, 0 };
   uint8_t *ptr;
 
-  ptr = findST(st_list, &lineNumber);
+  ptr = findBlockST(executionPointer, BLOCK_ENDIF);
   if (ptr == NULL) {
     errorCode = ERROR_NOENDIF;
     return;
@@ -1645,6 +2971,18 @@ static void proc_endif (void)
 static void programRun(void)
 {
   initializeValiables();
+#if PROFILE_LINE_NUM
+  profileClear();
+#endif
+#if PROFILE_SAMPLE_NUM
+  sampleClear();
+#endif
+#if STAT_ENABLE
+  statClear();
+#endif
+#if OUTPUT_BUFF_SIZE && CONSOLE_TX_DROP
+  outputDropped = 0;
+#endif
   errorCode = ERROR_NONE;
   lineNumber = 1;
   executionPointer = (uint8_t*)PROGRAM_AREA_TOP;
@@ -1689,6 +3027,10 @@ static void proc_end(void)
 static void proc_new(void)
 {
   if (checkDelimiter()) return;
+#if ROM_PROGRAM_ENABLE
+  errorCode = ERROR_PGROM;
+  return;
+#endif
   initializeValiables();
   programNew();
 }
@@ -1698,16 +3040,22 @@ static void proc_list(void)
 {
   nb_int_t val;
   uint8_t flag, ch, *ptr;
+  uint8_t operand;    // last output was a value or name (space before a statement keyword)
 
   if (checkDelimiter()) return;
   ptr = (uint8_t*)PROGRAM_AREA_TOP;
-  while(*ptr++ != ST_EOL) {
+  while(CODE_BYTE(ptr++) != ST_EOL) {
     flag = true;
+    operand = false;
     while(true) {
-      ch = *ptr;
+      ch = CODE_BYTE(ptr);
+      if (ch == ST_EXPR || ch == ST_FAST) {
+        ptr += EXPR_HEADER_SIZE + CODE_BYTE(ptr + 1);
+        continue;
+      }
       uint8_t *p = get_dec_val(ptr, &val);
       if (p != NULL) {
-        if (ch & VAL_BASE_HEX) {
+        if (IS_ST_VAL(ch) && (ch & VAL_BASE_HEX)) {
           printString("0x");
           printString(int2str(val, FORM_HEX, 0));
         }
@@ -1717,6 +3065,7 @@ static void proc_list(void)
             printChar(ASCII_SP);
           }
         }
+        operand = !flag;
         ptr = p;
         continue;
       }
@@ -1729,25 +3078,26 @@ static void proc_list(void)
       if (ch == ST_STRING) {
         printChar(ch);
         do{
-          ch = *ptr++;
+          ch = CODE_BYTE(ptr++);
           printChar(ch);
           if (ch == '\\') {
-            printChar(*ptr++);
+            printChar(CODE_BYTE(ptr++));
           }
         }while(ch != ST_STRING);
       }
       else
       if (ch == ST_COMMENT) {
         printChar(ch);
-        while (*ptr != ST_EOL) {
-          printChar(*ptr++);
+        while (CODE_BYTE(ptr) != ST_EOL) {
+          printChar(CODE_BYTE(ptr++));
         }
       }
       else
       if (ch >= TOKEN_START) {
-        if (!flag && (ch >= STSP_START && ch <= STSP_END)) {
+        if (!flag && ((ch >= STSP_START && ch <= STSP_END) || (ch < STSP_START && operand))) {
           printChar(ASCII_SP);
         }
+        operand = false;
         PGM_P p = (PGM_P)pgm_read_ptr(&keyWordList[ch-TOKEN_START]);
         char c;
         while ((c = pgm_read_byte(p++)) != 0) {
@@ -1758,11 +3108,12 @@ static void proc_list(void)
 #endif
           printChar(c);
         }
-        if (ch <= STSP_END && !isDelimiter(*ptr)) {
+        if (ch <= STSP_END && !isDelimiter(CODE_BYTE(ptr)) && !((ch == ST_SAMPLE || ch == ST_STAT) && CODE_BYTE(ptr) == '(')) {
           printChar(ASCII_SP);
         }
       }
       else {
+        operand = isalnum(ch) || ch == ')' || ch == ']';
 #if LIST_STYLE != 0
         ch = tolower(ch);
 #endif
@@ -1781,15 +3132,17 @@ static void proc_list(void)
 //*************************************************
 static void proc_prog(void)
 {
-  uint8_t len, *ptr, *src;
-  uint16_t  remain;
+  uint8_t *ptr;
 
   if (checkDelimiter()) return;
   if (lineNumber) {
     errorCode = ERROR_NOTINRUN;
     return;
   }
-  remain = PROGRAM_AREA_SIZE - 3;
+#if ROM_PROGRAM_ENABLE
+  errorCode = ERROR_PGROM;
+  return;
+#endif
   progLength = 0;
   ptr = (uint8_t*)PROGRAM_AREA_TOP;
   while(true) {
@@ -1800,33 +3153,50 @@ static void proc_prog(void)
 	      returnRequest = REQUEST_END;
 	      break;
 	    }
-	    len = convertInternalCode(internalcodeBuff, inputBuff);
-	    if (remain < len) {
-	      errorCode = ERROR_PGOVER;
-	    }
+	    ptr = programStoreLine(ptr);
 	    if (errorCode != ERROR_NONE) {
 	      printError();
-	    }
-	    else
-	    if (len > 0) {
-	      len++;
-	      progLength += len;
-	      remain -= len;
-	      src = internalcodeBuff;
-	      while(len-- > 0) {
-	        *ptr++ = *src++;
-	      }
 	    }
 		}
   }
+  programStoreEnd(ptr);
+}
+
+//*************************************************
+static uint8_t *programStoreLine(uint8_t *ptr)
+{
+  uint8_t len, *src;
+
+  len = convertInternalCode(internalcodeBuff, inputBuff);
+  if (PROGRAM_AREA_FREE < len) {
+    errorCode = ERROR_PGOVER;
+  }
+  if (errorCode == ERROR_NONE && len > 0) {
+    len++;
+    progLength += len;
+    src = internalcodeBuff;
+    while(len-- > 0) {
+      *ptr++ = *src++;
+    }
+#if ARENA_HISTORY
+    historyCheck();
+#endif
+  }
+  return ptr;
+}
+
+//*************************************************
+static void programStoreEnd(uint8_t *ptr)
+{
   *ptr++ = ST_EOL;
   if (progLength > 1) progLength++;
+  programIndexBuild();
 }
 
 //*************************************************
 static void proc_save(void)
 {
-  uint8_t flag = *executionPointer;
+  uint8_t flag = CODE_BYTE(executionPointer);
   if (flag == '0' || flag == '!') {
     executionPointer++;
   }
@@ -1835,235 +3205,713 @@ static void proc_save(void)
     errorCode = ERROR_NOTINRUN;
     return;
   }
+#if ROM_PROGRAM_ENABLE
+  errorCode = ERROR_PGROM;
+  return;
+#endif
 
   if (flag == '0') {
-    bios_eepEraseBlock(EEP_HEADER_ADDR, EEP_HEADER_SIZE + PROGRAM_AREA_SIZE);
+    bios_eepEraseBlock(EEP_HEADER_ADDR, EEP_HEADER_SIZE + PROGRAM_AREA_MAX);
+    STAT_ADD(STAT_EEP_WRITE, EEP_HEADER_SIZE + PROGRAM_AREA_MAX);
     return;
   }
 
   uint8_t *ptr = (uint8_t*)PROGRAM_AREA_TOP;
-  if (*ptr == ST_EOL) {
+  if (CODE_BYTE(ptr) == ST_EOL) {
     errorCode = ERROR_PGEMPTY;
     return;
   }
 
+  progSave(flag == '!');
+}
+
+//*************************************************
+// Writes the program area to EEPROM, compressed when that is smaller
+static void progSave(uint8_t autorun)
+{
   EEP_Header_t eep;
-  eep.magic1 = EEP_MAGIC_1;
-  eep.magic2 = EEP_MAGIC_2;
-  eep.verMajor = VERSION_MAJOR;
-  eep.verMinor = VERSION_MINOR;
-  eep.progLength = progLength;
-  eep.autoRun = (flag == '!');
-  eep.reserved = 0x00;
+  int16_t len = -1;
 
+  progHeaderSet(&eep, autorun);
+#if SAVE_COMPRESS_ENABLE
+  len = progCompress((uint16_t)progLength - 1);
+  if (len > 0) eep.format |= EEP_FORMAT_LZ;
+#endif
+  if (len < 0) {
+    len = progLength;
+    if (EEP_HEADER_SIZE + len > EEPROM_SIZE) {
+      errorCode = ERROR_PGOVER;
+      return;
+    }
+    bios_eepWriteBlock(EEP_PROGRAM_ADDR, PROGRAM_AREA_TOP, (uint16_t)len);
+  }
   bios_eepWriteBlock(EEP_HEADER_ADDR, (uint8_t*)&eep, EEP_HEADER_SIZE);
-  bios_eepWriteBlock(EEP_PROGRAM_ADDR, ptr,  (uint16_t)progLength);
+  STAT_ADD(STAT_EEP_WRITE, EEP_HEADER_SIZE + len);
 }
 
 //*************************************************
 static int8_t progLoad(void)
 {
+#if ROM_PROGRAM_ENABLE
+  // executed in place: only the indexes are built in RAM
+  progLength = PROGRAM_AREA_LEN;
+  programIndexBuild();
+  return ROM_PROGRAM_AUTORUN;
+#else
   EEP_Header_t eep;
   bios_eepReadBlock(EEP_HEADER_ADDR, (uint8_t*)&eep, EEP_HEADER_SIZE);
-  if (eep.magic1 != EEP_MAGIC_1 || eep.magic2 != EEP_MAGIC_2) {
-     errorCode = ERROR_PGEMPTY;
-    return -1;
+  STAT_ADD(STAT_EEP_READ, EEP_HEADER_SIZE);
+  if (progHeaderCheck(&eep)) return -1;
+  progLength = eep.length;
+#if SAVE_COMPRESS_ENABLE
+  if (eep.format & EEP_FORMAT_LZ) {
+    if (progExpand()) progLength = 0;
   }
-  if (eep.progLength < 2) {
-     errorCode = ERROR_PGEMPTY;
-    return -1;
+  else
+#endif
+  {
+    bios_eepReadBlock(EEP_PROGRAM_ADDR, PROGRAM_AREA_TOP, (uint16_t)progLength);
+    STAT_ADD(STAT_EEP_READ, progLength);
   }
-  if (eep.progLength > PROGRAM_AREA_SIZE) {
-    errorCode = ERROR_PGOVER;
+  if (progLength == 0 || !progChainCheck()) {
+    programNew();
+    errorCode = ERROR_PGEMPTY;
     return -1;
   }
-  progLength = eep.progLength;
-  bios_eepReadBlock(EEP_PROGRAM_ADDR, PROGRAM_AREA_TOP, (uint16_t)progLength);
+#if ARENA_HISTORY
+  historyCheck();
+#endif
+  programIndexBuild();
   return eep.autoRun;
+#endif
 }
 
 //*************************************************
 static void proc_load(void)
 {
+#if UPLOAD_ENABLE
+  uint8_t flag = CODE_BYTE(executionPointer);
+  if (flag == '!') {
+    executionPointer++;
+  }
+#endif
   if (checkDelimiter()) return;
   if (lineNumber) {
     errorCode = ERROR_NOTINRUN;
     return;
   }
+#if ROM_PROGRAM_ENABLE
+  errorCode = ERROR_PGROM;
+  return;
+#endif
+#if UPLOAD_ENABLE
+  if (flag == '!') {
+    progUpload();
+    return;
+  }
+#endif
   progLoad();
 }
 
 //*************************************************
-static void proc_comment(void)
+static int8_t progHeaderCheck(const EEP_Header_t *eep)
 {
-  while(*executionPointer != ST_EOL) {
-    executionPointer++;
+  if (eep->magic1 != EEP_MAGIC_1 || eep->magic2 != EEP_MAGIC_2) {
+     errorCode = ERROR_PGEMPTY;
+    return -1;
+  }
+  uint8_t format = eep->format;
+#if SAVE_COMPRESS_ENABLE
+  format &= ~EEP_FORMAT_LZ;
+#endif
+  if (eep->verMajor != VERSION_MAJOR || eep->verMinor != VERSION_MINOR ||
+      format != EEP_FORMAT_BUILD) {
+    errorCode = ERROR_PGVER;
+    return -1;
+  }
+  if (eep->length < 2) {
+     errorCode = ERROR_PGEMPTY;
+    return -1;
+  }
+  if (eep->length > PROGRAM_AREA_MAX) {
+    errorCode = ERROR_PGOVER;
+    return -1;
   }
+#if RAM_ARENA_SIZE
+  if (eep->length > PROGRAM_AREA_LEN) {
+    // make room by shrinking @array
+    arraySetSize((RAM_ARENA_SIZE - eep->length) / sizeof(nb_int_t));
+  }
+#endif
+  return 0;
 }
 
 //*************************************************
-static uint8_t get_arg2(nb_int_t *val_1, nb_int_t *val_2)
+static void progHeaderSet(EEP_Header_t *eep, uint8_t autorun)
 {
-  *val_1 = expr();
-  if (!checkST(',')) {
-    *val_2 = expr();
-    checkDelimiter();
-  }
-  return errorCode;
+  eep->magic1 = EEP_MAGIC_1;
+  eep->magic2 = EEP_MAGIC_2;
+  eep->verMajor = VERSION_MAJOR;
+  eep->verMinor = VERSION_MINOR;
+  eep->length = progLength;
+  eep->autoRun = autorun;
+  eep->format = EEP_FORMAT_BUILD;
 }
 
 //*************************************************
-static void proc_outp(void)
+// The lines of the program area must chain up to the end mark
+static uint8_t progChainCheck(void)
 {
-  nb_int_t val_1, val_2;
+  uint8_t *ptr = PROGRAM_AREA_TOP;
+  uint8_t *end = ptr + progLength - 1;
+  while (ptr < end) ptr += *ptr + 1;
+  return (ptr == end && *end == ST_EOL);
+}
 
-  if (get_arg2( &val_1, &val_2) == ERROR_NONE) {
-    if (bios_writeGpio(val_1, val_2)) {
-      errorCode = ERROR_PARA;
+#if SAVE_COMPRESS_ENABLE
+//*************************************************
+// Compresses the program area into EEPROM (see nano_basic_defs.h)
+// Matches are searched in the program area itself, so no buffer is needed.
+// Returns the stored length, or -1 if it would exceed 'limit' bytes.
+static int16_t progCompress(uint16_t limit)
+{
+  const uint8_t *src = PROGRAM_AREA_TOP;
+  uint16_t len = progLength, pos = 0, out = 0;
+  uint8_t lit = 0;
+
+  if (limit > EEPROM_SIZE - EEP_HEADER_SIZE) limit = EEPROM_SIZE - EEP_HEADER_SIZE;
+  while (pos < len || lit) {
+    uint8_t best = 0, dist = 0;
+    uint16_t i = (pos > LZ_WINDOW) ? pos - LZ_WINDOW : 0;
+    for (; i < pos && best < LZ_MATCH_MAX; i++) {
+      uint8_t n = 0;
+      while (pos + n < len && n < LZ_MATCH_MAX && src[i + n] == src[pos + n]) n++;
+      if (n > best) {
+        best = n;
+        dist = (uint8_t)(pos - i - 1);
+      }
+    }
+    if (best < LZ_MATCH_MIN && pos < len) {
+      pos++;
+      if (++lit < LZ_LITERAL_MAX) continue;
+    }
+    if (lit) {
+      // literal run: the bytes are copied straight from the program area
+      uint8_t code = lit - 1;
+      if (out + 1 + lit > limit) return -1;
+      bios_eepWriteBlock(EEP_PROGRAM_ADDR + out, &code, 1);
+      bios_eepWriteBlock(EEP_PROGRAM_ADDR + out + 1, src + pos - lit, lit);
+      out += 1 + lit;
+      lit = 0;
+    }
+    if (best >= LZ_MATCH_MIN) {
+      uint8_t code[2] = { (uint8_t)(0x80 | (best - LZ_MATCH_MIN)), dist };
+      if (out + 2 > limit) return -1;
+      bios_eepWriteBlock(EEP_PROGRAM_ADDR + out, code, 2);
+      out += 2;
+      pos += best;
     }
   }
+  return (int16_t)out;
 }
 
+#if !ROM_PROGRAM_ENABLE
 //*************************************************
-static error_code_t delayMs(nb_int_t val)
+// Expands a compressed program from EEPROM into the program area
+// The output is its own dictionary, so no buffer is needed.
+static int8_t progExpand(void)
 {
-  nb_int_t waitStart = bios_getSystemTick();
-
-  while(checkBreakKey() >= 0) {
-    nb_int_t elapsed = bios_getSystemTick() - waitStart;
-    if (elapsed > val) break;
+  uint8_t *dst = PROGRAM_AREA_TOP;
+  uint8_t *end = dst + progLength;
+  uint16_t addr = EEP_PROGRAM_ADDR;
+
+  while (dst < end) {
+    uint8_t code[2];
+    bios_eepReadBlock(addr++, code, 1);
+    if (code[0] < 0x80) {
+      uint8_t n = code[0] + 1;
+      if (n > end - dst) return -1;
+      bios_eepReadBlock(addr, dst, n);
+      addr += n;
+      dst += n;
+    }
+    else {
+      bios_eepReadBlock(addr++, &code[1], 1);
+      uint8_t n = (code[0] & 0x7f) + LZ_MATCH_MIN;
+      const uint8_t *from = dst - code[1] - 1;
+      if (from < PROGRAM_AREA_TOP || n > end - dst) return -1;
+      while (n--) *dst++ = *from++;
+    }
   }
-  return errorCode;
+  STAT_ADD(STAT_EEP_READ, addr - EEP_PROGRAM_ADDR);
+  return 0;
 }
+#endif
+#endif
 
+#if UPLOAD_ENABLE
 //*************************************************
-static void proc_delay(void)
+// LOAD ! : receive a program image (see nano_basic_defs.h)
+// Records must arrive in order, the first one carrying the header only.
+// Each record is answered with ACK, or NAK when it has to be sent again.
+// The image goes straight to the program area and then to EEPROM,
+// the final ACK is sent once the EEPROM is written.
+static void progUpload(void)
 {
-  nb_int_t val;
+  EEP_Header_t eep;
+  uint16_t received = 0;               // image bytes accepted so far
+  uint16_t length = EEP_HEADER_SIZE;   // image length, known once the header is in
+  uint8_t done = false;
 
-  val = expr();
-  if (checkDelimiter()) return;
-  delayMs(val);
+  programNew();
+  outputFlush();
+  uploadReply(CHR_UPLOAD_ACK);
+  while (errorCode == ERROR_NONE) {
+    int16_t val = uploadGetChar();
+    if (val < 0) break;
+    if (val != CHR_UPLOAD_MARK) continue;
+
+    uint8_t sum = 0, head[3] = { 0, 0, 0 }, pos;
+    for (pos = 0; pos < 3 && (val = uploadGetByte(&sum)) >= 0; pos++) {
+      head[pos] = (uint8_t)val;
+    }
+    uint8_t len = head[0];
+    uint16_t offset = ((uint16_t)head[1] << 8) | head[2];
+    uint8_t store = (offset == received && offset + len <= length);
+    for (pos = 0; val >= 0; pos++) {
+      val = uploadGetByte(&sum);         // data, then the checksum
+      if (val < 0 || pos == len) break;
+      if (store) {
+        uint16_t addr = offset + pos;
+        if (addr < EEP_HEADER_SIZE) {
+          ((uint8_t*)&eep)[addr] = (uint8_t)val;
+        }
+        else {
+          PROGRAM_AREA_TOP[addr - EEP_HEADER_SIZE] = (uint8_t)val;
+        }
+      }
+    }
+    if (val == -1) break;
+    if (val < 0 || sum != 0 || (!store && offset + len > received)) {
+      uploadReply(CHR_UPLOAD_NAK);
+      continue;
+    }
+    if (len == 0) {
+      done = (offset == length && received == length && length > EEP_HEADER_SIZE);
+      break;
+    }
+    if (store) {
+      received += len;
+      if (received == EEP_HEADER_SIZE) {
+        // header complete: the image must come from this version, uncompressed
+        if (progHeaderCheck(&eep)) break;
+        if (eep.format & EEP_FORMAT_LZ) break;
+        length += eep.length;
+      }
+    }
+    uploadReply(CHR_UPLOAD_ACK);
+  }
+
+  if (done) {
+    progLength = eep.length;
+    done = progChainCheck();
+  }
+  if (!done) {
+    bios_breakFlag = 0;
+    programNew();
+    if (errorCode == ERROR_NONE) errorCode = ERROR_UPLOAD;
+    return;
+  }
+#if ARENA_HISTORY
+  historyCheck();
+#endif
+  programIndexBuild();
+  progSave(eep.autoRun);
+  if (errorCode == ERROR_NONE) uploadReply(CHR_UPLOAD_ACK);
 }
 
 //*************************************************
-static void proc_pause(void)
+static void uploadReply(char ch)
 {
-  if (checkDelimiter()) return;
-  while (checkBreakKey() == 0);
+  // bios_consoleWrite() is sent at once (no line buffering on the host)
+  STAT_ADD(STAT_CONSOLE_OUT, 1);
+  bios_consoleWrite(&ch, 1);
 }
 
 //*************************************************
-static void proc_reset(void)
+// Returns -1 on timeout or break
+static int16_t uploadGetChar(void)
 {
-  if (checkDelimiter()) return;
-  bios_systemReset();
+  nb_int_t waitStart = bios_getSystemTick();
+
+  while (!bios_breakFlag) {
+    int16_t ch = bios_consoleGetChar();
+    if (ch >= 0) {
+      STAT_ADD(STAT_CONSOLE_IN, 1);
+      return ch;
+    }
+    nb_int_t elapsed = bios_getSystemTick() - waitStart;
+    if (elapsed > UPLOAD_TIMEOUT) break;
+    bios_idle(UPLOAD_TIMEOUT - elapsed + 1);
+  }
+  return -1;
 }
 
 //*************************************************
-static error_code_t checkDivZero(nb_int_t val)
+// Two hex digits, added to *sum
+// Returns -1 on timeout or break, -2 on a character that is not hex
+static int16_t uploadGetByte(uint8_t *sum)
 {
-  if (errorCode == ERROR_NONE) {
-    if (val == 0) {
-      errorCode = ERROR_DIVZERO;
+  uint8_t val = 0;
+
+  for (uint8_t i = 0; i < 2; i++) {
+    int16_t ch = uploadGetChar();
+    if (ch < 0) return -1;
+    if (ch >= '0' && ch <= '9') {
+      ch -= '0';
+    }
+    else {
+      ch |= 0x20;
+      if (ch < 'a' || ch > 'f') return -2;
+      ch -= 'a' - 10;
     }
+    val = (val << 4) | ch;
   }
-  return errorCode;
+  *sum += val;
+  return val;
 }
+#endif
 
 //*************************************************
-static void let_variable(nb_int_t *pvar)
+static void proc_comment(void)
 {
-  uint8_t op = *executionPointer;
-
-  if (op == executionPointer[1]) {
-    executionPointer += 2;
-    if (op == '+') { (*pvar)++; return; }
-    if (op == '-') { (*pvar)--; return; }
-    if (op !='<' && op != '>') {errorCode = ERROR_SYNTAX;return;}
-  }
-  else
-  if (op=='+' || op=='-' || op=='*' || op=='/' || op=='%' || op=='|' || op=='&' || op=='^') {
+  while(CODE_BYTE(executionPointer) != ST_EOL) {
     executionPointer++;
   }
-  if (checkST('=')) return;
-  nb_int_t val = expr();
-  if (errorCode) return;
-
-  switch (op) {
-  case '+' : *pvar += val; break;
-  case '-' : *pvar -= val; break;
-  case '*' : *pvar *= val; break;
-  case '/' : if (!checkDivZero(val)) *pvar /= val; break;
-  case '%' : if (!checkDivZero(val)) *pvar %= val; break;
-  case '|' : *pvar |= val; break;
-  case '&' : *pvar &= val; break;
-  case '^' : *pvar ^= val; break;
-  case '<' : *pvar <<= val; break;
-  case '>' : *pvar >>= val; break;
-  case '=' : *pvar = val; break;
-  default : break;
-  }
 }
 
 //*************************************************
-static void proc_let(nb_int_t *pvar)
+static uint8_t get_arg2(nb_int_t *val_1, nb_int_t *val_2)
 {
-  let_variable(pvar);
-  checkDelimiter();
+  *val_1 = expr();
+  if (!checkST(',')) {
+    *val_2 = expr();
+    checkDelimiter();
+  }
+  return errorCode;
 }
 
 //*************************************************
-static void proc_randomize(void)
+static void proc_outp(void)
 {
-  nb_int_t val;
+  nb_int_t val_1, val_2;
 
-  val = expr();
-  if (checkDelimiter()) return;
-  bios_randomize(val);
+  if (get_arg2( &val_1, &val_2) == ERROR_NONE) {
+    if (bios_writeGpio(val_1, val_2)) {
+      errorCode = ERROR_PARA;
+    }
+  }
 }
 
 //*************************************************
-static void proc_data(void)
+// port, value [, mask]  (mask: 0xff when omitted)
+static uint8_t get_port_args(nb_int_t *port, nb_int_t *value, nb_int_t *mask)
 {
-  while (!isDelimiter(*executionPointer)) {
-    executionPointer = get_next_ptr(executionPointer);
+  *port = expr();
+  if (checkST(',')) return errorCode;
+  *value = expr();
+  *mask = 0xff;
+  if (errorCode == ERROR_NONE && CODE_BYTE(executionPointer) == ',') {
+    executionPointer++;
+    *mask = expr();
   }
+  checkDelimiter();
+  return errorCode;
 }
 
 //*************************************************
-static void proc_read(void)
+static void proc_outport(void)
 {
-  static const uint8_t st_list[] = { ST_DATA, 0 };
-  nb_int_t *pvar, val;
-  uint8_t ch, *ptr, *ptrsave;
+  nb_int_t port, value, mask;
 
-  pvar = getParameterPointer();
-//if (pvar == NULL)  return;
-  if (checkDelimiter()) return;
+  if (get_port_args(&port, &value, &mask) == ERROR_NONE) {
+    if (bios_writePort(port, value, mask)) {
+      errorCode = ERROR_PARA;
+    }
+  }
+}
 
-  ptrsave = executionPointer;
-  executionPointer = (dataReadPointer == 0) ? (uint8_t*)PROGRAM_AREA_TOP + 1 : dataReadPointer;
+//*************************************************
+static void proc_portdir(void)
+{
+  nb_int_t port, dir, mask;
 
-  do{
-    if (*executionPointer != ',') {
-      int16_t lnum = lineNumber;
-      ptr = findST(st_list, &lnum);
-      if (ptr == NULL) {
-        errorCode = ERROR_UXREAD;
-        break;
-      }
-      executionPointer = ptr;
+  if (get_port_args(&port, &dir, &mask) == ERROR_NONE) {
+    if (bios_setPortDir(port, dir, mask)) {
+      errorCode = ERROR_PARA;
     }
-    else{
-      executionPointer++;
+  }
+}
+
+//*************************************************
+// SAMPLE INP(pin)|ADC(ch), index, count, period : start a capture into @[index..]
+// SAMPLE : wait until the capture is complete
+static void proc_sample(void)
+{
+#if CAPTURE_ENABLE
+  nb_int_t source, index, count, period;
+  uint8_t ch;
+
+  if (isDelimiter(CODE_BYTE(executionPointer))) {
+    outputFlush();
+    while (bios_captureRemain()) {
+      if (checkBreak() < 0) {
+        bios_captureStop();
+        return;
+      }
+      bios_idle(1);
+    }
+    return;
+  }
+  ch = CODE_BYTE(executionPointer++);
+  if (ch != FUNC_INP && ch != FUNC_ADC) {
+    errorCode = ERROR_SYNTAX;
+    return;
+  }
+  source = calcValueFunc();
+  if (checkST(',')) return;
+  index = expr();
+  if (checkST(',')) return;
+  if (get_arg2(&count, &period) != ERROR_NONE) return;
+  if (getArrayRange(index, count) == NULL) return;
+  if ((nb_uint_t)source > 0xff) {
+    errorCode = ERROR_PARA;
+    return;
+  }
+  if (ch == FUNC_ADC) source |= BIOS_CAPTURE_ADC;
+  if (bios_captureStart(source, &arrayValiables[index], count, period)) {
+    errorCode = ERROR_PARA;
+    return;
+  }
+  captureTotal = count;
+#else
+  errorCode = ERROR_SYNTAX;
+#endif
+}
+
+//*************************************************
+// SAMPLE(0) : samples still to be taken (0: complete), SAMPLE(1) : samples taken
+static nb_int_t sample_func(nb_int_t val)
+{
+#if CAPTURE_ENABLE
+  nb_int_t remain = bios_captureRemain();
+  return val ? captureTotal - remain : remain;
+#else
+  (void)val;
+  errorCode = ERROR_SYNTAX;
+  return 0;
+#endif
+}
+
+//*************************************************
+static error_code_t delayMs(nb_int_t val)
+{
+  nb_int_t waitStart = bios_getSystemTick();
+
+  outputFlush();
+  while(checkBreak() >= 0) {
+    nb_int_t elapsed = bios_getSystemTick() - waitStart;
+    if (elapsed > val) break;
+    bios_idle(val - elapsed + 1);
+  }
+  return errorCode;
+}
+
+//*************************************************
+static void proc_delay(void)
+{
+  nb_int_t val;
+#if EVENT_TIMER_NUM
+  uint8_t *start = executionPointer - 1;
+
+  if (start == waitResume) {
+    // back from the handler of a timer: wait for the rest of the time
+    waitResume = NULL;
+    executionPointer = skipToDelimiter(executionPointer);
+    val = waitEnd - bios_getSystemTick();
+  }
+  else
+#endif
+  {
+    val = expr();
+    if (checkDelimiter()) return;
+  }
+#if EVENT_TIMER_NUM
+  // a timer that expires meanwhile ends the wait, its handler runs and
+  // then returns to this DELAY, which waits until the same end tick
+  nb_int_t waitStart = bios_getSystemTick();
+
+  outputFlush();
+  while(checkBreak() >= 0) {
+    nb_int_t elapsed = bios_getSystemTick() - waitStart;
+    if (elapsed > val) break;
+    nb_int_t idle = eventIdleTime(val - elapsed + 1);
+    if (idle == 0) {
+      waitResume = start;
+      waitEnd = waitStart + val;
+      executionPointer = start;
+      return;
+    }
+    bios_idle(idle);
+  }
+#else
+  delayMs(val);
+#endif
+}
+
+//*************************************************
+static void proc_pause(void)
+{
+  if (checkDelimiter()) return;
+  while (checkBreakKey() == 0) {
+#if EVENT_TIMER_NUM
+    // a timer that expires meanwhile runs its handler, which returns to this PAUSE
+    nb_int_t idle = eventIdleTime(IDLE_WAIT_MAX);
+    if (idle == 0) {
+      executionPointer--;
+      return;
+    }
+    bios_idle(idle);
+#else
+    bios_idle(IDLE_WAIT_MAX);
+#endif
+  }
+}
+
+//*************************************************
+static void proc_reset(void)
+{
+  if (checkDelimiter()) return;
+  outputFlush();
+  bios_systemReset();
+}
+
+//*************************************************
+static error_code_t checkDivZero(nb_int_t val)
+{
+  if (errorCode == ERROR_NONE) {
+    if (val == 0) {
+      errorCode = ERROR_DIVZERO;
+    }
+  }
+  return errorCode;
+}
+
+//*************************************************
+static void let_variable(nb_int_t *pvar)
+{
+  uint8_t op = CODE_BYTE(executionPointer);
+
+  if (op == CODE_BYTE(executionPointer + 1)) {
+    executionPointer += 2;
+    if (op == '+') { (*pvar)++; return; }
+    if (op == '-') { (*pvar)--; return; }
+    if (op !='<' && op != '>') {errorCode = ERROR_SYNTAX;return;}
+  }
+  else
+  if (op=='+' || op=='-' || op=='*' || op=='/' || op=='%' || op=='|' || op=='&' || op=='^') {
+    executionPointer++;
+  }
+  if (checkST('=')) return;
+  nb_int_t val = expr();
+  if (errorCode) return;
+
+  switch (op) {
+  case '+' : *pvar += val; break;
+  case '-' : *pvar -= val; break;
+  case '*' : *pvar *= val; break;
+  case '/' : if (!checkDivZero(val)) *pvar /= val; break;
+  case '%' : if (!checkDivZero(val)) *pvar %= val; break;
+  case '|' : *pvar |= val; break;
+  case '&' : *pvar &= val; break;
+  case '^' : *pvar ^= val; break;
+  case '<' : *pvar <<= val; break;
+  case '>' : *pvar >>= val; break;
+  case '=' : *pvar = val; break;
+  default : break;
+  }
+}
+
+//*************************************************
+static void proc_let(nb_int_t *pvar)
+{
+  let_variable(pvar);
+  checkDelimiter();
+}
+
+//*************************************************
+static void proc_randomize(void)
+{
+  nb_int_t val;
+
+  val = expr();
+  if (checkDelimiter()) return;
+  bios_randomize(val);
+}
+
+//*************************************************
+static void proc_data(void)
+{
+  while (!isDelimiter(CODE_BYTE(executionPointer))) {
+    executionPointer = get_next_ptr(executionPointer);
+  }
+}
+
+//*************************************************
+static void proc_read(void)
+{
+  static const uint8_t st_list[] = { ST_DATA, 0 };
+  nb_int_t *pvar, val;
+  uint8_t ch, *ptr, *ptrsave;
+  int16_t lnumsave;
+
+  pvar = getParameterPointer();
+//if (pvar == NULL)  return;
+  if (checkDelimiter()) return;
+
+  ptrsave = executionPointer;
+  lnumsave = lineNumber;
+  executionPointer = (dataReadPointer == 0) ? (uint8_t*)PROGRAM_AREA_TOP + 1 : dataReadPointer;
+
+  do{
+#if DATA_INDEX_NUM
+    if (!dataIndexOver) {
+      if (dataReadIndex >= dataIndexCount) {
+        errorCode = ERROR_UXREAD;
+        break;
+      }
+      executionPointer = (uint8_t*)PROGRAM_AREA_TOP + dataIndex[dataReadIndex++];
+    }
+    else
+#endif
+    if (CODE_BYTE(executionPointer) != ',') {
+      int16_t lnum = lineNumber;
+      ptr = findST(st_list, &lnum);
+      if (ptr == NULL) {
+        errorCode = ERROR_UXREAD;
+        break;
+      }
+      executionPointer = ptr;
+    }
+    else{
+      executionPointer++;
     }
     val = expr();
     if (errorCode != ERROR_NONE) {
       break;
     }
     *pvar = val;
-    ch = *executionPointer;
+    ch = CODE_BYTE(executionPointer);
     if (isDelimiter(ch) || ch == ',') {
       break;
     }
@@ -2071,13 +3919,33 @@ static void proc_read(void)
   } while (false);
   dataReadPointer = executionPointer;
   executionPointer = ptrsave;
+  lineNumber = lnumsave;      // findST() moves it to the DATA line
 }
 
 //*************************************************
+// RESTORE [label] : read from the top, or from the first DATA at/after label
 static void proc_restore(void)
 {
+  uint8_t *ptr = NULL;
+
+  if (!isDelimiter(CODE_BYTE(executionPointer))) {
+    nb_int_t val = expr();
+    if (checkDelimiter()) return;
+    uint8_t *ptrsave = executionPointer;
+    int16_t lnumsave = lineNumber;
+    ptr = label2exeptr(val);
+    executionPointer = ptrsave;
+    lineNumber = lnumsave;
+    if (ptr == NULL) {
+      errorCode = ERROR_LABEL;
+      return;
+    }
+  }
   if (checkDelimiter()) return;
-  dataReadPointer = 0;
+  dataReadPointer = ptr;
+#if DATA_INDEX_NUM
+  dataReadIndex = (ptr == NULL) ? 0 : dataIndexSearch(ptr);
+#endif
 }
 
 //*************************************************
@@ -2093,67 +3961,634 @@ static void proc_pwm(void)
 }
 
 //*************************************************
-static nb_int_t inkey_func(nb_int_t val)
+static void proc_profile(void)
 {
-  if (val < 0) val = 0;
-  nb_int_t waitStart = bios_getSystemTick();
+#if PROFILE_LINE_NUM || PROFILE_SAMPLE_NUM
+  nb_int_t num;
 
-  while (1) {
-    int16_t ch = checkBreakKey();
-    if (ch != 0) return ch;
-    nb_int_t elapsed = bios_getSystemTick() - waitStart;
-    if (val && elapsed > val) return -1;
+  num = PROFILE_PRINT_NUM;
+  if (!isDelimiter(CODE_BYTE(executionPointer))) {
+    num = expr();
+  }
+  if (checkDelimiter()) return;
+  if (num <= 0) {
+#if PROFILE_LINE_NUM
+    profileClear();
+#endif
+#if PROFILE_SAMPLE_NUM
+    sampleClear();
+#endif
+    return;
   }
+#if PROFILE_LINE_NUM
+  profilePrint(num);
+#endif
+#if PROFILE_SAMPLE_NUM
+  samplePrint(num);
+#endif
+#else
+  errorCode = ERROR_SYNTAX;
+#endif
 }
 
+#if PROFILE_LINE_NUM || PROFILE_SAMPLE_NUM
 //*************************************************
-static nb_int_t *getArrayReference(void)
+static void profilePrintLine(int16_t line)
 {
-  int16_t index;
-  nb_int_t *pvar;
+  uint8_t *ptr;
+  nb_int_t val;
 
-  if (checkST('[')) return NULL;
-  index = expr();
-  if (errorCode != ERROR_NONE) return NULL;
-  if (index < 0 || index >= ARRAY_INDEX_NUM) {
-    errorCode = ERROR_ARRAY;
-    return NULL;
+  printCounter(line, 5);
+  ptr = (uint8_t*)PROGRAM_AREA_TOP;
+  while (--line > 0 && CODE_BYTE(ptr) != ST_EOL) {
+    ptr += CODE_BYTE(ptr) + 1;
+  }
+  if (CODE_BYTE(ptr) != ST_EOL && get_dec_val(ptr + 1, &val) != NULL) {
+    printString(int2str(val, 0, 6));
+  }
+  else {
+    printStringFlash(F("      "));
   }
-  pvar = &arrayValiables[index];
-  if (checkST(']')) return NULL;
-  return pvar;
 }
+#endif
 
+#if PROFILE_LINE_NUM
 //*************************************************
-static nb_int_t calcValueFunc(void)
+static void profilePrint(nb_int_t num)
 {
-  nb_int_t val;
+  profile_line_t *p, *best, *prev;
+  uint32_t count, ticks;
+
+  printStringFlash(F(" Line Label     Count    Time\r\n"));
+  prev = NULL;
+  while (num-- > 0) {
+    // next entry in (time, count, line) order after the previous one
+    best = NULL;
+    for (p = profileLines; p < &profileLines[PROFILE_LINE_NUM]; p++) {
+      if (p->count == 0) continue;
+      if (prev != NULL && !profileBefore(prev, p)) continue;
+      if (best == NULL || profileBefore(p, best)) best = p;
+    }
+    if (best == NULL) break;
+    prev = best;
+    profilePrintLine((int16_t)(best - profileLines) + 1);
+    printCounter(best->count, 10);
+    printCounter(best->ticks, 8);
+    printNewline();
+  }
 
-  if (checkST('(')) return -1;
-  val = expr();
-  if (checkST(')')) return -1;
-  return val;
+  count = ticks = 0;
+  for (p = profileLines; p < &profileLines[PROFILE_LINE_NUM]; p++) {
+    count += p->count;
+    ticks += p->ticks;
+  }
+  printStringFlash(F(" Total      "));
+  printCounter(count, 10);
+  printCounter(ticks, 8);
+  printNewline();
 }
 
 //*************************************************
-static nb_int_t calcValue(void)
+static void profileStatement(void)
 {
-  uint8_t ch;
-  nb_int_t *pvar, val;
+  nb_int_t now;
 
-  if (++exprDepth > EXPR_DEPTH_MAX) {
-    errorCode = ERROR_TOODEEP;
-    return -1;
+  if (lineNumber == 0) {    // direct mode: not profiled, drop the idle time
+    profileLine = 0;
+    return;
   }
-
-  uint8_t* p = get_dec_val(executionPointer, &val);
-  if (p != NULL) {
-    executionPointer = p;
-    return val;
+  now = bios_getSystemTick();
+  // time since the previous statement goes to that statement's line
+  if (profileLine > 0 && profileLine <= PROFILE_LINE_NUM) {
+    profileLines[profileLine - 1].ticks += (nb_uint_t)(now - profileTick);
   }
-  ch = *executionPointer++;
-  if (isupper(ch)) {
-    ch -= 'A';
+  profileTick = now;
+  profileLine = lineNumber;
+  if (lineNumber <= PROFILE_LINE_NUM) {
+    profileLines[lineNumber - 1].count++;
+  }
+}
+
+//*************************************************
+static uint8_t profileBefore(const profile_line_t *a, const profile_line_t *b)
+{
+  if (a->ticks != b->ticks) return a->ticks > b->ticks;
+  if (a->count != b->count) return a->count > b->count;
+  return a < b;
+}
+
+//*************************************************
+static void profileClear(void)
+{
+  memset(profileLines, 0, sizeof(profileLines));
+  profileLine = 0;
+}
+#endif
+
+#if PROFILE_SAMPLE_NUM
+//*************************************************
+// Called from the BIOS timer interrupt
+void basicProfileSample(void)
+{
+  int16_t line = lineNumber;
+  uint8_t ctx = bios_sampleContext;
+  uint8_t kind;
+
+  if (line <= 0) return;    // REPL: nothing to sample
+  if (line <= PROFILE_SAMPLE_NUM && sampleLines[line - 1] != 0xffff) {
+    sampleLines[line - 1]++;
+  }
+  kind = (ctx & SAMPLE_CTX_BIOS) ? 3 : (ctx & SAMPLE_CTX_FINDST) ? 2 : (ctx & SAMPLE_CTX_EXPR) ? 1 : 0;
+  if (sampleContexts[kind] != 0xffff) {
+    sampleContexts[kind]++;
+  }
+}
+
+//*************************************************
+static void samplePrint(nb_int_t num)
+{
+  uint16_t count, best, prev;
+  int16_t i, line, prevLine;
+  uint32_t total;
+
+  printStringFlash(F(" Line Label   Samples\r\n"));
+  prev = 0;
+  prevLine = 0;
+  while (num-- > 0) {
+    // next line in (samples, line) order after the previous one
+    best = 0;
+    line = 0;
+    for (i = 0; i < PROFILE_SAMPLE_NUM; i++) {
+      count = sampleLines[i];
+      if (count == 0) continue;
+      if (prevLine && (count > prev || (count == prev && i < prevLine))) continue;
+      if (count > best) {
+        best = count;
+        line = i + 1;
+      }
+    }
+    if (line == 0) break;
+    prev = best;
+    prevLine = line;
+    profilePrintLine(line);
+    printCounter(best, 10);
+    printNewline();
+  }
+
+  total = 0;
+  for (i = 0; i < PROFILE_SAMPLE_NUM; i++) {
+    total += sampleLines[i];
+  }
+  printStringFlash(F(" Total      "));
+  printCounter(total, 10);
+  printNewline();
+  printStringFlash(F("  Interp    Expr  FindST    BIOS\r\n"));
+  for (i = 0; i < 4; i++) {
+    printCounter(sampleContexts[i], 8);
+  }
+  printNewline();
+}
+
+//*************************************************
+static void sampleClear(void)
+{
+  int16_t i;
+
+  for (i = 0; i < PROFILE_SAMPLE_NUM; i++) {
+    sampleLines[i] = 0;
+  }
+  for (i = 0; i < 4; i++) {
+    sampleContexts[i] = 0;
+  }
+}
+#endif
+
+//*************************************************
+static void proc_stat(void)
+{
+#if STAT_ENABLE
+  nb_int_t num;
+
+  num = 1;
+  if (!isDelimiter(CODE_BYTE(executionPointer))) {
+    num = expr();
+  }
+  if (checkDelimiter()) return;
+  if (num <= 0) {
+    statClear();
+    return;
+  }
+  statPrint();
+#else
+  errorCode = ERROR_SYNTAX;
+#endif
+}
+
+//*************************************************
+// STAT(n) : counter n (stat_counter_e), truncated to nb_int_t
+static nb_int_t stat_func(nb_int_t val)
+{
+#if STAT_ENABLE
+  if (val < 0 || val >= STAT_NUM) {
+    errorCode = ERROR_PARA;
+    return 0;
+  }
+  return (nb_int_t)statValue((uint8_t)val);
+#else
+  (void)val;
+  errorCode = ERROR_SYNTAX;
+  return 0;
+#endif
+}
+
+#if STAT_ENABLE
+// Counter names for STAT, in stat_counter_e order
+const char stat_name_0[] PROGMEM = "Statements  ";
+const char stat_name_1[] PROGMEM = "Label calls ";
+const char stat_name_2[] PROGMEM = "Label bytes ";
+const char stat_name_3[] PROGMEM = "Find scans  ";
+const char stat_name_4[] PROGMEM = "Find bytes  ";
+const char stat_name_5[] PROGMEM = "Stack max   ";
+const char stat_name_6[] PROGMEM = "Expr max    ";
+const char stat_name_7[] PROGMEM = "Console in  ";
+const char stat_name_8[] PROGMEM = "Console out ";
+const char stat_name_9[] PROGMEM = "EEPROM read ";
+const char stat_name_10[] PROGMEM = "EEPROM write";
+const char stat_name_11[] PROGMEM = "Free bytes  ";
+
+static const char * const statNames[STAT_NUM] PROGMEM = {
+  stat_name_0, stat_name_1, stat_name_2, stat_name_3, stat_name_4, stat_name_5,
+  stat_name_6, stat_name_7, stat_name_8, stat_name_9, stat_name_10, stat_name_11,
+};
+
+//*************************************************
+static uint32_t statValue(uint8_t id)
+{
+  if (id == STAT_PROG_FREE) return (uint32_t)PROGRAM_FREE_BYTES;
+  return statCounters[id];
+}
+
+//*************************************************
+static void statPrint(void)
+{
+  uint8_t i;
+
+  printStringFlash(F("  # Counter          Value\r\n"));
+  for (i = 0; i < STAT_NUM; i++) {
+    printCounter(i, 3);
+    printChar(ASCII_SP);
+    printStringFlash(FPSTR((PGM_P)pgm_read_ptr(&statNames[i])));
+    printCounter(statValue(i), 10);
+    printNewline();
+  }
+}
+
+//*************************************************
+static void statClear(void)
+{
+  memset(statCounters, 0, sizeof(statCounters));
+}
+#endif
+
+//*************************************************
+static void proc_every(void)
+{
+#if EVENT_TIMER_NUM
+  eventSet(ST_EVERY);
+#else
+  errorCode = ERROR_SYNTAX;
+#endif
+}
+
+//*************************************************
+static void proc_after(void)
+{
+#if EVENT_TIMER_NUM
+  eventSet(ST_AFTER);
+#else
+  errorCode = ERROR_SYNTAX;
+#endif
+}
+
+#if EVENT_TIMER_NUM
+//*************************************************
+// EVERY / AFTER <ms> GOSUB <label>
+// One timer per label: setting it again restarts it, <ms> <= 0 stops it.
+static void eventSet(uint8_t type)
+{
+  nb_int_t ms, label;
+  event_timer_t *ev, *slot = NULL;
+
+  ms = expr();
+  if (checkST(ST_GOSUB)) return;
+  label = expr();
+  if (checkDelimiter()) return;
+  if (lineNumber == 0) {
+    errorCode = ERROR_NOTINRUN;
+    return;
+  }
+
+  for (ev = eventTimers; ev < &eventTimers[EVENT_TIMER_NUM]; ev++) {
+    if (ev->type && ev->label == label) {
+      ev->type = 0;
+      eventCount--;
+      slot = ev;
+      break;
+    }
+    if (ev->type == 0 && slot == NULL) slot = ev;
+  }
+  if (ms <= 0) return;
+  if (slot == NULL) {
+    errorCode = ERROR_PARA;
+    return;
+  }
+  slot->type = type;
+  slot->label = label;
+  slot->interval = ms;
+  slot->due = bios_getSystemTick() + ms;
+  eventCount++;
+}
+
+//*************************************************
+// Called between statements while a timer is set.
+// Calls the handler of the first expired timer as GOSUB and
+// returns non-zero when the execution point was changed.
+static uint8_t eventService(void)
+{
+  event_timer_t *ev;
+  nb_int_t now;
+  nb_stack_t *prevsp;
+
+  if (lineNumber == 0) return 0;
+  if (eventLevel) {
+    if (stackPointer >= eventLevel) return 0;  // handler still running
+    eventLevel = 0;
+  }
+  now = bios_getSystemTick();
+  for (ev = eventTimers; ev < &eventTimers[EVENT_TIMER_NUM]; ev++) {
+    if (ev->type == 0 || (nb_int_t)(now - ev->due) < 0) continue;
+    if (ev->type == ST_AFTER) {
+      ev->type = 0;
+      eventCount--;
+    }
+    else {
+      ev->due += ev->interval;
+      if ((nb_int_t)(now - ev->due) >= 0) {
+        ev->due = now + ev->interval;  // fell behind: skip missed periods
+      }
+    }
+    prevsp = pushStack(ST_GOSUB);
+    if (prevsp == NULL) return 1;
+    if (label2exeptr(ev->label) == NULL) {
+      stackPointer--;
+      errorCode = ERROR_LABEL;
+      return 1;
+    }
+    eventLevel = stackPointer;
+    returnRequest = REQUEST_GOTO;
+    return 1;
+  }
+  return 0;
+}
+
+//*************************************************
+// Time a wait may sleep before eventService() has a timer to call
+// (0: one is due now), at most max_ms
+static nb_int_t eventIdleTime(nb_int_t max_ms)
+{
+  event_timer_t *ev;
+  nb_int_t now;
+
+  if (eventCount == 0 || lineNumber == 0) return max_ms;
+  if (eventLevel && stackPointer >= eventLevel) return max_ms;  // handler still running
+  now = bios_getSystemTick();
+  for (ev = eventTimers; ev < &eventTimers[EVENT_TIMER_NUM]; ev++) {
+    if (ev->type == 0) continue;
+    nb_int_t left = ev->due - now;
+    if (left <= 0) return 0;
+    if (left < max_ms) max_ms = left;
+  }
+  return max_ms;
+}
+
+//*************************************************
+static void eventClear(void)
+{
+  memset(eventTimers, 0, sizeof(eventTimers));
+  eventCount = 0;
+  eventLevel = 0;
+  waitResume = NULL;
+}
+#endif
+
+//*************************************************
+static nb_int_t inkey_func(nb_int_t val)
+{
+  if (val < 0) val = 0;
+  nb_int_t waitStart = bios_getSystemTick();
+
+  while (1) {
+    int16_t ch = checkBreakKey();
+    if (ch != 0) return ch;
+    nb_int_t elapsed = bios_getSystemTick() - waitStart;
+    if (val && elapsed > val) return -1;
+    nb_int_t idle = val ? val - elapsed + 1 : IDLE_WAIT_MAX;
+#if EVENT_TIMER_NUM
+    // a timer that expires meanwhile ends the wait as a timeout,
+    // its handler runs after this statement
+    idle = eventIdleTime(idle);
+    if (idle == 0) return -1;
+#endif
+    bios_idle(idle);
+  }
+}
+
+//*************************************************
+static nb_int_t *getArrayReference(void)
+{
+  int16_t index;
+  nb_int_t *pvar;
+
+  if (checkST('[')) return NULL;
+  index = expr();
+  if (errorCode != ERROR_NONE) return NULL;
+  if (index < 0 || index >= ARRAY_SIZE) {
+    errorCode = ERROR_ARRAY;
+    return NULL;
+  }
+  pvar = &arrayValiables[index];
+  if (checkST(']')) return NULL;
+  return pvar;
+}
+
+//*************************************************
+// @[index] .. @[index+count-1] (count >= 1)
+static nb_int_t *getArrayRange(nb_int_t index, nb_int_t count)
+{
+  if (errorCode != ERROR_NONE) return NULL;
+  if (index < 0 || count <= 0 || index > ARRAY_SIZE - count) {
+    errorCode = ERROR_ARRAY;
+    return NULL;
+  }
+  return &arrayValiables[index];
+}
+
+#if RAM_ARENA_SIZE
+//*************************************************
+// Place @array (num elements, cleared) at the top of the arena
+static void arraySetSize(int16_t num)
+{
+#if CAPTURE_ENABLE
+  bios_captureStop();
+#endif
+  arraySize = num;
+  arrayValiables = ramArena + (RAM_ARENA_SIZE / sizeof(nb_int_t) - num);
+  memset(arrayValiables, 0, num * sizeof(nb_int_t));
+#if ARENA_HISTORY
+  historyValid = false;
+#endif
+}
+#endif
+
+//*************************************************
+// DIM @[num] : resize @array, the program area gets the rest
+static void proc_dim(void)
+{
+#if RAM_ARENA_SIZE
+  nb_int_t num;
+
+  if (checkST(ST_ARRAY) || checkST('[')) return;
+  num = expr();
+  if (checkST(']') || checkDelimiter()) return;
+  if (num < 0) {
+    errorCode = ERROR_PARA;
+    return;
+  }
+  if (num > (RAM_ARENA_SIZE - 3 - progLength) / (nb_int_t)sizeof(nb_int_t)) {
+    errorCode = ERROR_PGOVER;
+    return;
+  }
+  arraySetSize(num);
+#else
+  errorCode = ERROR_SYNTAX;
+#endif
+}
+
+//*************************************************
+static uint8_t get_arg3(nb_int_t *val_1, nb_int_t *val_2, nb_int_t *val_3)
+{
+  *val_1 = expr();
+  if (checkST(',')) return errorCode;
+  return get_arg2(val_2, val_3);
+}
+
+//*************************************************
+// FILL index, count, value
+static void proc_fill(void)
+{
+  nb_int_t index, count, value, *p;
+
+  if (get_arg3(&index, &count, &value) != ERROR_NONE) return;
+  if ((p = getArrayRange(index, count)) == NULL) return;
+  while (count--) {
+    *p++ = value;
+  }
+}
+
+//*************************************************
+// COPY src, dst, count  (the ranges may overlap)
+static void proc_copy(void)
+{
+  nb_int_t src, dst, count, *p_src, *p_dst;
+
+  if (get_arg3(&src, &dst, &count) != ERROR_NONE) return;
+  if ((p_src = getArrayRange(src, count)) == NULL) return;
+  if ((p_dst = getArrayRange(dst, count)) == NULL) return;
+  memmove(p_dst, p_src, count * sizeof(nb_int_t));
+}
+
+//*************************************************
+// SHIFT index, count, value
+// Moves @[index+1..] down by one and stores value in the last element.
+static void proc_shift(void)
+{
+  nb_int_t index, count, value, *p;
+
+  if (get_arg3(&index, &count, &value) != ERROR_NONE) return;
+  if ((p = getArrayRange(index, count)) == NULL) return;
+  memmove(p, p + 1, (count - 1) * sizeof(nb_int_t));
+  p[count - 1] = value;
+}
+
+//*************************************************
+// SUM / MIN / MAX (index, count)
+static nb_int_t array_func(uint8_t func, nb_int_t index, nb_int_t count)
+{
+  nb_int_t *p, val;
+
+  if ((p = getArrayRange(index, count)) == NULL) return -1;
+  val = *p;
+  while (--count) {
+    p++;
+    switch (func) {
+    case FUNC_SUM : val += *p; break;
+    case FUNC_MIN : if (*p < val) val = *p; break;
+    default       : if (*p > val) val = *p; break;
+    }
+  }
+  return val;
+}
+
+//*************************************************
+// ELAPSED(start) : microseconds since start = UTICK, computed unsigned so
+// that it stays right when UTICK wraps around between the two readings
+static nb_int_t elapsed_func(nb_int_t start)
+{
+  return (nb_int_t)((nb_uint_t)bios_getMicroTick() - (nb_uint_t)start);
+}
+
+//*************************************************
+static uint8_t calcValueFunc2(nb_int_t *val_1, nb_int_t *val_2)
+{
+  *val_1 = *val_2 = 0;    // defined on the error paths too
+  if (checkST('(')) return errorCode;
+  *val_1 = expr();
+  if (checkST(',')) return errorCode;
+  *val_2 = expr();
+  return checkST(')');
+}
+
+//*************************************************
+static nb_int_t calcValueFunc(void)
+{
+  nb_int_t val;
+
+  if (checkST('(')) return -1;
+  val = expr();
+  if (checkST(')')) return -1;
+  return val;
+}
+
+//*************************************************
+static nb_int_t calcValue(void)
+{
+  uint8_t ch;
+  nb_int_t *pvar, val, val_2;
+
+  if (++exprDepth > EXPR_DEPTH_MAX) {
+    errorCode = ERROR_TOODEEP;
+    return -1;
+  }
+  STAT_MAX(STAT_EXPR_MAX, exprDepth);
+
+  uint8_t* p = get_dec_val(executionPointer, &val);
+  if (p != NULL) {
+    executionPointer = p;
+    return val;
+  }
+  ch = CODE_BYTE(executionPointer++);
+  if (isupper(ch)) {
+    ch -= 'A';
     return globalVariables[ch];
   }
   if (ch == ST_ARRAY) {
@@ -2180,222 +4615,1073 @@ static nb_int_t calcValue(void)
     }
     break;
   case FUNC_ABS :
-    val = calcValueFunc();
-    if (errorCode == ERROR_NONE) {
-      if (val < 0) val = -val;
-      return val;
-    }
-    break;
+    val = calcValueFunc();
+    if (errorCode == ERROR_NONE) {
+      if (val < 0) val = -val;
+      return val;
+    }
+    break;
+  case FUNC_INP :
+    val = calcValueFunc();
+    if (errorCode == ERROR_NONE) {
+      val = bios_readGpio(val);
+      if (val < 0) {
+        errorCode = ERROR_PARA;
+      }
+      return val;
+    }
+    break;
+  case FUNC_INPORT :
+    val = calcValueFunc();
+    if (errorCode == ERROR_NONE) {
+      val = bios_readPort(val);
+      if (val < 0) {
+        errorCode = ERROR_PARA;
+      }
+      return val;
+    }
+    break;
+  case ST_SAMPLE :
+    val = calcValueFunc();
+    if (errorCode == ERROR_NONE) {
+      return sample_func(val);
+    }
+    break;
+  case ST_STAT :
+    val = calcValueFunc();
+    if (errorCode == ERROR_NONE) {
+      return stat_func(val);
+    }
+    break;
+  case FUNC_SUM :
+  case FUNC_MIN :
+  case FUNC_MAX :
+    if (calcValueFunc2(&val, &val_2) == ERROR_NONE) {
+      return array_func(ch, val, val_2);
+    }
+    break;
+  case FUNC_ADC :
+    val = calcValueFunc();
+    if (errorCode == ERROR_NONE) {
+      val = bios_readAdc(val);
+      if (val < 0) {
+        errorCode = ERROR_PARA;
+      }
+      return val;
+    }
+    break;
+  case FUNC_INKEY :
+    val = calcValueFunc();
+    if (errorCode == ERROR_NONE) {
+      val = inkey_func(val);
+      return val;
+    }
+    break;
+  case FUNC_ELAPSED :
+    val = calcValueFunc();
+    if (errorCode == ERROR_NONE) {
+      return elapsed_func(val);
+    }
+    break;
+  case SVAR_TICK :
+    return bios_getSystemTick();
+  case SVAR_UTICK :
+    return bios_getMicroTick();
+  case SVAR_FREE :
+    return PROGRAM_FREE_BYTES;
+  default :
+    errorCode = ERROR_SYNTAX;
+  }
+  return -1;
+}
+
+//*************************************************
+static nb_int_t expr4th(void)
+{
+  nb_int_t acc, val;
+  uint8_t ch;
+
+  acc = calcValue();
+  if (errorCode != ERROR_NONE) { return -1; }
+  while(true) {
+    ch = CODE_BYTE(executionPointer++);
+    switch(ch) {
+    case '*':
+      acc = acc * calcValue();
+      break;
+    case '/':
+      val = calcValue();
+      if (!checkDivZero(val)) {
+        acc = acc / val;
+      }
+      break;
+    case '%':
+      val = calcValue();
+      if (!checkDivZero(val)) {
+        acc = acc % val;
+      }
+      break;
+    default:
+      executionPointer--;
+      return acc;
+    }
+    if (errorCode != ERROR_NONE) { return -1; }
+  }
+}
+
+//*************************************************
+static nb_int_t expr3nd(void)
+{
+  nb_int_t acc;
+  uint8_t ch;
+
+  acc = expr4th();
+  if (errorCode != ERROR_NONE) { return -1; }
+  while(true) {
+    ch = CODE_BYTE(executionPointer++);
+    switch(ch) {
+    case '+':
+      acc = acc + expr4th();
+      break;
+    case '-':
+      acc = acc - expr4th();
+      break;
+    default:
+      executionPointer--;
+      return acc;
+    }
+    if (errorCode != ERROR_NONE) { return -1; }
+  }
+}
+
+//*************************************************
+static nb_int_t expr2nd(void)
+{
+  nb_int_t acc, tmp;
+  uint8_t ch, ch2;
+
+  acc = expr3nd();
+  if (errorCode != ERROR_NONE) { return -1; }
+  while(true) {
+    ch = CODE_BYTE(executionPointer++);
+    switch(ch) {
+    case '>':
+      ch2 = CODE_BYTE(executionPointer++);
+      if (ch2 == '=') {
+        tmp = expr3nd();
+        acc = (acc >= tmp);   // >=
+      }
+      else
+      if (ch2 == ch)  {
+        tmp = expr3nd();
+        acc = (acc >> tmp);   // >>
+      }
+      else {
+        executionPointer--;
+        tmp = expr3nd();
+        acc = (acc > tmp);    // >
+      }
+      break;
+    case '<':
+      ch2 = CODE_BYTE(executionPointer++);
+      if (ch2 == '=') {
+        tmp = expr3nd();
+        acc = (acc <= tmp);   // <=
+      }
+      else
+      if (ch2 == '>') {
+        tmp = expr3nd();
+        acc = (acc != tmp);   // <>
+      }
+      else
+      if (ch2 == ch)  {
+        tmp = expr3nd();
+        acc = (acc << tmp);   // <<
+      }
+      else {
+        executionPointer--;
+        tmp = expr3nd();
+        acc = (acc < tmp);    // <
+      }
+      break;
+    case '=':
+      if (CODE_BYTE(executionPointer) == ch) executionPointer++;
+      tmp = expr3nd();
+      acc = (acc == tmp);     // =, ==
+      break;
+    case '!':
+	  if (CODE_BYTE(executionPointer) == '=') {
+	    executionPointer++;
+	    tmp = expr3nd();
+	    acc = (acc != tmp);     // !=
+	    break;
+	  }
+	  /* fall through */
+	default:
+      executionPointer--;
+      return acc;
+    }
+    if (errorCode != ERROR_NONE) { return -1; }
+  }
+}
+
+//*************************************************
+static nb_int_t expr(void)
+{
+#if PROFILE_SAMPLE_NUM
+  uint8_t ctx = bios_sampleContext;
+  bios_sampleContext = ctx | SAMPLE_CTX_EXPR;
+  nb_int_t val = exprMain();
+  bios_sampleContext = ctx;
+  return val;
+#else
+  return exprMain();
+#endif
+}
+
+//*************************************************
+static nb_int_t exprMain(void)
+{
+  nb_int_t acc, tmp;
+  uint8_t ch;
+
+  if (CODE_BYTE(executionPointer) == ST_EXPR) {
+#if EXPR_COMPILE_ENABLE
+    return exprCompiled();
+#else
+    executionPointer += EXPR_HEADER_SIZE + CODE_BYTE(executionPointer + 1);
+#endif
+  }
+  acc = expr2nd();
+  if (errorCode != ERROR_NONE) { return -1; }
+  while(true) {
+    ch = CODE_BYTE(executionPointer++);
+    switch(ch) {
+    case '&' :
+      if (CODE_BYTE(executionPointer) != ch) {
+        acc = acc & expr2nd();    // &
+        break;
+      }
+      executionPointer++;
+      tmp = expr2nd();
+      acc = (acc && tmp);         // &&
+      break;
+    case '|' :
+      if (CODE_BYTE(executionPointer) != ch) {
+        acc = acc | expr2nd();    // |
+        break;
+      }
+      executionPointer++;
+      tmp = expr2nd();
+      acc = (acc || tmp);         // ||
+      break;
+    case '^' :
+      acc = acc ^ expr2nd();      // ^
+      break;
+    default:
+      executionPointer--;
+      return acc;
+    }
+    if (errorCode != ERROR_NONE) { return -1; }
+  }
+}
+
+#if EXPR_COMPILE_ENABLE
+//*************************************************
+//    Expression compile (infix -> postfix)
+//*************************************************
+// The rpn* functions mirror calcValue() .. expr() and read the infix
+// code through executionPointer. The postfix code is written into
+// inputBuff, which is free once the line has been converted.
+//*************************************************
+static uint8_t rpnEmit(uint8_t code)
+{
+  if (rpnPointer >= (uint8_t*)inputBuff + sizeof(inputBuff)) {
+    return false;
+  }
+  *rpnPointer++ = code;
+  return true;
+}
+
+//*************************************************
+static uint8_t rpnPush(uint8_t code)
+{
+  if (rpnDepth >= EXPR_DEPTH_MAX) {
+    return false;
+  }
+#if CODE_OPTIMIZE_ENABLE
+  rpnItem[rpnDepth] = (uint8_t)(rpnPointer - (uint8_t*)inputBuff);
+#endif
+  rpnDepth++;
+  return rpnEmit(code);
+}
+
+#if CODE_OPTIMIZE_ENABLE
+//*************************************************
+static uint8_t *rpnItemTop(uint8_t pos)
+{
+  return (uint8_t*)inputBuff + rpnItem[pos];
+}
+
+//*************************************************
+static uint8_t rpnIsLiteral(uint8_t *ptr, uint8_t *end, nb_int_t *val)
+{
+  return (get_dec_val(ptr, val) == end);
+}
+
+//*************************************************
+static uint8_t rpnIsVariable(uint8_t *ptr, uint8_t *end)
+{
+  return (ptr + 1 == end && isupper(*ptr));
+}
+
+//*************************************************
+static uint8_t rpnLiteral(uint8_t *ptr, nb_int_t val)
+{
+  if (ptr + 5 > (uint8_t*)inputBuff + sizeof(inputBuff)) {
+    return false;
+  }
+  *ptr = ST_VAL_DEC;
+  rpnPointer = set_dec_val(ptr, val);
+  return true;
+}
+
+//*************************************************
+static uint8_t rpnOptimize(uint8_t code, uint8_t binary)
+{
+  uint8_t *a, *b;
+  nb_int_t val_a, val_b;
+
+  b = rpnItemTop(rpnDepth - 1);
+  if (!binary) {
+    // fold unary operator on a literal
+    if (code != RPN_NEG && code != '!' && code != '~') return false;
+    if (!rpnIsLiteral(b, rpnPointer, &val_b)) return false;
+    if (code == RPN_NEG) val_b = -val_b;
+    else
+    if (code == '!') val_b = (val_b == 0);
+    else             val_b = ~val_b;
+    return rpnLiteral(b, val_b);
+  }
+
+  a = rpnItemTop(rpnDepth - 2);
+  if (rpnIsLiteral(b, rpnPointer, &val_b)) {
+    if (rpnIsLiteral(a, b, &val_a)) {
+      // fold constant sub-expression
+      if ((code == '/' || code == '%') && val_b == 0) return false;
+      rpnDepth--;
+      return rpnLiteral(a, rpnCalc(code, val_a, val_b));
+    }
+    if (!rpnIsVariable(a, b)) return false;
+    binary = RPN_VL;    // variable op literal
+  }
+  else
+  if (rpnIsVariable(b, rpnPointer) && rpnIsVariable(a, b)) {
+    binary = RPN_VV;    // variable op variable
+  }
+  else {
+    return false;
+  }
+  b = rpnPointer;
+  if (!rpnEmit(0) || !rpnEmit(code)) return false;
+  memmove(a + 1, a, b - a);
+  *a = binary;
+  rpnDepth--;
+  return true;
+}
+#endif
+
+//*************************************************
+static uint8_t rpnOperator(uint8_t code, uint8_t binary)
+{
+  rpnOps++;
+#if CODE_OPTIMIZE_ENABLE
+  if (rpnOptimize(code, binary)) return true;
+#endif
+  if (binary) rpnDepth--;
+  return rpnEmit(code);
+}
+
+//*************************************************
+static uint8_t rpnValueFunc(void)
+{
+  if (*executionPointer++ != '(') return false;
+  if (!rpnExpr()) return false;
+  return (*executionPointer++ == ')');
+}
+
+//*************************************************
+static uint8_t rpnValue(void)
+{
+  uint8_t ch, *p;
+  nb_int_t val;
+
+  p = get_dec_val(executionPointer, &val);
+  if (p != NULL) {
+    if (!rpnPush(*executionPointer++)) return false;
+    while (executionPointer < p) {
+      if (!rpnEmit(*executionPointer++)) return false;
+    }
+    return true;
+  }
+  ch = *executionPointer++;
+  if (isupper(ch)) {
+    return rpnPush(ch);
+  }
+
+  switch(ch) {
+  case ST_ARRAY :
+    if (*executionPointer++ != '[') return false;
+    if (!rpnExpr()) return false;
+    if (*executionPointer++ != ']') return false;
+    return rpnOperator(ch, false);
+  case '(':
+    if (!rpnExpr()) return false;
+    return (*executionPointer++ == ')');
+  case '-':
+    if (!rpnValue()) return false;
+    return rpnOperator(RPN_NEG, false);
+  case '!' :
+  case '~' :
+    if (!rpnValue()) return false;
+    return rpnOperator(ch, false);
+  case FUNC_RND :
+  case FUNC_ABS :
   case FUNC_INP :
-    val = calcValueFunc();
-    if (errorCode == ERROR_NONE) {
-      val = bios_readGpio(val);
-      if (val < 0) {
-        errorCode = ERROR_PARA;
-      }
-      return val;
-    }
-    break;
+  case FUNC_INPORT :
   case FUNC_ADC :
-    val = calcValueFunc();
-    if (errorCode == ERROR_NONE) {
-      val = bios_readAdc(val);
-      if (val < 0) {
-        errorCode = ERROR_PARA;
-      }
-      return val;
-    }
-    break;
   case FUNC_INKEY :
-    val = calcValueFunc();
-    if (errorCode == ERROR_NONE) {
-      val = inkey_func(val);
-      return val;
-    }
-    break;
+  case FUNC_ELAPSED :
+  case ST_SAMPLE :
+  case ST_STAT :
+    if (!rpnValueFunc()) return false;
+    return rpnOperator(ch, false);
+  case FUNC_SUM :
+  case FUNC_MIN :
+  case FUNC_MAX :
+    // two arguments, never folded (the array changes at run time)
+    if (*executionPointer++ != '(') return false;
+    if (!rpnExpr()) return false;
+    if (*executionPointer++ != ',') return false;
+    if (!rpnExpr()) return false;
+    if (*executionPointer++ != ')') return false;
+    rpnOps++;
+    rpnDepth--;
+    return rpnEmit(ch);
   case SVAR_TICK :
-    return bios_getSystemTick();
-  default :
-    errorCode = ERROR_SYNTAX;
+  case SVAR_UTICK :
+  case SVAR_FREE :
+    rpnOps++;
+    return rpnPush(ch);
   }
-  return -1;
+  return false;
 }
 
 //*************************************************
-static nb_int_t expr4th(void)
+static uint8_t rpnExpr4th(void)
 {
-  nb_int_t acc, val;
   uint8_t ch;
 
-  acc = calcValue();
-  if (errorCode != ERROR_NONE) { return -1; }
+  if (!rpnValue()) return false;
   while(true) {
     ch = *executionPointer++;
     switch(ch) {
     case '*':
-      acc = acc * calcValue();
-      break;
     case '/':
-      val = calcValue();
-      if (!checkDivZero(val)) {
-        acc = acc / val;
-      }
-      break;
     case '%':
-      val = calcValue();
-      if (!checkDivZero(val)) {
-        acc = acc % val;
-      }
+      if (!rpnValue()) return false;
+      if (!rpnOperator(ch, true)) return false;
       break;
     default:
       executionPointer--;
-      return acc;
+      return true;
     }
-    if (errorCode != ERROR_NONE) { return -1; }
   }
 }
 
 //*************************************************
-static nb_int_t expr3nd(void)
+static uint8_t rpnExpr3rd(void)
 {
-  nb_int_t acc;
   uint8_t ch;
 
-  acc = expr4th();
-  if (errorCode != ERROR_NONE) { return -1; }
+  if (!rpnExpr4th()) return false;
   while(true) {
     ch = *executionPointer++;
     switch(ch) {
     case '+':
-      acc = acc + expr4th();
-      break;
     case '-':
-      acc = acc - expr4th();
+      if (!rpnExpr4th()) return false;
+      if (!rpnOperator(ch, true)) return false;
       break;
     default:
       executionPointer--;
-      return acc;
+      return true;
     }
-    if (errorCode != ERROR_NONE) { return -1; }
   }
 }
 
 //*************************************************
-static nb_int_t expr2nd(void)
+static uint8_t rpnExpr2nd(void)
 {
-  nb_int_t acc, tmp;
-  uint8_t ch, ch2;
+  uint8_t ch, ch2, op;
 
-  acc = expr3nd();
-  if (errorCode != ERROR_NONE) { return -1; }
+  if (!rpnExpr3rd()) return false;
   while(true) {
     ch = *executionPointer++;
     switch(ch) {
     case '>':
       ch2 = *executionPointer++;
-      if (ch2 == '=') {
-        tmp = expr3nd();
-        acc = (acc >= tmp);   // >=
-      }
+      if (ch2 == '=') op = RPN_GE;
       else
-      if (ch2 == ch)  {
-        tmp = expr3nd();
-        acc = (acc >> tmp);   // >>
-      }
+      if (ch2 == ch)  op = RPN_SHR;
       else {
         executionPointer--;
-        tmp = expr3nd();
-        acc = (acc > tmp);    // >
+        op = '>';
       }
       break;
     case '<':
       ch2 = *executionPointer++;
-      if (ch2 == '=') {
-        tmp = expr3nd();
-        acc = (acc <= tmp);   // <=
-      }
+      if (ch2 == '=') op = RPN_LE;
       else
-      if (ch2 == '>') {
-        tmp = expr3nd();
-        acc = (acc != tmp);   // <>
-      }
+      if (ch2 == '>') op = RPN_NE;
       else
-      if (ch2 == ch)  {
-        tmp = expr3nd();
-        acc = (acc << tmp);   // <<
-      }
+      if (ch2 == ch)  op = RPN_SHL;
       else {
         executionPointer--;
-        tmp = expr3nd();
-        acc = (acc < tmp);    // <
+        op = '<';
       }
       break;
     case '=':
       if (*executionPointer == ch) executionPointer++;
-      tmp = expr3nd();
-      acc = (acc == tmp);     // =, ==
+      op = '=';
       break;
     case '!':
-	  if (*executionPointer == '=') {
-	    executionPointer++;
-	    tmp = expr3nd();
-	    acc = (acc != tmp);     // !=
-	    break;
-	  }
-	  /* fall through */
-	default:
+      if (*executionPointer == '=') {
+        executionPointer++;
+        op = RPN_NE;
+        break;
+      }
+      /* fall through */
+    default:
       executionPointer--;
-      return acc;
+      return true;
     }
-    if (errorCode != ERROR_NONE) { return -1; }
+    if (!rpnExpr3rd()) return false;
+    if (!rpnOperator(op, true)) return false;
   }
 }
 
 //*************************************************
-static nb_int_t expr(void)
+static uint8_t rpnExpr(void)
 {
-  nb_int_t acc;
-  uint8_t ch;
+  uint8_t ch, op;
 
-  acc = expr2nd();
-  if (errorCode != ERROR_NONE) { return -1; }
+  if (!rpnExpr2nd()) return false;
   while(true) {
     ch = *executionPointer++;
     switch(ch) {
     case '&' :
-      if (*executionPointer != ch) {
-        acc = acc & expr2nd();    // &
-        break;
-      }
-      executionPointer++;
-      acc = !!acc && !!expr2nd(); // &&
-      break;
     case '|' :
-      if (*executionPointer != ch) {
-        acc = acc | expr2nd();    // |
-        break;
+      op = ch;
+      if (*executionPointer == ch) {
+        executionPointer++;
+        op = (ch == '&') ? RPN_LAND : RPN_LOR;
       }
-      executionPointer++;
-      acc = !!acc || !!expr2nd(); // ||
       break;
     case '^' :
-      acc = acc ^ expr2nd();      // ^
+      op = ch;
       break;
     default:
       executionPointer--;
-      return acc;
+      return true;
     }
-    if (errorCode != ERROR_NONE) { return -1; }
+    if (!rpnExpr2nd()) return false;
+    if (!rpnOperator(op, true)) return false;
+  }
+}
+
+//*************************************************
+static uint8_t exprCompile(uint8_t *top, uint8_t *ptr)
+{
+  uint8_t rpn_len, infix_len, len;
+
+#if CODE_OPTIMIZE_ENABLE
+  uint8_t items[EXPR_DEPTH_MAX];
+  rpnItem = items;
+#endif
+  executionPointer = ptr;
+  rpnPointer = (uint8_t*)inputBuff;
+  rpnDepth = rpnOps = 0;
+  if (!rpnExpr()) return 0;
+  if (rpnOps == 0) return 0;
+  if (executionPointer - ptr > 255) return 0;
+
+  rpn_len = (uint8_t)(rpnPointer - (uint8_t*)inputBuff);
+  infix_len = (uint8_t)(executionPointer - ptr);
+  len = *top;
+  if (len + EXPR_HEADER_SIZE + rpn_len > CODE_BUFF_SIZE - 2) return 0;
+
+  memmove(ptr + EXPR_HEADER_SIZE + rpn_len, ptr, (top + len + 1) - ptr);
+  ptr[0] = ST_EXPR;
+  ptr[1] = rpn_len;
+  ptr[2] = infix_len;
+  memcpy(ptr + EXPR_HEADER_SIZE, inputBuff, rpn_len);
+  *top = len + EXPR_HEADER_SIZE + rpn_len;
+  return EXPR_HEADER_SIZE + rpn_len + infix_len;
+}
+
+//*************************************************
+static uint8_t exprCompileLine(uint8_t *top)
+{
+  uint8_t ch, st, expect, let_eq, size;
+  uint8_t *ptr;
+  uint8_t *saveExecutionPointer = executionPointer;
+
+  ptr = top + 1;
+  if (IS_VAL(*ptr)) {
+    ptr = get_next_ptr(ptr);    // line label
+  }
+  st = 0;
+  expect = false;
+  let_eq = false;
+  while ((ch = *ptr) != ST_EOL) {
+    if (expect) {
+      expect = false;
+      size = exprCompile(top, ptr);
+      if (size) {
+        ptr += size;
+        continue;
+      }
+    }
+    if (st == 0) {
+      // statement top : keyword, variable, '@' or label of THEN/ELSE
+      st = ch;
+      let_eq = false;
+      switch (ch) {
+      case ST_PRINT :
+      case ST_GOTO :
+      case ST_GOSUB :
+      case ST_IF :
+      case ST_ELSEIF :
+      case ST_WHILE :
+      case ST_DELAY :
+      case ST_RONDOMIZE :
+      case ST_DATA :
+      case ST_RESTORE :
+      case ST_OUTP :
+      case ST_PWM :
+      case ST_EVERY :
+      case ST_AFTER :
+      case ST_OUTPORT :
+      case ST_PORTDIR :
+      case ST_FILL :
+      case ST_COPY :
+      case ST_SHIFT :
+        expect = true;
+        break;
+      }
+    }
+    switch (ch) {
+    case ST_COMMENT :
+      executionPointer = saveExecutionPointer;
+      return *top;
+    case ST_STRING :
+      do {
+        ch = *++ptr;
+        if (ch == '\\') ptr++;
+      } while (ch != ST_STRING && ch != ST_EOL);
+      break;
+    case ':' :
+    case ST_THEN :
+    case ST_ELSE :
+    case ST_ENDIF :
+      st = 0;
+      break;
+    case ST_ELSEIF :
+      st = ST_ELSEIF;
+      expect = true;
+      break;
+    case ST_TO :
+    case ST_STEP :
+      if (st == ST_FOR) expect = true;
+      break;
+    case ST_GOSUB :
+      if (st == ST_EVERY || st == ST_AFTER) expect = true;
+      break;
+    case ST_WHILE :
+      if (st == ST_LOOP) expect = true;
+      break;
+    case '=' :
+      if (!let_eq && (st == ST_FOR || st == ST_ARRAY || isupper(st))) {
+        let_eq = true;
+        expect = true;
+      }
+      break;
+    case '(' :
+    case '[' :
+    case ';' :
+      expect = true;
+      break;
+    case ',' :
+      if (st != ST_INPUT && st != ST_READ) expect = true;
+      break;
+    }
+    ptr = get_next_ptr(ptr);
+  }
+  executionPointer = saveExecutionPointer;
+  return *top;
+}
+
+//*************************************************
+//    Compiled expression evaluation
+//*************************************************
+static nb_int_t exprCompiled(void)
+{
+  nb_int_t stack[EXPR_DEPTH_MAX];
+  nb_int_t *sp, val;
+  uint8_t ch, *ptr, *end;
+
+  ptr = executionPointer + EXPR_HEADER_SIZE;
+  end = ptr + CODE_BYTE(executionPointer + 1);
+  executionPointer = end + CODE_BYTE(executionPointer + 2);
+  sp = stack;
+  while (ptr < end) {
+    STAT_MAX(STAT_EXPR_MAX, sp - stack);
+    uint8_t* p = get_dec_val(ptr, &val);
+    if (p != NULL) {
+      *sp++ = val;
+      ptr = p;
+      continue;
+    }
+    ch = CODE_BYTE(ptr++);
+    if (isupper(ch)) {
+      *sp++ = globalVariables[ch - 'A'];
+      continue;
+    }
+    switch (ch) {
+    case ST_ARRAY :
+      val = sp[-1];
+      if (val < 0 || val >= ARRAY_SIZE) {
+        errorCode = ERROR_ARRAY;
+        return -1;
+      }
+      sp[-1] = arrayValiables[val];
+      continue;
+    case RPN_NEG :
+      sp[-1] = -sp[-1];
+      continue;
+    case '!' :
+      sp[-1] = (sp[-1] == 0);
+      continue;
+    case '~' :
+      sp[-1] = ~sp[-1];
+      continue;
+    case FUNC_RND :
+      sp[-1] = bios_rand(sp[-1]);
+      continue;
+    case FUNC_ABS :
+      if (sp[-1] < 0) sp[-1] = -sp[-1];
+      continue;
+    case FUNC_INP :
+      sp[-1] = bios_readGpio(sp[-1]);
+      if (sp[-1] < 0) {
+        errorCode = ERROR_PARA;
+        return -1;
+      }
+      continue;
+    case FUNC_INPORT :
+      sp[-1] = bios_readPort(sp[-1]);
+      if (sp[-1] < 0) {
+        errorCode = ERROR_PARA;
+        return -1;
+      }
+      continue;
+    case FUNC_ADC :
+      sp[-1] = bios_readAdc(sp[-1]);
+      if (sp[-1] < 0) {
+        errorCode = ERROR_PARA;
+        return -1;
+      }
+      continue;
+    case FUNC_INKEY :
+      sp[-1] = inkey_func(sp[-1]);
+      if (errorCode != ERROR_NONE) return -1;
+      continue;
+    case FUNC_ELAPSED :
+      sp[-1] = elapsed_func(sp[-1]);
+      continue;
+    case ST_SAMPLE :
+      sp[-1] = sample_func(sp[-1]);
+      if (errorCode != ERROR_NONE) return -1;
+      continue;
+    case ST_STAT :
+      sp[-1] = stat_func(sp[-1]);
+      if (errorCode != ERROR_NONE) return -1;
+      continue;
+    case FUNC_SUM :
+    case FUNC_MIN :
+    case FUNC_MAX :
+      val = *--sp;
+      sp[-1] = array_func(ch, sp[-1], val);
+      if (errorCode != ERROR_NONE) return -1;
+      continue;
+    case SVAR_TICK :
+      *sp++ = bios_getSystemTick();
+      continue;
+    case SVAR_UTICK :
+      *sp++ = bios_getMicroTick();
+      continue;
+    case SVAR_FREE :
+      *sp++ = PROGRAM_FREE_BYTES;
+      continue;
+#if CODE_OPTIMIZE_ENABLE
+    case RPN_VL :     // [RPN_VL][variable][literal][op]
+      val = globalVariables[CODE_BYTE(ptr++) - 'A'];
+      ptr = get_dec_val(ptr, sp);
+      *sp = rpnCalc(CODE_BYTE(ptr++), val, *sp);
+      sp++;
+      if (errorCode != ERROR_NONE) return -1;
+      continue;
+    case RPN_VV :     // [RPN_VV][variable][variable][op]
+      val = globalVariables[CODE_BYTE(ptr) - 'A'];
+      *sp++ = rpnCalc(CODE_BYTE(ptr + 2), val, globalVariables[CODE_BYTE(ptr + 1) - 'A']);
+      ptr += 3;
+      if (errorCode != ERROR_NONE) return -1;
+      continue;
+#endif
+    }
+
+    val = *--sp;
+    sp[-1] = rpnCalc(ch, sp[-1], val);
+    if (errorCode != ERROR_NONE) return -1;
+  }
+  return sp[-1];
+}
+
+//*************************************************
+static nb_int_t rpnCalc(uint8_t op, nb_int_t a, nb_int_t b)
+{
+  switch (op) {
+  case '*' :    return a * b;
+  case '/' :
+    if (checkDivZero(b)) return -1;
+    return a / b;
+  case '%' :
+    if (checkDivZero(b)) return -1;
+    return a % b;
+  case '+' :    return a + b;
+  case '-' :    return a - b;
+  case '>' :    return (a > b);
+  case '<' :    return (a < b);
+  case '=' :    return (a == b);
+  case RPN_GE : return (a >= b);
+  case RPN_LE : return (a <= b);
+  case RPN_NE : return (a != b);
+  case RPN_SHL: return (a << b);
+  case RPN_SHR: return (a >> b);
+  case '&' :    return a & b;
+  case '|' :    return a | b;
+  case '^' :    return a ^ b;
+  case RPN_LAND:return (a && b);
+  case RPN_LOR: return (a || b);
+  }
+  return 0;
+}
+#endif
+
+#if CODE_OPTIMIZE_ENABLE
+//*************************************************
+//    Statement superinstructions (ST_FAST)
+//*************************************************
+// [ST_FAST][op length][statement length][op code ...][statement code ...]
+// The original statement is kept after the op code for LIST and scans.
+//*************************************************
+static uint8_t *getConstExpr(uint8_t *ptr, nb_int_t *val)
+{
+  if (*ptr == ST_EXPR) {
+    uint8_t *rpn = ptr + EXPR_HEADER_SIZE;
+    if (get_dec_val(rpn, val) != rpn + ptr[1]) return NULL;
+    return rpn + ptr[1] + ptr[2];
+  }
+  return get_dec_val(ptr, val);
+}
+
+//*************************************************
+static uint8_t *fastInsert(uint8_t *top, uint8_t *ptr, uint8_t *end, uint8_t *code, uint8_t code_len)
+{
+  uint8_t len = *top;
+
+  if (len + EXPR_HEADER_SIZE + code_len > CODE_BUFF_SIZE - 2) return end;
+  memmove(ptr + EXPR_HEADER_SIZE + code_len, ptr, (top + len + 1) - ptr);
+  ptr[0] = ST_FAST;
+  ptr[1] = code_len;
+  ptr[2] = (uint8_t)(end - ptr);
+  memcpy(ptr + EXPR_HEADER_SIZE, code, code_len);
+  *top = len + EXPR_HEADER_SIZE + code_len;
+  return end + EXPR_HEADER_SIZE + code_len;
+}
+
+//*************************************************
+static uint8_t *codeOptimizeStatement(uint8_t *top, uint8_t *ptr)
+{
+  uint8_t code[8], code_len, ch, *p, *end;
+  nb_int_t val;
+
+  ch = ptr[0];
+  p = ptr + 1;
+  end = NULL;
+  val = 0;
+  if (isupper(ch)) {
+    code[0] = FAST_ADD;
+    if ((p[0] == '+' || p[0] == '-') && p[1] == p[0]) {
+      val = (p[0] == '+') ? 1 : -1;                   // V++, V--
+      end = p + 2;
+    }
+    else
+    if ((p[0] == '+' || p[0] == '-') && p[1] == '=') {
+      end = getConstExpr(p + 2, &val);                // V+=k, V-=k
+      if (p[0] == '-') val = -val;
+    }
+    else
+    if (p[0] == '=') {
+      end = getConstExpr(p + 1, &val);                // V=k
+      code[0] = FAST_SET;
+      if (end == NULL && p[1] == ST_EXPR) {
+        uint8_t *rpn = p + 1 + EXPR_HEADER_SIZE;      // V=V+k, V=V-k
+        if (rpn[0] == RPN_VL && rpn[1] == ch) {
+          uint8_t *q = get_dec_val(rpn + 2, &val);
+          if (q + 1 == rpn + p[2] && (*q == '+' || *q == '-')) {
+            if (*q == '-') val = -val;
+            code[0] = FAST_ADD;
+            end = rpn + p[2] + p[3];
+          }
+        }
+      }
+    }
+    if (end == NULL || !isDelimiter(*end)) return NULL;
+    code[1] = ch;
+    code[2] = ST_VAL_DEC;
+    code_len = (uint8_t)(set_dec_val(&code[2], val) - code);
+    return fastInsert(top, ptr, end, code, code_len);
+  }
+  if (ch == ST_OUTP) {
+    end = getConstExpr(p, &val);                      // OUTP pin,value
+    if (end == NULL || *end != ',') return NULL;
+    code[0] = FAST_OUTP;
+    code[1] = (uint8_t)(end + 1 - ptr);
+    code[2] = ST_VAL_DEC;
+    code_len = (uint8_t)(set_dec_val(&code[2], val) - code);
+    end = skipToDelimiter(end + 1);
+    return fastInsert(top, ptr, end, code, code_len);
+  }
+  return NULL;
+}
+
+//*************************************************
+static uint8_t codeOptimizeLine(uint8_t *top)
+{
+  uint8_t ch, st_top, *ptr, *p;
+
+  ptr = top + 1;
+  if (IS_VAL(*ptr)) {
+    ptr = get_next_ptr(ptr);    // line label
+  }
+  st_top = true;
+  while ((ch = *ptr) != ST_EOL) {
+    if (st_top) {
+      st_top = false;
+      p = codeOptimizeStatement(top, ptr);
+      if (p != NULL) {
+        ptr = p;
+        continue;
+      }
+    }
+    switch (ch) {
+    case ST_COMMENT :
+      return *top;
+    case ST_STRING :
+      do {
+        ch = *++ptr;
+        if (ch == '\\') ptr++;
+      } while (ch != ST_STRING && ch != ST_EOL);
+      break;
+    case ':' :
+    case ST_THEN :
+    case ST_ELSE :
+      st_top = true;
+      break;
+    }
+    ptr = get_next_ptr(ptr);
+  }
+  return *top;
+}
+
+//*************************************************
+static void proc_fast(void)
+{
+  uint8_t *ptr, *stmt;
+  nb_int_t val, pin;
+
+  ptr = executionPointer + EXPR_HEADER_SIZE - 1;
+  stmt = ptr + CODE_BYTE(executionPointer);
+  executionPointer = stmt + CODE_BYTE(executionPointer + 1);
+  switch (CODE_BYTE(ptr)) {
+  case FAST_ADD :
+    get_dec_val(ptr + 2, &val);
+    globalVariables[CODE_BYTE(ptr + 1) - 'A'] += val;
+    break;
+  case FAST_SET :
+    get_dec_val(ptr + 2, &val);
+    globalVariables[CODE_BYTE(ptr + 1) - 'A'] = val;
+    break;
+  case FAST_OUTP :
+    get_dec_val(ptr + 2, &pin);
+    executionPointer = stmt + CODE_BYTE(ptr + 1);
+    val = expr();
+    if (checkDelimiter()) return;
+    if (bios_writeGpio(pin, val)) {
+      errorCode = ERROR_PARA;
+    }
+    break;
+  }
+}
+#endif
+
+//*************************************************
+// val / 10 and *rem = val % 10. The AVR has no divide instruction, so the
+// quotient is estimated with shifts and adds (0.8 * val / 8) and corrected once
+static inline nb_uint_t divu10(nb_uint_t val, uint8_t *rem)
+{
+#ifdef __AVR__
+  nb_uint_t q = (val >> 1) + (val >> 2);
+  q += q >> 4;
+  q += q >> 8;
+#if NANOBASIC_INT32_EN
+  q += q >> 16;
+#endif
+  q >>= 3;
+  uint8_t r = (uint8_t)(val - ((q << 3) + (q << 1)));
+  if (r > 9) {
+    q++;
+    r -= 10;
   }
+  *rem = r;
+  return q;
+#else
+  nb_uint_t q = val / 10;         // a multiply on hosts
+  *rem = (uint8_t)(val - q * 10);
+  return q;
+#endif
 }
 
 //*************************************************
 static char *int2str(nb_int_t para, uint8_t ff, int16_t len)
 {
-  static char str[13];
+  char *str = int2strBuff;
   char *s, ch , flag, fx;
   nb_uint_t val;
   int8_t dot ;
+  uint8_t digit;
 
 #if PRINT_HEX_STYLE == 1
   ff |= FORM_LOWER;
@@ -2432,8 +5718,8 @@ static char *int2str(nb_int_t para, uint8_t ff, int16_t len)
       val >>= 4;
     }
     else {
-      ch = (val % 10) + '0';
-      val /= 10;
+      val = divu10(val, &digit);
+      ch = digit + '0';
     }
     *s-- = ch;
     if (dot >= 0 && (--dot == 0)) *s-- = '.';
@@ -2477,47 +5763,47 @@ static char *int2str(nb_int_t para, uint8_t ff, int16_t len)
 //*************************************************
 static uint8_t* get_dec_val(uint8_t* ptr, nb_int_t* val)
 {
-  if (ptr[0] >= '0' && ptr[0] <= '9') {
-    *val = ptr[0] - '0';
+  if (CODE_BYTE(ptr) >= '0' && CODE_BYTE(ptr) <= '9') {
+    *val = CODE_BYTE(ptr) - '0';
     return ptr + 1;
   }
 
-  if ((*ptr & VAL_ST_MASK) != ST_VAL) {
+  if ((CODE_BYTE(ptr) & VAL_ST_MASK) != ST_VAL) {
     return NULL;
   }
 
-  uint8_t size = *ptr & VAL_SIZE_MASK;
+  uint8_t size = CODE_BYTE(ptr) & VAL_SIZE_MASK;
 
   if (size == VAL_SIZE_8) {
-    *val = (int8_t)ptr[1];
+    *val = (int8_t)CODE_BYTE(ptr + 1);
     return ptr + 2;
   }
 
 #if NANOBASIC_INT32_EN == 0
   *val =
-    ((nb_int_t)(int8_t)ptr[2] << 8) |
-    ((nb_int_t)ptr[1]);
+    ((nb_int_t)(int8_t)CODE_BYTE(ptr + 2) << 8) |
+    ((nb_int_t)CODE_BYTE(ptr + 1));
   return ptr + 3;
 #else
   if (size == VAL_SIZE_16) {
     *val =
-      ((nb_int_t)(int8_t)ptr[2] << 8) |
-      ((nb_int_t)ptr[1]);
+      ((nb_int_t)(int8_t)CODE_BYTE(ptr + 2) << 8) |
+      ((nb_int_t)CODE_BYTE(ptr + 1));
     return ptr + 3;
   }
 
   if (size == VAL_SIZE_24) {
     *val =
-      ((nb_int_t)(int8_t)ptr[3] << 16) |
-      ((nb_int_t)ptr[2] << 8) |
-      ((nb_int_t)ptr[1]);
+      ((nb_int_t)(int8_t)CODE_BYTE(ptr + 3) << 16) |
+      ((nb_int_t)CODE_BYTE(ptr + 2) << 8) |
+      ((nb_int_t)CODE_BYTE(ptr + 1));
     return ptr + 4;
   }
   *val =
-    ((nb_int_t)(int8_t)ptr[4] << 24) |
-    ((nb_int_t)ptr[3] << 16) |
-    ((nb_int_t)ptr[2] << 8) |
-    ((nb_int_t)ptr[1]);
+    ((nb_int_t)(int8_t)CODE_BYTE(ptr + 4) << 24) |
+    ((nb_int_t)CODE_BYTE(ptr + 3) << 16) |
+    ((nb_int_t)CODE_BYTE(ptr + 2) << 8) |
+    ((nb_int_t)CODE_BYTE(ptr + 1));
   return ptr + 5;
 #endif
 }
@@ -2565,10 +5851,14 @@ static uint8_t* set_dec_val(uint8_t* ptr, nb_int_t val)
 //*************************************************
 static uint8_t *get_next_ptr(uint8_t* ptr)
 {
-  uint8_t ch = *ptr++;
+  uint8_t ch = CODE_BYTE(ptr++);
 
   if ((ch & VAL_ST_MASK) == ST_VAL) {
     ptr += GET_VAL_SIZE(ch);
   }
+  else
+  if (ch == ST_EXPR || ch == ST_FAST) {
+    ptr += EXPR_HEADER_SIZE - 1 + CODE_BYTE(ptr);
+  }
   return ptr;
 }
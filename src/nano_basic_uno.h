@@ -9,6 +9,9 @@
  *   - basicInit()  : Initialize nanoBASIC engine
  *   - basicMain()  : Process input and execute BASIC
  *
+ * Host builds (HOST_API_ENABLE) additionally expose
+ * a REPL-less interface for benchmark and test runners.
+ *
  * Internal language definitions are in nano_basic_defs.h,
  * and hardware-dependent routines are implemented in
  * bios_uno.cpp/.h.
@@ -24,7 +27,59 @@
 #ifndef __NANO_BASIC_UNO_H
 #define __NANO_BASIC_UNO_H
 
+#include <stdint.h>
+
 void basicInit( void );
 void basicMain( void );
 
+// Host API (HOST_API_ENABLE)
+// basicLoadProgram() replaces the program with the given text
+// (lines separated by LF or CR/LF), basicRunProgram() runs it
+// to completion. Both return the error code (0: no error).
+int8_t basicLoadProgram( const char *text );
+int8_t basicRunProgram( void );
+uint32_t basicStatementCount( void );
+
+// basicProgramImage() copies the loaded program into buf as the
+// image written by SAVE (EEP_Header_t + program area), ready for
+// LOAD ! on a board built with the same configuration.
+// Returns the image length, or -1 if empty or larger than size.
+int16_t basicProgramImage( uint8_t *buf, uint16_t size, uint8_t autorun );
+
+// basicProgramLimits() returns the @array size and FREE of the loaded program.
+void basicProgramLimits( int16_t *array_size, int16_t *free_bytes );
+
+// basicLoadSaved() replaces the program with the one stored by SAVE
+// (the EEPROM, on the CLI build eeprom.bin or bios_cliSetEeprom()).
+int8_t basicLoadSaved( void );
+
+// Native programs (CLI --aot)
+// A program translated to C keeps its own variables and uses the core
+// for the console and the error report, like RUN:
+//   basicNativeBegin()   : starts the run, returns the statement counter
+//   basicNativePrint()   : prints a value as int2str() (FORM_xxx, length)
+//   basicNativePutChar() : prints one character
+//   basicNativeCall()    : INPUT, DELAY, PAUSE, RESET or INKEY() by its
+//                          token, returns the value, *error the error code
+//   basicNativeEnd()     : ends the run, prints the error message of
+//                          'error' at 'line' and returns it
+uint32_t *basicNativeBegin( void );
+void basicNativePrint( int32_t val, uint8_t form, int16_t len );
+void basicNativePutChar( char ch );
+int32_t basicNativeCall( uint8_t code, int32_t val, int8_t *error );
+int8_t basicNativeEnd( int8_t error, int16_t line );
+
+// Interpreter instances (CONTEXT_ENABLE)
+// All interpreter state lives in an nb_context_t. basicContextSet() binds
+// an instance to the calling thread (NULL: the built-in default instance),
+// and every call above then works on it. basicInitContext() and
+// basicMainContext() bind and then call basicInit() / basicMain().
+// An instance must not be used by two threads at the same time.
+typedef struct nb_context nb_context_t;
+nb_context_t *basicContextNew( void );
+void basicContextFree( nb_context_t *ctx );
+void basicContextSet( nb_context_t *ctx );
+void basicInitContext( nb_context_t *ctx );
+void basicMainContext( nb_context_t *ctx );
+
 #endif
\ No newline at end of file
@@ -27,7 +27,7 @@
 
 #define NAME_STR            "nanoBASIC UNO"
 #define VERSION_MAJOR       0
-#define VERSION_MINOR       18
+#define VERSION_MINOR       19
 
 // NOTE: On Arduino UNO (2KB RAM), adjust the following parameters to fit your use case.
 
@@ -40,7 +40,27 @@
 #define STACK_NUM           8    // Max nesting depth for FOR / WHILE / DO blocks
 #define ARRAY_INDEX_NUM     64   // Maximum number of elements in @array
 #define PROGRAM_AREA_SIZE   768  // BASIC program storage size in RAM
+#define RAM_ARENA_SIZE      0    // One arena for program, @array and history, split by DIM (0: fixed sizes above)
 #define EXPR_DEPTH_MAX      16   // Maximum expression evaluation depth
+#define EVENT_TIMER_NUM     4    // Timers for EVERY / AFTER ... GOSUB (0: disable)
+#define CAPTURE_ENABLE      1    // SAMPLE statement: timer-driven INP / ADC capture into @array
+#define OUTPUT_BUFF_SIZE    16   // Console output staging buffer, flushed per line (0: write each char)
+#define CONSOLE_TX_DROP     0    // Drop output that does not fit the TX buffer while RUN instead of waiting
+
+// --- Execution speed-up ---
+// Index tables are built after PROG / LOAD.
+// Expression compile stores a postfix copy of each expression (uses more program area).
+#define LABEL_INDEX_NUM     16   // Max labels in GOTO/GOSUB index (0: disable, linear search)
+#define BLOCK_INDEX_NUM     16   // Max IF/ELSE/WHILE/EXIT/CONTINUE jump entries (0: disable, forward scan)
+#define DATA_INDEX_NUM      32   // Max DATA items in READ index (0: disable, READ scans for DATA)
+#define EXPR_COMPILE_ENABLE 0    // Compile expressions to postfix code at input time (0: interpret infix)
+                                 //   faster, but each expression costs 3 bytes + its postfix copy (about the infix size)
+#define CODE_OPTIMIZE_ENABLE 0   // Fold constants and use superinstructions (requires EXPR_COMPILE_ENABLE)
+                                 //   each V++ / V+=k / V=k / OUTP pin,v short form costs about 6 more bytes
+
+// Statement dispatch in the interpreter loop (compare with the CLI --bench runner)
+//   0: if-else chain, 1: 256-entry handler table (in flash), 2: computed goto (GCC/Clang only)
+#define INTERP_DISPATCH     1
 
 // --- REPL features ---
 #define REPL_EDIT_ENABLE    1    // Enable line editing in REPL (no extra RAM usage)
@@ -48,6 +68,30 @@
 
 // --- Debug ---
 #define CODE_DEBUG_ENABLE   0    // Enable internal code dump (for debugging)
+#define PROFILE_LINE_NUM    0    // Lines 1..N profiled per statement by PROFILE (8 bytes RAM each, 0: disable)
+#define PROFILE_PRINT_NUM   10   // Default number of lines printed by PROFILE
+#define PROFILE_SAMPLE_NUM  0    // Lines 1..N in the timer-sampling profiler (2 bytes RAM each, 0: disable)
+#define STAT_ENABLE         0    // STAT statement / STAT() runtime counters (44 bytes RAM)
+
+// --- Host (CLI) build ---
+#ifndef ARDUINO
+#define HOST_API_ENABLE     1    // basicLoadProgram() / basicRunProgram() and statement counter
+#define CONTEXT_ENABLE      1    // Several interpreter instances per process, one per thread (basicContextSet)
+#else
+#define HOST_API_ENABLE     0
+#define CONTEXT_ENABLE      0
+#endif
+
+// --- Program storage (SAVE / LOAD) ---
+#define EEPROM_SIZE         1024 // EEPROM bytes available to SAVE (header + program)
+#define SAVE_COMPRESS_ENABLE 1   // SAVE stores the program compressed (LOAD reads both forms)
+#define UPLOAD_ENABLE       1    // LOAD ! : receive a host-tokenized program image over the console
+#define UPLOAD_TIMEOUT      3000 // LOAD ! gives up after this long without a character [ms]
+#define ROM_PROGRAM_ENABLE  0    // Run the program of nano_basic_rom.h in place from flash (no program area, see --rom)
+
+// --- Analog input (UNO BIOS) ---
+#define ADC_CACHE_ENABLE    1    // Scan used ADC channels in the background, ADC() returns the latest value
+#define ADC_AVERAGE_SHIFT   0    // Running average over 2^N conversions per channel (0..5, 0: latest only)
 
 // --- Startup behavior ---
 #define AUTORUN_WAIT_TIME   3000 // Delay before AUTORUN at startup [ms]
@@ -0,0 +1,12 @@
+'' short statement forms (ST_FAST) and their long forms
+A=10:B=0:C=-5
+A++:B--:C+=2*3:?A;" ";B;" ";C
+A-=1<<2:B=B-3:C=C+0x10:?A;" ";B;" ";C
+A=32767:A++:?A
+A=-32768:A--:?A
+A=0:FOR I=1 TO 5:A+=I:NEXT:?A
+K=5:K=K-K:?K
+@[3]=7:@[3]+=2:?@[3]
+FOR I=1 TO 3:OUTP 13,I&1:NEXT
+OUTP 2+1,1:?"outp"
+OUTP 99,1
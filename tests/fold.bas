@@ -0,0 +1,9 @@
+'' constant folding: the result must match the infix evaluation
+?1+2*3,(1+2)*3,-(2+3)*4,7/2-7%2
+?1<<5|3,0xF0&0x3C,0xF0^0xFF,~0,!0,!5
+?32767+1,-32768-1,300*300,-7/2,-7%2
+?1<2,2<=2,3>4,4>=5,1=1,1<>1
+?0&&1,2&&3,0||0,0||4
+A=5:?A*(2+3),A-(1+1),(4*4)+A,A<<(1+1)
+?2*3+A*(1+1)*(3-1)
+?1/0
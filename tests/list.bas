@@ -0,0 +1,8 @@
+'' LIST round-trip
+' kept comment
+10 a=4:b=a*2+1:c=-(a+b)
+if a<>b then ?"x";:goto 20 else ?hex(g) endif
+20 for i=0 to 4 step 2:next
+do:a++:loop while a<10
+?"tab\tend";a;" ";b+3;dec(c,5)
+outp 13,a&1:end
@@ -0,0 +1,2 @@
+'' PRINT stops at a failing HEX/DEC/RAW item, as it does for CHR
+?"hex ";HEX(255,4);" dec ";DEC(-12,5);" raw ";RAW(0x4241,2)
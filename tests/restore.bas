@@ -0,0 +1,13 @@
+'' READ / RESTORE with a label
+DATA 1,2,3
+200 DATA 10,20
+    DATA 30
+300 ?"no data here"
+400 DATA 40+2,-6
+FOR I=1 TO 3:READ V:?V;" ";:NEXT:?
+RESTORE 300:READ V:?V
+RESTORE 200:READ V:READ W:?V;" ";W
+READ V:?V
+RESTORE:READ V:?V
+RESTORE 400:READ V:READ W:?V;" ";W
+READ V
@@ -0,0 +1,7 @@
+'' SAVE / LOAD of a compressed program image
+10 ?"line 10":A=1
+20 ?"line 20":A=A+1
+30 ?"line 30":A=A+1
+40 ?"line 40":A=A+1
+50 ?"line 50":A=A+1
+60 ?"A=";A